@@ -1,6 +1,7 @@
 #version 150
 
 #define PEPR3D_MAX_PALETTE_COLORS 16
+#define PEPR3D_MAX_STROKE_PREVIEW_POINTS 128
 
 
 in highp vec3 Normal;
@@ -22,6 +23,9 @@ uniform bool uAreaHighlightEnabled;
 uniform bool uOverridePalette;
 uniform float uGridOffset;
 uniform vec2 uPreviewMinMaxHeight;
+uniform vec4 uStrokePreviewPoints[PEPR3D_MAX_STROKE_PREVIEW_POINTS];
+uniform int uStrokePreviewCount;
+uniform float uStrokePreviewSize;
 uniform mat4 ciModelMatrix;
 
 // From Florian Boesch post on barycentric coordinates
@@ -56,6 +60,28 @@ float getAreaHighlightAlpha() {
     return 0;
 }
 
+// Stroke that is not painted yet, spheres swept between consecutive points (w is 1 if connected to the previous one)
+float getStrokePreviewAlpha() {
+    float distLimitSquared = uStrokePreviewSize * uStrokePreviewSize;
+    for(int i = 0; i < uStrokePreviewCount; ++i) {
+        vec3 end = uStrokePreviewPoints[i].xyz;
+        vec3 start = (i > 0 && uStrokePreviewPoints[i].w > 0.5) ? uStrokePreviewPoints[i - 1].xyz : end;
+        vec3 segment = end - start;
+        float segmentLengthSquared = dot(segment, segment);
+        float t = 0.0;
+        if(segmentLengthSquared > 0.0) {
+            t = clamp(dot(ModelCoordinates - start, segment) / segmentLengthSquared, 0.0, 1.0);
+        }
+        vec3 lineToSegment = ModelCoordinates - (start + t * segment);
+
+        if(dot(lineToSegment, lineToSegment) < distLimitSquared) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 void main() {
     // discard pixels that are below / above the preview height limits:
     float minRelativeHeight = uPreviewMinMaxHeight.x;
@@ -86,7 +112,7 @@ void main() {
 
     float areaHighlightAlpha = getAreaHighlightAlpha();
     vec3 materialColor = uOverridePalette ? Color.rgb : uColorPalette[ColorIndex].rgb;
-    materialColor = mix(materialColor, uAreaHighlightColor, areaHighlightAlpha);
+    materialColor = mix(materialColor, uAreaHighlightColor, max(areaHighlightAlpha, getStrokePreviewAlpha()));
     vec3 wireframeColor = uShowWireframe ? getWireframeColor(materialColor) : materialColor;
     vec3 triangleColor = wireframe(materialColor, wireframeColor, 1.0);
 
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Keeps the sum of the memory used by a set of entries, e.g. the snapshots and diffs of a CommandManager, up to date
+/// as the entries are added and removed. Objects shared by several entries are counted only once, objects still used
+/// elsewhere can be excluded from the count.
+/// An entry reports its memory via add() and addShared() from the function passed to addEntry() or removeEntry().
+class MemoryUsageCounter {
+   public:
+    /// Start counting an entry
+    /// @param countEntry Called with this counter, reports the memory used by the entry
+    template <typename CountFunction>
+    void addEntry(const CountFunction& countEntry) {
+        mIsRemoving = false;
+        countEntry(*this);
+    }
+
+    /// Stop counting an entry that was added before
+    /// @param countEntry Called with this counter, must report the same memory as when the entry was added
+    template <typename CountFunction>
+    void removeEntry(const CountFunction& countEntry) {
+        mIsRemoving = true;
+        countEntry(*this);
+        mIsRemoving = false;
+    }
+
+    /// Add bytes that are not shared with anything else
+    void add(size_t bytes) {
+        if(mIsRemoving) {
+            P_ASSERT(mBytes >= bytes);
+            mBytes -= bytes;
+        } else {
+            mBytes += bytes;
+        }
+    }
+
+    /// Add a reference to a shared object, its size is counted while any counted entry references it
+    /// @param getSize Returns the number of bytes used by the object, called only when the object starts being counted
+    /// @return true if the object started or stopped being counted now, i.e. the objects it owns have to be reported
+    /// as well
+    template <typename Object, typename SizeFunction>
+    bool addShared(const Object* object, const SizeFunction& getSize) {
+        if(!object) {
+            return false;
+        }
+
+        if(mIsRemoving) {
+            const auto sharedIt = mShared.find(object);
+            P_ASSERT(sharedIt != mShared.end());
+            if(--sharedIt->second.references > 0) {
+                return false;
+            }
+            mBytes -= sharedIt->second.bytes;
+            if(mExcluded.count(object) > 0) {
+                mExcludedBytes -= sharedIt->second.bytes;
+            }
+            mShared.erase(sharedIt);
+            return true;
+        }
+
+        const auto [sharedIt, isNew] = mShared.try_emplace(object);
+        ++sharedIt->second.references;
+        if(!isNew) {
+            return false;
+        }
+        sharedIt->second.bytes = getSize(*object);
+        mBytes += sharedIt->second.bytes;
+        if(mExcluded.count(object) > 0) {
+            mExcludedBytes += sharedIt->second.bytes;
+        }
+        return true;
+    }
+
+    /// Do not count the object, e.g. because the target uses it and it would stay in memory without any history
+    void exclude(const void* object) {
+        if(!mExcluded.insert(object).second) {
+            return;
+        }
+        const auto sharedIt = mShared.find(object);
+        if(sharedIt != mShared.end()) {
+            mExcludedBytes += sharedIt->second.bytes;
+        }
+    }
+
+    /// Count all previously excluded objects again
+    void clearExcluded() {
+        mExcluded.clear();
+        mExcludedBytes = 0;
+    }
+
+    /// Bytes used by the counted entries, without the excluded objects
+    size_t getBytes() const {
+        P_ASSERT(mBytes >= mExcludedBytes);
+        return mBytes - mExcludedBytes;
+    }
+
+   private:
+    struct SharedObject {
+        size_t bytes = 0;
+        size_t references = 0;
+    };
+
+    std::unordered_map<const void*, SharedObject> mShared;
+    std::unordered_set<const void*> mExcluded;
+
+    /// Bytes of all counted entries, including the excluded objects
+    size_t mBytes = 0;
+
+    /// Bytes of the excluded objects that are counted in mBytes
+    size_t mExcludedBytes = 0;
+
+    bool mIsRemoving = false;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,72 @@
+#include "MemoryUsageCounter.h"
+#ifdef _TEST_
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace pepr3d {
+
+/// Entry that owns some bytes and references shared vectors, the elements of the second level are owned by the first
+struct MockEntry {
+    size_t ownBytes;
+    const std::vector<int>* shared;
+    const std::vector<const std::vector<int>*>* nested;
+
+    void count(MemoryUsageCounter& counter) const {
+        counter.add(ownBytes);
+        counter.addShared(shared, [](const std::vector<int>& v) { return v.size() * sizeof(int); });
+        const bool nestedCounted =
+            counter.addShared(nested, [](const auto& v) { return v.size() * sizeof(const std::vector<int>*); });
+        if(nestedCounted) {
+            for(const std::vector<int>* inner : *nested) {
+                counter.addShared(inner, [](const std::vector<int>& v) { return v.size() * sizeof(int); });
+            }
+        }
+    }
+};
+
+TEST(MemoryUsageCounter, SharedObjectsCountedOnce) {
+    /**
+     * Test that shared objects are counted while any entry references them and excluded objects are left out
+     */
+
+    const std::vector<int> shared(10);
+    const std::vector<int> inner(20);
+    const std::vector<const std::vector<int>*> nested = {&inner, &shared};
+    const size_t sharedBytes = shared.size() * sizeof(int);
+    const size_t nestedBytes = nested.size() * sizeof(const std::vector<int>*) + inner.size() * sizeof(int);
+
+    const MockEntry first{1, &shared, &nested};
+    const MockEntry second{2, &shared, &nested};
+    const MockEntry third{4, nullptr, nullptr};
+    const auto countFirst = [&first](MemoryUsageCounter& counter) { first.count(counter); };
+    const auto countSecond = [&second](MemoryUsageCounter& counter) { second.count(counter); };
+    const auto countThird = [&third](MemoryUsageCounter& counter) { third.count(counter); };
+
+    MemoryUsageCounter counter;
+    counter.addEntry(countFirst);
+    EXPECT_EQ(counter.getBytes(), 1 + sharedBytes + nestedBytes);
+    counter.addEntry(countSecond);
+    counter.addEntry(countThird);
+    EXPECT_EQ(counter.getBytes(), 7 + sharedBytes + nestedBytes);
+
+    counter.exclude(&inner);
+    EXPECT_EQ(counter.getBytes(), 7 + sharedBytes + nestedBytes - inner.size() * sizeof(int));
+    counter.clearExcluded();
+
+    // Shared objects stay counted until the last entry referencing them is removed
+    counter.removeEntry(countFirst);
+    EXPECT_EQ(counter.getBytes(), 6 + sharedBytes + nestedBytes);
+    counter.exclude(&shared);
+    counter.removeEntry(countSecond);
+    EXPECT_EQ(counter.getBytes(), 4);
+
+    // Exclusion applies to objects counted later as well
+    counter.addEntry(countSecond);
+    EXPECT_EQ(counter.getBytes(), 6 + nestedBytes);
+    counter.removeEntry(countSecond);
+    counter.removeEntry(countThird);
+    EXPECT_EQ(counter.getBytes(), 0);
+}
+
+}  // namespace pepr3d
+#endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include "glm/glm.hpp"
 
@@ -12,7 +13,7 @@ namespace pepr3d {
 class CmdColorManagerChangeColor : public CommandBase<Geometry> {
    public:
     CmdColorManagerChangeColor(size_t colorIdx, glm::vec4 color)
-        : CommandBase(false, true), mColorIdx(colorIdx), mColor(color) {}
+        : CommandBase(false, true, true), mColorIdx(colorIdx), mColor(color) {}
 
     std::string_view getDescription() const override {
         return "Change a color in the palette";
@@ -20,6 +21,7 @@ class CmdColorManagerChangeColor : public CommandBase<Geometry> {
 
    protected:
     void run(Geometry& target) const override {
+        target.recordPalette();
         target.getColorManager().setColor(mColorIdx, mColor);
     }
 
@@ -39,6 +41,7 @@ class CmdColorManagerChangeColor : public CommandBase<Geometry> {
         }
     }
 
+    /// Color id of the changed color
     size_t mColorIdx;
     glm::vec4 mColor;
 };
@@ -46,8 +49,9 @@ class CmdColorManagerChangeColor : public CommandBase<Geometry> {
 /// Command that swaps 2 colors in the palette, which also swaps the colors in the Geometry
 class CmdColorManagerSwapColors : public CommandBase<Geometry> {
    public:
+    /// @param color1Idx, color2Idx positions of the colors in the palette
     CmdColorManagerSwapColors(size_t color1Idx, size_t color2Idx)
-        : CommandBase(false, false), mColor1Idx(color1Idx), mColor2Idx(color2Idx) {}
+        : CommandBase(false, false, true), mColor1Idx(color1Idx), mColor2Idx(color2Idx) {}
 
     std::string_view getDescription() const override {
         return "Swap 2 colors in the palette";
@@ -55,10 +59,8 @@ class CmdColorManagerSwapColors : public CommandBase<Geometry> {
 
    protected:
     void run(Geometry& target) const override {
-        ColorManager& colorManager = target.getColorManager();
-        const glm::vec4 temp = colorManager.getColor(mColor1Idx);
-        colorManager.setColor(mColor1Idx, colorManager.getColor(mColor2Idx));
-        colorManager.setColor(mColor2Idx, temp);
+        target.recordPalette();
+        target.getColorManager().swapColors(mColor1Idx, mColor2Idx);
     }
 
     size_t mColor1Idx;
@@ -68,8 +70,9 @@ class CmdColorManagerSwapColors : public CommandBase<Geometry> {
 /// Command that reorders 2 colors in the palette, which does not change the colors in the Geometry
 class CmdColorManagerReorderColors : public CommandBase<Geometry> {
    public:
+    /// @param color1Idx, color2Idx positions of the colors in the palette
     CmdColorManagerReorderColors(size_t color1Idx, size_t color2Idx)
-        : CommandBase(false, false), mColor1Idx(color1Idx), mColor2Idx(color2Idx) {}
+        : CommandBase(false, false, true), mColor1Idx(color1Idx), mColor2Idx(color2Idx) {}
 
     std::string_view getDescription() const override {
         return "Reorder 2 colors in the palette";
@@ -77,24 +80,9 @@ class CmdColorManagerReorderColors : public CommandBase<Geometry> {
 
    protected:
     void run(Geometry& target) const override {
-        // the beginning is the same as in color swap:
-        ColorManager& colorManager = target.getColorManager();
-        const glm::vec4 temp = colorManager.getColor(mColor1Idx);
-        colorManager.setColor(mColor1Idx, colorManager.getColor(mColor2Idx));
-        colorManager.setColor(mColor2Idx, temp);
-
-        // unlike in color swap, we need to preserve model coloring, i.e., swap color IDs in the model:
-        const size_t color1Idx = mColor1Idx;  // Local copy to pass to lambda
-        const size_t color2Idx = mColor2Idx;
-        target.changeColorIds([color1Idx, color2Idx](size_t origColor) {
-            if(origColor == color1Idx) {
-                return color2Idx;
-            }
-            if(origColor == color2Idx) {
-                return color1Idx;
-            }
-            return origColor;
-        });
+        target.recordPalette();
+        // Color ids in the model stay the same, only their order in the palette changes
+        target.getColorManager().reorderColors(mColor1Idx, mColor2Idx);
     }
 
     size_t mColor1Idx;
@@ -104,6 +92,7 @@ class CmdColorManagerReorderColors : public CommandBase<Geometry> {
 /// Command that removes a color from the palette, which replaces it in the Geometry with the first color in the palette
 class CmdColorManagerRemoveColor : public CommandBase<Geometry> {
    public:
+    /// @param colorIdx position of the color in the palette
     CmdColorManagerRemoveColor(size_t colorIdx) : CommandBase(false, false), mColorIdx(colorIdx) {}
 
     std::string_view getDescription() const override {
@@ -112,27 +101,14 @@ class CmdColorManagerRemoveColor : public CommandBase<Geometry> {
 
    protected:
     void run(Geometry& target) const override {
+        target.recordPalette();
         ColorManager& colorManager = target.getColorManager();
         P_ASSERT(mColorIdx + 1 <= colorManager.size());
-        ColorManager::ColorMap& colorMap = colorManager.getColorMap();
-        colorMap.erase(colorMap.cbegin() + mColorIdx);
-        // replace the erased color in the model and shift remaining colors:
-        P_ASSERT(colorManager.size() > 0);
-        const size_t colorIdx = mColorIdx;  // Local copy for lambda
-        target.changeColorIds([colorIdx](size_t originalColor) {
-            if(originalColor == colorIdx) {
-                return static_cast<size_t>(0);
-            } else if(originalColor > colorIdx) {
-                return originalColor - 1;
-            }
-
-            return originalColor;
-        });
 
-        // set new active (user selected) color:
-        if(colorManager.getActiveColorIndex() == mColorIdx) {
-            colorManager.setActiveColorIndex(0);
-        }
+        // Replace the erased color in the model and move the last color id into the freed one
+        const std::vector<size_t> newColorIds = colorManager.removeColor(mColorIdx);
+        P_ASSERT(colorManager.size() > 0);
+        target.remapColorIds(newColorIds);
     }
 
     size_t mColorIdx;
@@ -141,7 +117,7 @@ class CmdColorManagerRemoveColor : public CommandBase<Geometry> {
 /// Command that adds a new color to the palette
 class CmdColorManagerAddColor : public CommandBase<Geometry> {
    public:
-    CmdColorManagerAddColor() : CommandBase(false, false) {}
+    CmdColorManagerAddColor() : CommandBase(false, false, true) {}
 
     std::string_view getDescription() const override {
         return "Add a new color to the palette";
@@ -149,6 +125,7 @@ class CmdColorManagerAddColor : public CommandBase<Geometry> {
 
    protected:
     void run(Geometry& target) const override {
+        target.recordPalette();
         ColorManager& colorManager = target.getColorManager();
         P_ASSERT(colorManager.size() > 0);
         std::random_device rd;   // Will be used to obtain a seed for the random number engine
@@ -169,16 +146,17 @@ class CmdColorManagerResetColors : public CommandBase<Geometry> {
 
    protected:
     void run(Geometry& target) const override {
+        target.recordPalette();
         ColorManager& colorManager = target.getColorManager();
+
+        // Colors keep their position in the palette, colors past the default ones get the last default color
+        std::vector<size_t> newColorIds = colorManager.getColorPositions();
         colorManager = ColorManager();
         const size_t maxColorId = colorManager.size() - 1;
-        target.changeColorIds([maxColorId](size_t origColor) {
-            if(origColor > maxColorId) {
-                return maxColorId;
-            } else {
-                return origColor;
-            }
-        });
+        for(size_t& colorId : newColorIds) {
+            colorId = std::min(colorId, maxColorId);
+        }
+        target.remapColorIds(newColorIds);
     }
 };
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <optional>
 #include <vector>
 
 #include "commands/Command.h"
@@ -21,17 +22,30 @@ class CmdPaintBrush : public CommandBase<Geometry> {
         return "Paint with a brush";
     }
 
-    CmdPaintBrush(ci::Ray ray, const BrushSettings settings)
-        : CommandBase(true, true), mRays{ray}, mSettings(settings) {}
+    /// @param previousRay Last ray of the stroke painted so far, the spherical brush connects it to the new ray
+    CmdPaintBrush(ci::Ray ray, const BrushSettings settings, std::optional<ci::Ray> previousRay = {})
+        : CommandBase(true, true, true), mRays{ray}, mPreviousRay(previousRay), mSettings(settings) {}
+
+    /// Paint several consecutive rays of a stroke at once
+    CmdPaintBrush(std::vector<ci::Ray> rays, const BrushSettings settings, std::optional<ci::Ray> previousRay = {})
+        : CommandBase(true, true, true), mRays(std::move(rays)), mPreviousRay(previousRay), mSettings(settings) {
+        P_ASSERT(!mRays.empty());
+    }
 
    protected:
     void run(Geometry& target) const override {
         const auto start = std::chrono::high_resolution_clock::now();
 
-        for(const ci::Ray& ray : mRays) {
-            if(mSettings.spherical) {
-                target.paintAreaWithSphere(ray, mSettings);
-            } else {
+        if(mSettings.spherical) {
+            // The whole stroke is painted at once, each triangle gets a single polygon operation
+            std::vector<ci::Ray> strokeRays;
+            if(mPreviousRay) {
+                strokeRays.push_back(*mPreviousRay);
+            }
+            strokeRays.insert(strokeRays.end(), mRays.begin(), mRays.end());
+            target.paintStrokeWithSphere(strokeRays, mSettings);
+        } else {
+            for(const ci::Ray& ray : mRays) {
                 glm::vec3 ro = ray.getOrigin();
                 glm::vec3 rd = ray.getDirection();
                 if(mSettings.alignToNormal) {
@@ -46,16 +60,20 @@ class CmdPaintBrush : public CommandBase<Geometry> {
                 // Create a shape to paint with
                 const Vector3 rayDirectionVector(rd.x, rd.y, rd.z);
                 const Circle circle(Point3(ro.x, ro.y, ro.z), mSettings.size * mSettings.size, rayDirectionVector);
-                const std::vector<Point3> circlePoints = GeometryUtils::pointsOnCircle(circle, mSettings.segments);
+                const int segments =
+                    GeometryUtils::getCircleSegmentCount(mSettings.size, mSettings.chordTolerance, mSettings.segments);
+                const std::vector<Point3> circlePoints = GeometryUtils::pointsOnCircle(circle, segments);
 
-                target.paintWithShape(ray, circlePoints, mSettings.color, mSettings.paintBackfaces);
+                target.paintWithShape(ray, circlePoints, mSettings.color, mSettings.paintBackfaces,
+                                      mSettings.gridSize);
             }
         }
 
         const auto end = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double, std::milli> timeMs = end - start;
 
-        CI_LOG_I("Brush paint took " + std::to_string(timeMs.count()) + " ms");
+        CI_LOG_I("Brush paint of " + std::to_string(mRays.size()) + " rays took " + std::to_string(timeMs.count()) +
+                 " ms");
     }
 
     bool joinCommand(const CommandBase& otherBase) override {
@@ -69,6 +87,10 @@ class CmdPaintBrush : public CommandBase<Geometry> {
     }
 
     std::vector<ci::Ray> mRays;
+
+    /// Ray painted before the first ray of this command, the stroke continues from it
+    std::optional<ci::Ray> mPreviousRay;
+
     BrushSettings mSettings;
 };
 }  // namespace pepr3d
\ No newline at end of file
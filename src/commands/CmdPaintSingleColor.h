@@ -4,6 +4,7 @@
 
 #include "commands/Command.h"
 #include "geometry/Geometry.h"
+#include "geometry/TriangleSelection.h"
 
 namespace pepr3d {
 
@@ -18,37 +19,31 @@ class CmdPaintSingleColor : public CommandBase<Geometry> {
         : CmdPaintSingleColor(DetailedTriangleId(triangleId), colorId) {}
 
     CmdPaintSingleColor(DetailedTriangleId triangleId, const size_t colorId)
-        : CommandBase(false, true), mTriangleIds{triangleId}, mColorId(colorId) {}
+        : CmdPaintSingleColor(std::vector<DetailedTriangleId>{triangleId}, colorId) {}
 
     CmdPaintSingleColor(std::vector<DetailedTriangleId>&& triangleIds, const size_t colorId)
-        : CommandBase(false, true), mTriangleIds(triangleIds), mColorId(colorId) {}
+        : CommandBase(false, true, true), mSelection(std::move(triangleIds)), mColorId(colorId) {}
 
     CmdPaintSingleColor(std::vector<size_t>&& triangleIds, const size_t colorId)
-        : CommandBase(false, true), mColorId(colorId) {
-        mTriangleIds.reserve(triangleIds.size());
-        for(size_t triIdx : triangleIds) {
-            mTriangleIds.emplace_back(triIdx);
-        }
-    }
+        : CommandBase(false, true, true), mSelection(std::move(triangleIds)), mColorId(colorId) {}
 
    protected:
     void run(Geometry& target) const override {
-        for(DetailedTriangleId triangleId : mTriangleIds) {
-            target.setTriangleColor(triangleId, mColorId);
-        }
+        target.setTriangleColors(mSelection, mColorId);
     }
 
     bool joinCommand(const CommandBase& otherBase) override {
         const auto* other = dynamic_cast<const CmdPaintSingleColor*>(&otherBase);
         if(other && other->mColorId == mColorId) {
-            mTriangleIds.insert(mTriangleIds.end(), other->mTriangleIds.begin(), other->mTriangleIds.end());
+            mSelection.insert(other->mSelection);
             return true;
         } else {
             return false;
         }
     }
 
-    std::vector<DetailedTriangleId> mTriangleIds;
+    /// Painted triangles, stored as ranges so that long drags do not repeat the same triangles
+    TriangleSelection mSelection;
     size_t mColorId;
 };
 }  // namespace pepr3d
\ No newline at end of file
@@ -6,7 +6,7 @@ namespace pepr3d {
 /// Command that paints a text using orthogonal projection
 class CmdPaintText : public CommandBase<Geometry> {
    public:
-    using Triangle = DataTriangle::Triangle;
+    using Outline = TriangleDetail::PolygonOutline;
     using Point = DataTriangle::Point;
 
     std::string_view getDescription() const override {
@@ -15,19 +15,32 @@ class CmdPaintText : public CommandBase<Geometry> {
 
     /// Paint a text string, using orthogonal projection.
     /// @param ray Direction of text projection
-    /// @param text Text mesh in world space
+    /// @param text Outlines of each letter in world space
     /// @param color Color to paint with
-    CmdPaintText(ci::Ray ray, const std::vector<std::vector<FontRasterizer::Tri>>& text, size_t color)
-        : CommandBase(true, false), mText{}, mRay{ray}, mColor(color) {
+    /// @param gridSize Size of the grid the letters are snapped to, see Geometry::getPaintGridSize()
+    CmdPaintText(ci::Ray ray, const std::vector<std::vector<FontRasterizer::Outline>>& text, size_t color,
+                 double gridSize = 0.0)
+        : CommandBase(true, false, true), mText{}, mRay{ray}, mColor(color), mGridSize(gridSize) {
+        const auto toPoints = [](const std::vector<glm::vec3>& contour) {
+            std::vector<Point> points;
+            points.reserve(contour.size());
+            for(const glm::vec3& pt : contour) {
+                points.emplace_back(pt.x, pt.y, pt.z);
+            }
+            return points;
+        };
+
         mText.resize(text.size());
         for(size_t i = 0; i < text.size(); ++i) {
-            const std::vector<FontRasterizer::Tri>& letter = text[i];
+            const std::vector<FontRasterizer::Outline>& letter = text[i];
 
             mText[i].reserve(letter.size());
-            for(size_t j = 0; j < letter.size(); ++j) {
-                const FontRasterizer::Tri& tri = letter[j];
-                mText[i].emplace_back(Point(tri.a.x, tri.a.y, tri.a.z), Point(tri.b.x, tri.b.y, tri.b.z),
-                                      Point(tri.c.x, tri.c.y, tri.c.z));
+            for(const FontRasterizer::Outline& outline : letter) {
+                Outline& exactOutline = mText[i].emplace_back();
+                exactOutline.boundary = toPoints(outline.boundary);
+                for(const std::vector<glm::vec3>& hole : outline.holes) {
+                    exactOutline.holes.push_back(toPoints(hole));
+                }
             }
         }
     }
@@ -36,14 +49,9 @@ class CmdPaintText : public CommandBase<Geometry> {
     void run(Geometry& target) const override {
         const auto start = std::chrono::high_resolution_clock::now();
 
-        const size_t textLength = mText.size();
-        size_t progress = 0;
-
-        for(const std::vector<Triangle>& letter : mText) {
-            target.getProgress().paintTextPercentage = static_cast<float>(progress) / textLength;
-            target.paintWithShape(mRay, letter, mColor);
-            ++progress;
-        }
+        // All letters are painted at once, the geometry reports the progress
+        target.getProgress().paintTextPercentage = 0.0f;
+        target.paintWithShapes(mRay, mText, mColor, mGridSize);
 
         const auto end = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double, std::milli> timeMs = end - start;
@@ -53,8 +61,9 @@ class CmdPaintText : public CommandBase<Geometry> {
         CI_LOG_I("Text paint took " + std::to_string(timeMs.count()) + " ms");
     }
 
-    std::vector<std::vector<Triangle>> mText;
+    std::vector<std::vector<Outline>> mText;
     ci::Ray mRay;
     size_t mColor;
+    double mGridSize;
 };
 }  // namespace pepr3d
\ No newline at end of file
@@ -15,8 +15,12 @@ class CommandBase {
      * @param isSlow Mark command as slow. CommandManager will create a snapshot after a slow command.
      * attempt will be made.
      * @param canBeJoined can this command be joined together with the command of the same type
+     * @param recordsDiff CommandManager records the changes done by this command (if the target supports it) and
+     * undoes or redoes them directly, without loading a snapshot and replaying the commands. Use for commands that
+     * change only a small part of the target.
      */
-    CommandBase(bool isSlow = false, bool canBeJoined = false) : mIsSlow(isSlow), mCanBeJoined(canBeJoined) {}
+    CommandBase(bool isSlow = false, bool canBeJoined = false, bool recordsDiff = false)
+        : mIsSlow(isSlow), mCanBeJoined(canBeJoined), mRecordsDiff(recordsDiff) {}
     virtual ~CommandBase() = default;
 
     /// Get description of the command
@@ -32,6 +36,11 @@ class CommandBase {
         return mCanBeJoined;
     }
 
+    /// Should CommandManager record a diff of the changes done by this command
+    bool recordsDiff() const {
+        return mRecordsDiff;
+    }
+
    protected:
     /// Run the command, applying the modifications to the target
     virtual void run(Target& target) const = 0;
@@ -47,6 +56,7 @@ class CommandBase {
    private:
     const bool mIsSlow;
     const bool mCanBeJoined;
+    const bool mRecordsDiff;
 };
 
 }  // namespace pepr3d
@@ -1,25 +1,102 @@
 #pragma once
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iterator>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <type_traits>
 #include <vector>
 #include "commands/Command.h"
+#include "MemoryUsageCounter.h"
 #include "peprassert.h"
 
 namespace pepr3d {
 
+/// Detects whether Target can record diffs of the changes done by a command, see CommandManager
+template <typename Target, typename = void>
+struct TargetDiffSupport : std::false_type {
+    struct DiffType {
+        void join(DiffType&&) {}
+    };
+};
+
+template <typename Target>
+struct TargetDiffSupport<Target, std::void_t<typename Target::DiffType>> : std::true_type {
+    using DiffType = typename Target::DiffType;
+};
+
+/// Detects whether Target can save its state in the background via saveStateAsync(), see CommandManager
+template <typename Target, typename = void>
+struct TargetAsyncSnapshot : std::false_type {};
+
+template <typename Target>
+struct TargetAsyncSnapshot<Target, std::void_t<decltype(std::declval<const Target>().saveStateAsync())>>
+    : std::true_type {};
+
+/// Detects whether a saved state or a diff can count its memory usage via
+/// void countMemoryUsage(MemoryUsageCounter&) const, see CommandManager
+template <typename Stored, typename = void>
+struct HistoryMemoryUsage : std::false_type {
+    static void count(const Stored&, MemoryUsageCounter& counter) {
+        counter.add(sizeof(Stored));
+    }
+};
+
+template <typename Stored>
+struct HistoryMemoryUsage<Stored, std::void_t<decltype(std::declval<const Stored>().countMemoryUsage(
+                                      std::declval<MemoryUsageCounter&>()))>> : std::true_type {
+    static void count(const Stored& stored, MemoryUsageCounter& counter) {
+        stored.countMemoryUsage(counter);
+    }
+};
+
+/// Detects whether Target can exclude the memory it still uses itself via
+/// void excludeLiveMemory(MemoryUsageCounter&) const, see CommandManager
+template <typename Target, typename = void>
+struct TargetLiveMemory {
+    static void exclude(const Target&, MemoryUsageCounter&) {}
+};
+
+template <typename Target>
+struct TargetLiveMemory<Target, std::void_t<decltype(std::declval<const Target>().excludeLiveMemory(
+                                    std::declval<MemoryUsageCounter&>()))>> {
+    static void exclude(const Target& target, MemoryUsageCounter& counter) {
+        target.excludeLiveMemory(counter);
+    }
+};
+
 /// CommandManager handles all undoable operations on target in the form of commands See @see
 /// CommandBase. All commands must be executed via the CommandManager Requirements for Target: Target
 /// must have a saveState() and loadState(State) methods
+/// Optionally Target can define a DiffType with join(DiffType&&) method and beginDiff(), DiffType endDiff(),
+/// revertDiff(const DiffType&) and applyDiff(const DiffType&) methods. Commands that record diffs are then undone and
+/// redone by applying their diff instead of loading a snapshot and replaying the commands after it.
+/// The snapshots and diffs are kept within a memory budget by dropping the diffs of old commands, saving snapshots less
+/// often and thinning out the old ones. Optionally the saved state and the diff can count their memory via
+/// countMemoryUsage(MemoryUsageCounter&), so data shared between them is counted once. Target can exclude the data it
+/// still uses itself via excludeLiveMemory(MemoryUsageCounter&). The usage is updated as snapshots and diffs are added
+/// and removed, countMemoryUsage() has to report the same memory every time it is called on the same object.
+/// Optionally Target can define std::shared_future<State> saveStateAsync() const, which captures the state in the
+/// background. The snapshot is then waited for only when it is needed by undo or redo.
 template <typename Target>
 class CommandManager {
    public:
     using CommandBaseType = CommandBase<Target>;
     using StateType = decltype(std::declval<const Target>().saveState());
+    using DiffSupport = TargetDiffSupport<Target>;
+    using DiffType = typename DiffSupport::DiffType;
 
     /// How often snapshots of the target should be saved (at minimum)
     static const int SNAPSHOT_FREQUENCY = 10;
 
+    /// Snapshots are never saved less often than this, even when over the memory budget
+    static const int MAX_SNAPSHOT_FREQUENCY = 160;
+
+    /// Default memory budget for snapshots in bytes
+    static const size_t DEFAULT_MEMORY_BUDGET = 512 * 1024 * 1024;
+
     /// Create a command manager that will be operating around a snapshottable target
     explicit CommandManager(Target& target) : mTarget(target) {}
 
@@ -50,15 +127,49 @@ class CommandManager {
         return mVersion;
     }
 
+    /// Set the memory budget for snapshots in bytes, the snapshots are thinned out immediately if it is exceeded
+    void setMemoryBudget(size_t bytes) {
+        mMemoryBudget = bytes;
+        enforceMemoryBudget();
+    }
+
+    size_t getMemoryBudget() const {
+        return mMemoryBudget;
+    }
+
+    /// Approximate number of bytes kept only by the snapshots and diffs, snapshots that are still being captured are
+    /// not counted. The data used by the target is excluded as of the last command, undo or redo.
+    size_t getMemoryUsage() const;
+
+    size_t getSnapshotCount() const {
+        return mTargetSnapshots.size();
+    }
+
+    /// Number of commands between two snapshots, raised from SNAPSHOT_FREQUENCY when over the memory budget
+    size_t getSnapshotFrequency() const {
+        return mSnapshotFrequency;
+    }
+
    private:
     Target& mTarget;
     /// Executed and possibly future commands
     std::vector<std::unique_ptr<CommandBaseType>> mCommandHistory;
 
+    /// Diff of each command in mCommandHistory, empty when the command did not record one
+    std::vector<std::optional<DiffType>> mCommandDiffs;
+
     /// Saved states of the target and commandId after them
     struct SnapshotPair {
-        StateType state;
+        /// Possibly still being captured in the background
+        std::shared_future<StateType> state;
         size_t nextCommandIdx;
+
+        /// Is the state counted in mMemoryUsage, it is counted once its capture finishes
+        mutable bool isCounted = false;
+
+        bool isReady() const {
+            return state.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
     };
 
     std::vector<SnapshotPair> mTargetSnapshots;
@@ -69,6 +180,45 @@ class CommandManager {
     /// Cumulative version number which gets incremented every single time a command is executed or Undo/Redo is done
     size_t mVersion = 0;
 
+    size_t mMemoryBudget = DEFAULT_MEMORY_BUDGET;
+
+    /// Current number of commands between two snapshots
+    size_t mSnapshotFrequency = SNAPSHOT_FREQUENCY;
+
+    /// Memory used by the counted snapshots and all diffs, see getMemoryUsage()
+    mutable MemoryUsageCounter mMemoryUsage;
+
+    /// Number of snapshots that are not counted in mMemoryUsage yet
+    mutable size_t mUncountedSnapshots = 0;
+
+    /// Is the data used by the target excluded from mMemoryUsage, reset whenever the target changes
+    mutable bool mIsLiveMemoryExcluded = false;
+
+    /// Add or remove a saved state or a diff from mMemoryUsage
+    template <typename Stored>
+    void countMemoryUsage(const Stored& stored, bool isRemoved) const;
+
+    /// Remove a snapshot from mMemoryUsage before it is erased
+    void uncountSnapshot(const SnapshotPair& snapshot);
+
+    /// Remove a diff from mMemoryUsage before it is reset or erased
+    void uncountDiff(const std::optional<DiffType>& diff);
+
+    /// Drop the diffs of old commands, then save snapshots less often and remove every other old snapshot, until the
+    /// history fits the memory budget
+    void enforceMemoryBudget();
+
+    /// Drop the diffs of the older half of the commands that still have one, they are replayed instead
+    /// @return false if there was no diff to drop
+    bool dropOldDiffs();
+
+    /// Remove every other snapshot, always keeping the first one and the one before the current command
+    /// @return false if no snapshot could be removed
+    bool thinSnapshots();
+
+    /// Save the state of the target, in the background if the target supports it
+    std::shared_future<StateType> captureState();
+
     void clearFutureState();
 
     /// Get snapshot before current state
@@ -82,6 +232,18 @@ class CommandManager {
 
     size_t getNumOfCommandsSinceSnapshot() const;
 
+    /// Run the command, recording its diff when both the command and the target support it
+    std::optional<DiffType> runCommand(const CommandBaseType& command);
+
+    /// Run the command from history again, using its diff if possible
+    void replayCommand(size_t commandIdx);
+
+    /// Was a diff recorded for this command from history
+    bool hasDiff(size_t commandIdx) const {
+        P_ASSERT(mCommandDiffs.size() == mCommandHistory.size());
+        return mCommandDiffs[commandIdx].has_value();
+    }
+
     CommandBaseType& getLastCommand() {
         // allow non const access for command manager
         const auto* constThis = static_cast<const decltype(this)>(this);
@@ -117,14 +279,30 @@ void CommandManager<Target>::execute(std::unique_ptr<CommandBaseType>&& command,
         // Save target's state every few commands
         if(shouldSaveState()) {
             const size_t nextCommandIdx = mCommandHistory.size() - mPosFromEnd;
-            mTargetSnapshots.push_back({mTarget.saveState(), nextCommandIdx});
+            mTargetSnapshots.push_back({captureState(), nextCommandIdx});
+            ++mUncountedSnapshots;
+            enforceMemoryBudget();
         }
 
-        command->run(mTarget);
+        mCommandDiffs.emplace_back(runCommand(*command));
+        if(mCommandDiffs.back()) {
+            countMemoryUsage(*mCommandDiffs.back(), false);
+        }
         mCommandHistory.emplace_back(std::move(command));
     } else {
-        command->run(mTarget);
+        std::optional<DiffType> diff = runCommand(*command);
+
+        // Joined command is undone as a whole, so its diff has to cover both commands
+        std::optional<DiffType>& lastDiff = mCommandDiffs.back();
+        uncountDiff(lastDiff);
+        if(lastDiff && diff) {
+            lastDiff->join(std::move(*diff));
+            countMemoryUsage(*lastDiff, false);
+        } else {
+            lastDiff.reset();
+        }
     }
+    mIsLiveMemoryExcluded = false;
 }
 
 template <typename Target>
@@ -136,12 +314,22 @@ void CommandManager<Target>::undo() {
     mVersion++;
 
     mPosFromEnd++;
+    mIsLiveMemoryExcluded = false;
+
+    const size_t undoneCommandIdx = mCommandHistory.size() - mPosFromEnd;
+    if constexpr(DiffSupport::value) {
+        if(hasDiff(undoneCommandIdx)) {
+            mTarget.revertDiff(*mCommandDiffs[undoneCommandIdx]);
+            return;
+        }
+    }
+
     auto prevSnapshotIt = getPrevSnapshotIterator();
-    mTarget.loadState(prevSnapshotIt->state);
+    mTarget.loadState(prevSnapshotIt->state.get());
 
     // Execute all commands between last snapshot and desired state
-    for(size_t i = prevSnapshotIt->nextCommandIdx; i < mCommandHistory.size() - mPosFromEnd; i++) {
-        mCommandHistory[i]->run(mTarget);
+    for(size_t i = prevSnapshotIt->nextCommandIdx; i < undoneCommandIdx; i++) {
+        replayCommand(i);
     }
 }
 
@@ -152,13 +340,16 @@ void CommandManager<Target>::redo() {
 
     // Increment the version counter
     mVersion++;
+    mIsLiveMemoryExcluded = false;
 
     const size_t nextCommandIdx = mCommandHistory.size() - mPosFromEnd;
-    if(mCommandHistory[nextCommandIdx]->isSlowCommand()) {
+    if(hasDiff(nextCommandIdx)) {
+        replayCommand(nextCommandIdx);
+    } else if(mCommandHistory[nextCommandIdx]->isSlowCommand()) {
         // Try to restore future snapshot to avoid doing a slow command again
         auto nextSnapshotIt = std::next(getPrevSnapshotIterator());
-        if(nextSnapshotIt != mTargetSnapshots.end()) {
-            mTarget.loadState(nextSnapshotIt->state);
+        if(nextSnapshotIt != mTargetSnapshots.end() && nextSnapshotIt->nextCommandIdx == nextCommandIdx + 1) {
+            mTarget.loadState(nextSnapshotIt->state.get());
         } else {
             mCommandHistory[nextCommandIdx]->run(mTarget);
         }
@@ -202,10 +393,16 @@ template <typename Target>
 void CommandManager<Target>::clearFutureState() {
     if(mPosFromEnd > 0) {
         // Clear all future snapshots
-        mTargetSnapshots.erase(std::next(getPrevSnapshotIterator()), mTargetSnapshots.end());
+        const auto futureSnapshotsIt = std::next(getPrevSnapshotIterator());
+        std::for_each(futureSnapshotsIt, mTargetSnapshots.cend(),
+                      [this](const SnapshotPair& snapshot) { uncountSnapshot(snapshot); });
+        mTargetSnapshots.erase(futureSnapshotsIt, mTargetSnapshots.end());
 
         // Clear all future commands
+        std::for_each(std::prev(mCommandDiffs.cend(), mPosFromEnd), mCommandDiffs.cend(),
+                      [this](const std::optional<DiffType>& diff) { uncountDiff(diff); });
         mCommandHistory.erase(std::prev(mCommandHistory.end(), mPosFromEnd), mCommandHistory.end());
+        mCommandDiffs.erase(std::prev(mCommandDiffs.end(), mPosFromEnd), mCommandDiffs.end());
 
         mPosFromEnd = 0;
     }
@@ -219,8 +416,138 @@ bool CommandManager<Target>::shouldSaveState() const {
 
     const size_t commandsSinceSnapshot = getNumOfCommandsSinceSnapshot();
 
-    return (canUndo() && getLastCommand().isSlowCommand() && commandsSinceSnapshot != 0) ||
-           commandsSinceSnapshot >= SNAPSHOT_FREQUENCY;
+    // Slow commands with a diff are cheap to replay, they do not need a snapshot of their own
+    const bool lastIsSlow = canUndo() && getLastCommand().isSlowCommand() &&
+                            !hasDiff(mCommandHistory.size() - mPosFromEnd - 1);
+
+    return (lastIsSlow && commandsSinceSnapshot != 0) || commandsSinceSnapshot >= mSnapshotFrequency;
+}
+
+template <typename Target>
+size_t CommandManager<Target>::getMemoryUsage() const {
+    // Count the snapshots whose capture finished since the last call
+    if(mUncountedSnapshots > 0) {
+        for(const SnapshotPair& snapshot : mTargetSnapshots) {
+            if(!snapshot.isCounted && snapshot.isReady()) {
+                countMemoryUsage(snapshot.state.get(), false);
+                snapshot.isCounted = true;
+                --mUncountedSnapshots;
+            }
+        }
+    }
+
+    if(!mIsLiveMemoryExcluded) {
+        mMemoryUsage.clearExcluded();
+        TargetLiveMemory<Target>::exclude(mTarget, mMemoryUsage);
+        mIsLiveMemoryExcluded = true;
+    }
+    return mMemoryUsage.getBytes();
+}
+
+template <typename Target>
+template <typename Stored>
+void CommandManager<Target>::countMemoryUsage(const Stored& stored, bool isRemoved) const {
+    const auto countStored = [&stored](MemoryUsageCounter& counter) {
+        HistoryMemoryUsage<Stored>::count(stored, counter);
+    };
+    if(isRemoved) {
+        mMemoryUsage.removeEntry(countStored);
+    } else {
+        mMemoryUsage.addEntry(countStored);
+    }
+}
+
+template <typename Target>
+void CommandManager<Target>::uncountSnapshot(const SnapshotPair& snapshot) {
+    if(snapshot.isCounted) {
+        countMemoryUsage(snapshot.state.get(), true);
+    } else {
+        P_ASSERT(mUncountedSnapshots > 0);
+        --mUncountedSnapshots;
+    }
+}
+
+template <typename Target>
+void CommandManager<Target>::uncountDiff(const std::optional<DiffType>& diff) {
+    if(diff) {
+        countMemoryUsage(*diff, true);
+    }
+}
+
+template <typename Target>
+void CommandManager<Target>::enforceMemoryBudget() {
+    size_t usage = getMemoryUsage();
+
+    // Go back to more frequent snapshots once there is plenty of memory again
+    if(mSnapshotFrequency > static_cast<size_t>(SNAPSHOT_FREQUENCY) && usage < mMemoryBudget / 4) {
+        mSnapshotFrequency /= 2;
+    }
+
+    while(usage > mMemoryBudget) {
+        // Old commands are undone rarely, replaying them is cheaper than keeping their diffs
+        if(!dropOldDiffs()) {
+            if(mTargetSnapshots.size() <= 2 || !thinSnapshots()) {
+                break;
+            }
+            mSnapshotFrequency = std::min(mSnapshotFrequency * 2, static_cast<size_t>(MAX_SNAPSHOT_FREQUENCY));
+        }
+
+        usage = getMemoryUsage();
+    }
+}
+
+template <typename Target>
+bool CommandManager<Target>::dropOldDiffs() {
+    const size_t diffCount =
+        static_cast<size_t>(std::count_if(mCommandDiffs.begin(), mCommandDiffs.end(),
+                                          [](const std::optional<DiffType>& diff) { return diff.has_value(); }));
+    size_t toDrop = (diffCount + 1) / 2;
+    for(std::optional<DiffType>& diff : mCommandDiffs) {
+        if(toDrop == 0) {
+            break;
+        }
+        if(diff) {
+            uncountDiff(diff);
+            diff.reset();
+            --toDrop;
+        }
+    }
+    return diffCount > 0;
+}
+
+template <typename Target>
+bool CommandManager<Target>::thinSnapshots() {
+    const size_t snapshotCount = mTargetSnapshots.size();
+    const size_t currentSnapshotIdx = std::distance(mTargetSnapshots.cbegin(), getPrevSnapshotIterator());
+    std::vector<SnapshotPair> keptSnapshots;
+    keptSnapshots.reserve(snapshotCount / 2 + 2);
+    for(size_t i = 0; i < snapshotCount; ++i) {
+        if(i % 2 == 0 || i == currentSnapshotIdx) {
+            keptSnapshots.push_back(std::move(mTargetSnapshots[i]));
+        } else {
+            uncountSnapshot(mTargetSnapshots[i]);
+        }
+    }
+    mTargetSnapshots = std::move(keptSnapshots);
+
+    // Every other snapshot was the current one, future snapshots are only a shortcut for redo
+    if(mTargetSnapshots.size() == snapshotCount && currentSnapshotIdx + 1 < snapshotCount) {
+        std::for_each(std::next(mTargetSnapshots.cbegin(), currentSnapshotIdx + 1), mTargetSnapshots.cend(),
+                      [this](const SnapshotPair& snapshot) { uncountSnapshot(snapshot); });
+        mTargetSnapshots.erase(std::next(mTargetSnapshots.begin(), currentSnapshotIdx + 1), mTargetSnapshots.end());
+    }
+    return mTargetSnapshots.size() < snapshotCount;
+}
+
+template <typename Target>
+auto CommandManager<Target>::captureState() -> std::shared_future<StateType> {
+    if constexpr(TargetAsyncSnapshot<Target>::value) {
+        return mTarget.saveStateAsync();
+    } else {
+        std::promise<StateType> state;
+        state.set_value(mTarget.saveState());
+        return state.get_future().share();
+    }
 }
 
 template <typename Target>
@@ -231,6 +558,7 @@ bool CommandManager<Target>::joinWithLastCommand(CommandBaseType& command) {
     if(getLastCommand().joinCommand(command)) {
         // If the command that got modified has a valid snapshot in front of it destroy it
         if(getNumOfCommandsSinceSnapshot() == 0) {
+            uncountSnapshot(mTargetSnapshots.back());
             mTargetSnapshots.erase(std::prev(mTargetSnapshots.end()), mTargetSnapshots.end());
         }
         return true;
@@ -245,4 +573,35 @@ size_t CommandManager<Target>::getNumOfCommandsSinceSnapshot() const {
     return nextCommandIdx - (getPrevSnapshotIterator()->nextCommandIdx - 1);
 }
 
+template <typename Target>
+auto CommandManager<Target>::runCommand(const CommandBaseType& command) -> std::optional<DiffType> {
+    if constexpr(DiffSupport::value) {
+        if(command.recordsDiff()) {
+            mTarget.beginDiff();
+            try {
+                command.run(mTarget);
+            } catch(...) {
+                mTarget.endDiff();
+                throw;
+            }
+            return mTarget.endDiff();
+        }
+    }
+
+    command.run(mTarget);
+    return {};
+}
+
+template <typename Target>
+void CommandManager<Target>::replayCommand(size_t commandIdx) {
+    if constexpr(DiffSupport::value) {
+        if(hasDiff(commandIdx)) {
+            mTarget.applyDiff(*mCommandDiffs[commandIdx]);
+            return;
+        }
+    }
+
+    mCommandHistory[commandIdx]->run(mTarget);
+}
+
 }  // namespace pepr3d
@@ -1,6 +1,7 @@
 #include "commands/CommandManager.h"
 #ifdef _TEST_
 #include <gtest/gtest.h>
+#include <future>
 #include <vector>
 
 namespace pepr3d {
@@ -110,6 +111,118 @@ class CmdAddValueJoinableSlow : public CommandBase<MockTarget> {
     int mAddedValue;
 };
 
+/// Target that records the value before and after each command as its diff
+struct MockDiffTarget {
+    struct DiffType {
+        int before;
+        int after;
+
+        void join(DiffType&& later) {
+            after = later.after;
+        }
+    };
+
+    int mInnerValue = 0;
+    int mRunCount = 0;
+    int mLoadCount = 0;
+    int mDiffStart = 0;
+
+    int saveState() const {
+        return mInnerValue;
+    };
+
+    void loadState(int newState) {
+        mInnerValue = newState;
+        mLoadCount++;
+    }
+
+    void beginDiff() {
+        mDiffStart = mInnerValue;
+    }
+
+    DiffType endDiff() {
+        return DiffType{mDiffStart, mInnerValue};
+    }
+
+    void revertDiff(const DiffType& diff) {
+        mInnerValue = diff.before;
+    }
+
+    void applyDiff(const DiffType& diff) {
+        mInnerValue = diff.after;
+    }
+};
+
+template <bool RecordsDiff>
+class CmdAddValueToDiffTarget : public CommandBase<MockDiffTarget> {
+   public:
+    virtual std::string_view getDescription() const override {
+        return "IncreaseVal";
+    }
+
+    explicit CmdAddValueToDiffTarget(int addedValue = 1)
+        : CommandBase(true, true, RecordsDiff), mAddedValue(addedValue) {}
+
+   protected:
+    virtual void run(MockDiffTarget& target) const override {
+        target.mInnerValue += mAddedValue;
+        target.mRunCount++;
+    }
+
+    virtual bool joinCommand(const CommandBase<MockDiffTarget>& otherBase) override {
+        const auto* other = dynamic_cast<const CmdAddValueToDiffTarget*>(&otherBase);
+        if(other) {
+            mAddedValue += other->mAddedValue;
+            return true;
+        }
+        return false;
+    }
+
+    int mAddedValue;
+};
+
+/// Target whose state captures are finished only when the test says so
+struct MockAsyncTarget {
+    int mInnerValue = 0;
+    mutable std::vector<std::pair<std::promise<int>, int>> mPendingCaptures;
+
+    int saveState() const {
+        return mInnerValue;
+    };
+
+    std::shared_future<int> saveStateAsync() const {
+        auto& capture = mPendingCaptures.emplace_back(std::promise<int>(), mInnerValue);
+        return capture.first.get_future().share();
+    }
+
+    void finishCaptures() {
+        for(auto& capture : mPendingCaptures) {
+            capture.first.set_value(capture.second);
+        }
+        mPendingCaptures.clear();
+    }
+
+    void loadState(int newState) {
+        mInnerValue = newState;
+    }
+};
+
+class CmdAddValueToAsyncTarget : public CommandBase<MockAsyncTarget> {
+   public:
+    virtual std::string_view getDescription() const override {
+        return "IncreaseVal";
+    }
+
+    explicit CmdAddValueToAsyncTarget(int addedValue = 1) : mAddedValue(addedValue) {}
+
+   protected:
+    virtual void run(MockAsyncTarget& target) const override {
+        target.mInnerValue += mAddedValue;
+    }
+
+    int mAddedValue;
+};
+
 TEST(CommandManager, Undo) {
     /**
      * Test that undo is available and undoes the correct command
@@ -349,5 +462,248 @@ TEST(CommandManager, JoinRemovesSnapshot) {
     EXPECT_EQ(target.mInnerValue, 11);
 }
 
+TEST(CommandManager, DiffUndoRedo) {
+    /**
+     * Test that commands with diffs are undone and redone without running them again, mixed with commands without
+     * diffs that still use snapshots
+     */
+
+    MockDiffTarget target{};
+    CommandManager<MockDiffTarget> cm(target);
+
+    std::vector<int> valueHistory = {target.mInnerValue};
+    const auto maxSteps = 5 * CommandManager<MockDiffTarget>::SNAPSHOT_FREQUENCY + 1;
+
+    for(int i = 0; i < maxSteps; i++) {
+        if(i % 3 == 0) {
+            cm.execute(make_unique<CmdAddValueToDiffTarget<false>>(i));
+        } else {
+            cm.execute(make_unique<CmdAddValueToDiffTarget<true>>(i));
+        }
+        valueHistory.push_back(target.mInnerValue);
+    }
+
+    // Undo everything
+    for(int i = 0; i < maxSteps; i++) {
+        ASSERT_TRUE(cm.canUndo());
+        const bool lastHasDiff = (maxSteps - 1 - i) % 3 != 0;
+        const int runCount = target.mRunCount;
+        const int loadCount = target.mLoadCount;
+
+        cm.undo();
+        valueHistory.pop_back();
+        EXPECT_EQ(target.mInnerValue, valueHistory.back());
+
+        if(lastHasDiff) {
+            EXPECT_EQ(target.mRunCount, runCount);
+            EXPECT_EQ(target.mLoadCount, loadCount);
+        }
+    }
+    EXPECT_FALSE(cm.canUndo());
+
+    // Redo everything, commands with diffs do not run again
+    int expectedValue = 0;
+    for(int i = 0; i < maxSteps; i++) {
+        ASSERT_TRUE(cm.canRedo());
+        const int runCount = target.mRunCount;
+
+        cm.redo();
+        expectedValue += i;
+        EXPECT_EQ(target.mInnerValue, expectedValue);
+
+        if(i % 3 != 0) {
+            EXPECT_EQ(target.mRunCount, runCount);
+        }
+    }
+    EXPECT_FALSE(cm.canRedo());
+}
+
+TEST(CommandManager, DiffJoin) {
+    /**
+     * Test that diffs of joined commands cover all of the joined commands
+     */
+
+    MockDiffTarget target{};
+    CommandManager<MockDiffTarget> cm(target);
+
+    cm.execute(make_unique<CmdAddValueToDiffTarget<true>>(5));
+    for(int i = 0; i < 20; i++) {
+        cm.execute(make_unique<CmdAddValueToDiffTarget<true>>(1), true);
+    }
+    EXPECT_EQ(target.mInnerValue, 25);
+
+    cm.undo();
+    EXPECT_EQ(target.mInnerValue, 0);
+    EXPECT_FALSE(cm.canUndo());
+
+    cm.redo();
+    EXPECT_EQ(target.mInnerValue, 25);
+}
+
+TEST(CommandManager, MemoryBudget) {
+    /**
+     * Test that snapshots are thinned out to fit the memory budget and undo still works
+     */
+
+    MockTarget target{};
+    CommandManager<MockTarget> cm(target);
+    const size_t maxSnapshots = 5;
+    cm.setMemoryBudget(maxSnapshots * sizeof(int));
+
+    std::vector<int> valueHistory = {target.mInnerValue};
+    const int maxSteps = 20 * CommandManager<MockTarget>::SNAPSHOT_FREQUENCY + 1;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddValue>(i));
+        valueHistory.push_back(target.mInnerValue);
+        EXPECT_LE(cm.getMemoryUsage(), cm.getMemoryBudget());
+    }
+
+    EXPECT_LE(cm.getSnapshotCount(), maxSnapshots);
+    EXPECT_GT(cm.getSnapshotFrequency(), static_cast<size_t>(CommandManager<MockTarget>::SNAPSHOT_FREQUENCY));
+    EXPECT_EQ(cm.getMemoryUsage(), cm.getSnapshotCount() * sizeof(int));
+
+    for(int i = 0; i < maxSteps; i++) {
+        ASSERT_TRUE(cm.canUndo());
+        cm.undo();
+        valueHistory.pop_back();
+        EXPECT_EQ(target.mInnerValue, valueHistory.back());
+    }
+    EXPECT_FALSE(cm.canUndo());
+
+    // Lifting the budget makes snapshots frequent again
+    const size_t raisedFrequency = cm.getSnapshotFrequency();
+    cm.setMemoryBudget(CommandManager<MockTarget>::DEFAULT_MEMORY_BUDGET);
+    EXPECT_LT(cm.getSnapshotFrequency(), raisedFrequency);
+}
+
+TEST(CommandManager, MemoryBudgetBelowKeptSnapshots) {
+    /**
+     * Test that a budget too small for the snapshots that cannot be thinned out does not stall and redo still works
+     */
+
+    MockTarget target{};
+    CommandManager<MockTarget> cm(target);
+
+    // Snapshots before the first, the 11th and the 21st command
+    std::vector<int> valueHistory = {target.mInnerValue};
+    const int maxSteps = 2 * CommandManager<MockTarget>::SNAPSHOT_FREQUENCY + 1;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddValue>(i));
+        valueHistory.push_back(target.mInnerValue);
+    }
+    ASSERT_EQ(cm.getSnapshotCount(), 3);
+
+    // The current snapshot is the middle one, every other snapshot is kept when thinning
+    const int undoneSteps = 5;
+    for(int i = 0; i < undoneSteps; i++) {
+        cm.undo();
+    }
+
+    cm.setMemoryBudget(sizeof(int));
+    EXPECT_EQ(cm.getSnapshotCount(), 2);
+    EXPECT_EQ(cm.getMemoryUsage(), cm.getSnapshotCount() * sizeof(int));
+
+    for(int i = 0; i < undoneSteps; i++) {
+        ASSERT_TRUE(cm.canRedo());
+        cm.redo();
+    }
+    EXPECT_EQ(target.mInnerValue, valueHistory.back());
+}
+
+TEST(CommandManager, MemoryBudgetDropsDiffs) {
+    /**
+     * Test that diffs of old commands are dropped to fit the memory budget and undo replays those commands instead
+     */
+
+    MockDiffTarget target{};
+    CommandManager<MockDiffTarget> cm(target);
+
+    std::vector<int> valueHistory = {target.mInnerValue};
+    const int maxSteps = CommandManager<MockDiffTarget>::SNAPSHOT_FREQUENCY + 1;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddValueToDiffTarget<true>>(i));
+        valueHistory.push_back(target.mInnerValue);
+    }
+    const size_t snapshotUsage = cm.getSnapshotCount() * sizeof(int);
+    EXPECT_EQ(cm.getMemoryUsage(), snapshotUsage + maxSteps * sizeof(MockDiffTarget::DiffType));
+
+    // Snapshots fit, only some of the diffs do
+    const size_t keptDiffs = 3;
+    cm.setMemoryBudget(snapshotUsage + keptDiffs * sizeof(MockDiffTarget::DiffType));
+    EXPECT_LE(cm.getMemoryUsage(), cm.getMemoryBudget());
+    EXPECT_GT(cm.getMemoryUsage(), snapshotUsage);
+
+    for(int i = 0; i < maxSteps; i++) {
+        ASSERT_TRUE(cm.canUndo());
+        cm.undo();
+        valueHistory.pop_back();
+        EXPECT_EQ(target.mInnerValue, valueHistory.back());
+    }
+    EXPECT_FALSE(cm.canUndo());
+}
+
+TEST(CommandManager, MemoryUsageFollowsHistory) {
+    /**
+     * Test that the memory usage is updated when future commands are cleared and commands are joined
+     */
+
+    MockDiffTarget target{};
+    CommandManager<MockDiffTarget> cm(target);
+    const size_t diffSize = sizeof(MockDiffTarget::DiffType);
+
+    const int maxSteps = 2 * CommandManager<MockDiffTarget>::SNAPSHOT_FREQUENCY + 5;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddValueToDiffTarget<true>>(i));
+    }
+    EXPECT_EQ(cm.getMemoryUsage(), cm.getSnapshotCount() * sizeof(int) + maxSteps * diffSize);
+
+    // Undone commands are still counted until a new command clears them
+    const int undoneSteps = CommandManager<MockDiffTarget>::SNAPSHOT_FREQUENCY + 2;
+    for(int i = 0; i < undoneSteps; i++) {
+        cm.undo();
+    }
+    EXPECT_EQ(cm.getMemoryUsage(), cm.getSnapshotCount() * sizeof(int) + maxSteps * diffSize);
+
+    cm.execute(make_unique<CmdAddValueToDiffTarget<true>>(1));
+    const size_t keptSteps = maxSteps - undoneSteps + 1;
+    EXPECT_EQ(cm.getMemoryUsage(), cm.getSnapshotCount() * sizeof(int) + keptSteps * diffSize);
+
+    // Joined command keeps a single diff
+    cm.execute(make_unique<CmdAddValueToDiffTarget<true>>(1), true);
+    EXPECT_EQ(cm.getMemoryUsage(), cm.getSnapshotCount() * sizeof(int) + keptSteps * diffSize);
+}
+
+TEST(CommandManager, AsyncSnapshots) {
+    /**
+     * Test that commands do not wait for snapshots captured in the background and undo uses them once finished
+     */
+
+    MockAsyncTarget target{};
+    CommandManager<MockAsyncTarget> cm(target);
+
+    std::vector<int> valueHistory = {target.mInnerValue};
+    const int maxSteps = 3 * CommandManager<MockAsyncTarget>::SNAPSHOT_FREQUENCY + 1;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddValueToAsyncTarget>(i));
+        valueHistory.push_back(target.mInnerValue);
+    }
+
+    // No capture has finished yet, but all commands were executed
+    EXPECT_EQ(target.mInnerValue, valueHistory.back());
+    EXPECT_EQ(target.mPendingCaptures.size(), cm.getSnapshotCount());
+    EXPECT_EQ(cm.getMemoryUsage(), 0);
+
+    target.finishCaptures();
+    EXPECT_EQ(cm.getMemoryUsage(), cm.getSnapshotCount() * sizeof(int));
+
+    for(int i = 0; i < maxSteps; i++) {
+        ASSERT_TRUE(cm.canUndo());
+        cm.undo();
+        valueHistory.pop_back();
+        EXPECT_EQ(target.mInnerValue, valueHistory.back());
+    }
+    EXPECT_FALSE(cm.canUndo());
+}
+
 }  // namespace pepr3d
 #endif
@@ -2,6 +2,8 @@
 
 #include <cereal/archives/binary.hpp>
 #include <cereal/types/vector.hpp>
+#include <algorithm>
+#include <numeric>
 #include <random>
 #include <vector>
 #include "cinder/Color.h"
@@ -13,15 +15,37 @@
 namespace pepr3d {
 
 /// Represents a color palette, i.e., all colors and a selected active color
+/// Colors are identified by color ids, which are stored in the Geometry and index the color map. The order in which
+/// colors are shown in the palette is kept separately, so reordering the palette does not change any color ids.
 class ColorManager {
    public:
     using ColorMap = std::vector<glm::vec4>;
 
+    /// Color ids in the order of the palette
+    using ColorOrder = std::vector<size_t>;
+
+    /// All colors and their order, used to save and restore the palette
+    struct Palette {
+        ColorMap colors;
+        ColorOrder order;
+
+        bool operator==(const Palette& other) const {
+            return colors == other.colors && order == other.order;
+        }
+
+        bool operator!=(const Palette& other) const {
+            return !(*this == other);
+        }
+    };
+
    private:
-    /// A vector containing all the colors that the application supports at this time
+    /// A vector containing all the colors that the application supports at this time, indexed by color id
     ColorMap mColorMap;
 
-    /// Index of a currently selected / active color
+    /// Color id at each position of the palette
+    ColorOrder mColorOrder;
+
+    /// Color id of a currently selected / active color
     size_t mActiveColorIndex = 0;
 
     friend class cereal::access;
@@ -33,6 +57,7 @@ class ColorManager {
         mColorMap.push_back(static_cast<glm::vec4>(ci::ColorA::hex(0xF2994A)));
         mColorMap.push_back(static_cast<glm::vec4>(ci::ColorA::hex(0x292E33)));
         P_ASSERT(mColorMap.size() <= PEPR3D_MAX_PALETTE_COLORS);
+        resetColorOrder();
     }
 
     ColorManager(const ColorMap::const_iterator start, const ColorMap::const_iterator end) {
@@ -41,9 +66,10 @@ class ColorManager {
 
     explicit ColorManager(const size_t number) {
         generateColors(number, mColorMap);
+        resetColorOrder();
     }
 
-    /// Return the i-th color
+    /// Return the color with color id i
     glm::vec4 getColor(const size_t i) const {
         P_ASSERT(i < mColorMap.size());
         return mColorMap[i];
@@ -62,17 +88,117 @@ class ColorManager {
     /// Clears all colors and becomes empty
     void clear() {
         mColorMap.clear();
+        mColorOrder.clear();
     }
 
-    /// Adds a new color if not above limit
+    /// Adds a new color to the end of the palette if not above limit
     void addColor(const glm::vec4 newColor) {
         if(size() < PEPR3D_MAX_PALETTE_COLORS) {
+            mColorOrder.push_back(mColorMap.size());
             mColorMap.push_back(newColor);
         }
         P_ASSERT(mColorMap.size() <= PEPR3D_MAX_PALETTE_COLORS);
     }
 
-    /// Set the i-th color to a new color
+    /// Color id of the color at the position in the palette
+    size_t getColorId(const size_t position) const {
+        P_ASSERT(position < mColorOrder.size());
+        return mColorOrder[position];
+    }
+
+    /// Position of the color in the palette
+    size_t getColorPosition(const size_t colorId) const {
+        auto it = std::find(mColorOrder.begin(), mColorOrder.end(), colorId);
+        P_ASSERT(it != mColorOrder.end());
+        return static_cast<size_t>(it - mColorOrder.begin());
+    }
+
+    const ColorOrder& getColorOrder() const {
+        return mColorOrder;
+    }
+
+    /// Are the colors shown in the order of their ids
+    bool isInIdOrder() const {
+        for(size_t i = 0; i < mColorOrder.size(); ++i) {
+            if(mColorOrder[i] != i) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Swap two colors in the palette without changing any color ids, i.e., the model keeps its look
+    void reorderColors(const size_t position1, const size_t position2) {
+        P_ASSERT(position1 < size() && position2 < size());
+        std::swap(mColorOrder[position1], mColorOrder[position2]);
+    }
+
+    /// Swap the values of two colors of the palette, i.e., the model swaps the colors too
+    void swapColors(const size_t position1, const size_t position2) {
+        P_ASSERT(position1 < size() && position2 < size());
+        std::swap(mColorMap[mColorOrder[position1]], mColorMap[mColorOrder[position2]]);
+    }
+
+    /// Remove the color at the position of the palette. The last color id takes the id of the removed color, so that
+    /// the ids stay in the range [0, size()).
+    /// @return Lookup table from the old color ids to the new ones, the removed color is replaced by the first color
+    std::vector<size_t> removeColor(const size_t position) {
+        P_ASSERT(position < size());
+        P_ASSERT(size() > 1);
+
+        const size_t removedId = mColorOrder[position];
+        const size_t lastId = mColorMap.size() - 1;
+        mColorOrder.erase(mColorOrder.begin() + position);
+
+        std::vector<size_t> newIds(mColorMap.size());
+        std::iota(newIds.begin(), newIds.end(), 0);
+        if(removedId != lastId) {
+            mColorMap[removedId] = mColorMap[lastId];
+            newIds[lastId] = removedId;
+            std::replace(mColorOrder.begin(), mColorOrder.end(), lastId, removedId);
+        }
+        mColorMap.pop_back();
+        newIds[removedId] = getColorId(0);
+
+        mActiveColorIndex = newIds[mActiveColorIndex];
+        return newIds;
+    }
+
+    /// Lookup table from the color ids to the positions of the colors in the palette
+    std::vector<size_t> getColorPositions() const {
+        std::vector<size_t> positions(mColorOrder.size());
+        for(size_t i = 0; i < mColorOrder.size(); ++i) {
+            positions[mColorOrder[i]] = i;
+        }
+        return positions;
+    }
+
+    /// Copy of this palette with color ids equal to the positions in the palette, see getColorPositions()
+    ColorManager getWithIdsInPaletteOrder() const {
+        ColorManager result(*this);
+        for(size_t i = 0; i < mColorOrder.size(); ++i) {
+            result.mColorMap[i] = mColorMap[mColorOrder[i]];
+        }
+        result.resetColorOrder();
+        result.mActiveColorIndex = getColorPosition(mActiveColorIndex);
+        return result;
+    }
+
+    Palette getPalette() const {
+        return Palette{mColorMap, mColorOrder};
+    }
+
+    /// Restore colors and their order, keeps the active color if it still exists
+    void setPalette(const Palette& palette) {
+        P_ASSERT(palette.colors.size() == palette.order.size());
+        mColorMap = palette.colors;
+        mColorOrder = palette.order;
+        if(mActiveColorIndex >= size()) {
+            mActiveColorIndex = size() - 1;
+        }
+    }
+
+    /// Set the color with color id i to a new color
     void setColor(const size_t i, const glm::vec4 newColor) {
         P_ASSERT(i < mColorMap.size());
         mColorMap[i] = newColor;
@@ -87,6 +213,7 @@ class ColorManager {
             mColorMap.push_back(*it);
             ++it;
         }
+        resetColorOrder();
         if(mActiveColorIndex >= size()) {
             mActiveColorIndex = size() - 1;
         }
@@ -98,17 +225,18 @@ class ColorManager {
         if(mColorMap.size() > PEPR3D_MAX_PALETTE_COLORS) {
             mColorMap.resize(PEPR3D_MAX_PALETTE_COLORS);
         }
+        resetColorOrder();
         if(mActiveColorIndex >= size()) {
             mActiveColorIndex = size() - 1;
         }
     }
 
-    /// Gets index of the currently selected / active color
+    /// Gets color id of the currently selected / active color
     size_t getActiveColorIndex() const {
         return mActiveColorIndex;
     }
 
-    /// Sets index of the currently selected / active color, safely checks boundaries
+    /// Sets color id of the currently selected / active color, safely checks boundaries
     void setActiveColorIndex(size_t index) {
         mActiveColorIndex = std::min<size_t>(std::max<size_t>(index, 0), size() - 1);
     }
@@ -117,10 +245,7 @@ class ColorManager {
         return mColorMap[mActiveColorIndex];
     }
 
-    ColorMap& getColorMap() {
-        return mColorMap;
-    }
-
+    /// Colors indexed by color id
     const ColorMap& getColorMap() const {
         return mColorMap;
     }
@@ -145,10 +270,25 @@ class ColorManager {
     }
 
    private:
+    /// Show the colors in the order of their ids
+    void resetColorOrder() {
+        mColorOrder.resize(mColorMap.size());
+        std::iota(mColorOrder.begin(), mColorOrder.end(), 0);
+    }
+
+    /// Only the colors are saved, the loaded palette is in the order of color ids.
+    /// Use getWithIdsInPaletteOrder() to save a reordered palette.
+    template <class Archive>
+    void save(Archive& ar) const {
+        ar(mColorMap);
+        ar(mActiveColorIndex);
+    }
+
     template <class Archive>
-    void serialize(Archive& ar) {
+    void load(Archive& ar) {
         ar(mColorMap);
         ar(mActiveColorIndex);
+        resetColorOrder();
     }
 };
 
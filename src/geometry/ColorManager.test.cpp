@@ -208,4 +208,69 @@ TEST(ColorManager, constructor_color_generation) {
     pepr3d::ColorManager cm(PEPR3D_MAX_PALETTE_COLORS);
     EXPECT_EQ(cm.size(), PEPR3D_MAX_PALETTE_COLORS);
 }
-#endif
\ No newline at end of file
+TEST(ColorManager, reorderColors) {
+    /**
+     * Test that reordering the palette keeps the color ids and swapping changes the colors
+     */
+
+    pepr3d::ColorManager cm;
+    const pepr3d::ColorManager::ColorMap originalColors = cm.getColorMap();
+    EXPECT_TRUE(cm.isInIdOrder());
+
+    cm.reorderColors(0, 2);
+    EXPECT_FALSE(cm.isInIdOrder());
+    EXPECT_EQ(cm.getColorMap(), originalColors);
+    EXPECT_EQ(cm.getColorId(0), 2);
+    EXPECT_EQ(cm.getColorId(2), 0);
+    EXPECT_EQ(cm.getColorPosition(2), 0);
+    EXPECT_EQ(cm.getColorPositions(), (std::vector<size_t>{2, 1, 0, 3}));
+
+    // Positions 0 and 3 are color ids 2 and 3
+    cm.swapColors(0, 3);
+    EXPECT_EQ(cm.getColor(2), originalColors[3]);
+    EXPECT_EQ(cm.getColor(3), originalColors[2]);
+    EXPECT_EQ(cm.getColorId(0), 2);
+
+    const pepr3d::ColorManager ordered = cm.getWithIdsInPaletteOrder();
+    EXPECT_TRUE(ordered.isInIdOrder());
+    for(size_t position = 0; position < cm.size(); ++position) {
+        EXPECT_EQ(ordered.getColor(position), cm.getColor(cm.getColorId(position)));
+    }
+
+    const pepr3d::ColorManager::Palette palette = cm.getPalette();
+    pepr3d::ColorManager restored;
+    restored.setPalette(palette);
+    EXPECT_EQ(restored.getPalette(), palette);
+}
+
+TEST(ColorManager, removeColor) {
+    /**
+     * Test that removing a color keeps the color ids dense and returns the correct lookup table
+     */
+
+    pepr3d::ColorManager cm;
+    const pepr3d::ColorManager::ColorMap originalColors = cm.getColorMap();
+    cm.reorderColors(0, 3);
+    cm.setActiveColorIndex(3);
+
+    // Remove color id 1, color id 3 takes its place
+    const std::vector<size_t> newColorIds = cm.removeColor(1);
+    EXPECT_EQ(cm.size(), 3);
+    ASSERT_EQ(newColorIds.size(), 4);
+    EXPECT_EQ(newColorIds[0], 0);
+    EXPECT_EQ(newColorIds[2], 2);
+    EXPECT_EQ(newColorIds[3], 1);
+    EXPECT_EQ(newColorIds[1], cm.getColorId(0));
+    EXPECT_EQ(cm.getColor(newColorIds[1]), originalColors[3]);
+    EXPECT_EQ(cm.getActiveColorIndex(), 1);
+
+    for(size_t oldId = 0; oldId < originalColors.size(); ++oldId) {
+        if(oldId != 1) {
+            EXPECT_EQ(cm.getColor(newColorIds[oldId]), originalColors[oldId]);
+        }
+    }
+    EXPECT_EQ(cm.getColor(cm.getColorId(0)), originalColors[3]);
+    EXPECT_EQ(cm.getColor(cm.getColorId(1)), originalColors[2]);
+    EXPECT_EQ(cm.getColor(cm.getColorId(2)), originalColors[0]);
+}
+#endif
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Immutable array of color indices stored in as little memory as possible.
+/// Colors are stored as run-length encoded runs when the array has large areas of the same color (the usual case for
+/// a painted model), one byte per color otherwise. Used to keep the snapshots of the Geometry small.
+class CompactColorArray {
+   public:
+    CompactColorArray() = default;
+
+    /// Compress colors
+    /// @param size Number of colors in the array
+    /// @param getColor functor of type size_t func(size_t index), returning color at the index
+    template <typename ColorGetter>
+    CompactColorArray(size_t size, const ColorGetter& getColor) : mSize(size) {
+        for(size_t i = 0; i < size; ++i) {
+            const size_t color = getColor(i);
+            P_ASSERT(color <= UINT8_MAX);
+            if(mRuns.empty() || mRuns.back().color != color) {
+                mRuns.push_back({static_cast<uint32_t>(i + 1), static_cast<uint8_t>(color)});
+            } else {
+                mRuns.back().end = static_cast<uint32_t>(i + 1);
+            }
+        }
+
+        mHash = computeHash();
+
+        // Fall back to one byte per color if there are too many runs
+        if(mRuns.size() * sizeof(Run) > mSize) {
+            mColors.reserve(mSize);
+            for(const Run& run : mRuns) {
+                mColors.insert(mColors.end(), run.end - mColors.size(), run.color);
+            }
+            mRuns.clear();
+            mRuns.shrink_to_fit();
+        }
+    }
+
+    size_t size() const {
+        return mSize;
+    }
+
+    /// Call func(index, color) for every color in the array, in order
+    template <typename Func>
+    void forEach(const Func& func) const {
+        if(mRuns.empty()) {
+            for(size_t i = 0; i < mColors.size(); ++i) {
+                func(i, static_cast<size_t>(mColors[i]));
+            }
+        } else {
+            size_t i = 0;
+            for(const Run& run : mRuns) {
+                for(; i < run.end; ++i) {
+                    func(i, static_cast<size_t>(run.color));
+                }
+            }
+        }
+    }
+
+    /// Get a single color. O(log n) for run-length encoded arrays, prefer forEach() to read all colors.
+    size_t operator[](size_t index) const {
+        P_ASSERT(index < mSize);
+        if(mRuns.empty()) {
+            return mColors[index];
+        }
+
+        auto runIt = std::upper_bound(mRuns.begin(), mRuns.end(), index,
+                                      [](size_t idx, const Run& run) { return idx < run.end; });
+        P_ASSERT(runIt != mRuns.end());
+        return runIt->color;
+    }
+
+    /// Hash of the content, same colors always give the same hash regardless of the storage
+    size_t getHash() const {
+        return mHash;
+    }
+
+    /// Number of bytes used by the array
+    size_t getMemoryUsage() const {
+        return sizeof(CompactColorArray) + mColors.capacity() * sizeof(uint8_t) + mRuns.capacity() * sizeof(Run);
+    }
+
+    bool isRunLengthEncoded() const {
+        return !mRuns.empty();
+    }
+
+    bool operator==(const CompactColorArray& other) const {
+        if(mSize != other.mSize || mHash != other.mHash) {
+            return false;
+        }
+
+        if(isRunLengthEncoded() && other.isRunLengthEncoded()) {
+            return mRuns == other.mRuns;
+        } else if(!isRunLengthEncoded() && !other.isRunLengthEncoded()) {
+            return mColors == other.mColors;
+        }
+
+        // Same content always picks the same storage
+        return false;
+    }
+
+    bool operator!=(const CompactColorArray& other) const {
+        return !(*this == other);
+    }
+
+   private:
+    /// Run of the same color, ending before the index end
+    struct Run {
+        uint32_t end;
+        uint8_t color;
+
+        bool operator==(const Run& other) const {
+            return end == other.end && color == other.color;
+        }
+    };
+
+    std::vector<uint8_t> mColors;
+    std::vector<Run> mRuns;
+    size_t mSize = 0;
+    size_t mHash = 0;
+
+    /// FNV-1a hash of the runs
+    size_t computeHash() const {
+        uint64_t hash = 14695981039346656037ull;
+        const auto addValue = [&hash](uint64_t value) {
+            for(int byte = 0; byte < 8; ++byte) {
+                hash ^= (value >> (8 * byte)) & 0xff;
+                hash *= 1099511628211ull;
+            }
+        };
+
+        for(const Run& run : mRuns) {
+            addValue(run.end);
+            addValue(run.color);
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,82 @@
+#include "geometry/CompactColorArray.h"
+#ifdef _TEST_
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace pepr3d {
+
+/// Check that the array holds exactly the colors, both via forEach() and operator[]
+void expectSameColors(const CompactColorArray& array, const std::vector<size_t>& colors) {
+    ASSERT_EQ(array.size(), colors.size());
+
+    size_t visited = 0;
+    array.forEach([&](size_t index, size_t color) {
+        EXPECT_EQ(index, visited);
+        EXPECT_EQ(color, colors[index]);
+        ++visited;
+    });
+    EXPECT_EQ(visited, colors.size());
+
+    for(size_t i = 0; i < colors.size(); ++i) {
+        EXPECT_EQ(array[i], colors[i]);
+    }
+}
+
+TEST(CompactColorArray, RunLengthEncoding) {
+    /**
+     * Test that large areas of the same color are run-length encoded and take less memory
+     */
+
+    std::vector<size_t> colors(10000, 0);
+    std::fill(colors.begin() + 2000, colors.begin() + 3000, 3);
+    std::fill(colors.begin() + 9999, colors.end(), 1);
+
+    const CompactColorArray array(colors.size(), [&colors](size_t i) { return colors[i]; });
+    EXPECT_TRUE(array.isRunLengthEncoded());
+    EXPECT_LT(array.getMemoryUsage(), colors.size());
+    expectSameColors(array, colors);
+}
+
+TEST(CompactColorArray, PlainStorage) {
+    /**
+     * Test that alternating colors fall back to one byte per color
+     */
+
+    std::vector<size_t> colors(1000);
+    for(size_t i = 0; i < colors.size(); ++i) {
+        colors[i] = i % 7;
+    }
+
+    const CompactColorArray array(colors.size(), [&colors](size_t i) { return colors[i]; });
+    EXPECT_FALSE(array.isRunLengthEncoded());
+    EXPECT_LE(array.getMemoryUsage(), sizeof(CompactColorArray) + colors.size());
+    expectSameColors(array, colors);
+}
+
+TEST(CompactColorArray, Equality) {
+    /**
+     * Test that the same colors give equal arrays and hashes and a single change is detected
+     */
+
+    std::vector<size_t> colors(500, 2);
+    const auto getColor = [&colors](size_t i) { return colors[i]; };
+
+    const CompactColorArray first(colors.size(), getColor);
+    const CompactColorArray second(colors.size(), getColor);
+    EXPECT_EQ(first.getHash(), second.getHash());
+    EXPECT_EQ(first, second);
+
+    colors[250] = 4;
+    const CompactColorArray changed(colors.size(), getColor);
+    EXPECT_NE(first, changed);
+
+    const CompactColorArray shorter(colors.size() - 1, getColor);
+    EXPECT_NE(changed, shorter);
+
+    const CompactColorArray empty;
+    EXPECT_EQ(empty.size(), 0);
+    expectSameColors(empty, {});
+}
+
+}  // namespace pepr3d
+#endif
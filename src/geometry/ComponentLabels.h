@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Connected components of a graph, found by a union-find that can be filled from multiple threads at once.
+/// Every node is labelled by the smallest node of its component, so the labels do not depend on the order in which
+/// the nodes were united. Used to cache the regions of the paint bucket.
+class ComponentLabels {
+   public:
+    ComponentLabels() = default;
+
+    /// Every node starts in its own component
+    explicit ComponentLabels(size_t nodeCount) : mParents(nodeCount), mLabels(nodeCount) {
+        for(size_t node = 0; node < nodeCount; ++node) {
+            mParents[node].store(node, std::memory_order_relaxed);
+            mLabels[node] = node;
+        }
+        updateComponents();
+    }
+
+    size_t size() const {
+        return mLabels.size();
+    }
+
+    /// Join the components of the two nodes. Safe to call from multiple threads at once, the labels are updated by
+    /// updateLabels().
+    void unite(size_t first, size_t second) {
+        while(true) {
+            first = find(first);
+            second = find(second);
+            if(first == second) {
+                return;
+            }
+
+            // The larger root is linked under the smaller one, a root is only ever linked once
+            if(first < second) {
+                std::swap(first, second);
+            }
+            size_t expected = first;
+            if(mParents[first].compare_exchange_strong(expected, second)) {
+                return;
+            }
+        }
+    }
+
+    /// Smallest node of the component of the node, as united so far. Safe to call together with unite().
+    size_t find(size_t node) {
+        P_ASSERT(node < mParents.size());
+        while(true) {
+            size_t parent = mParents[node].load();
+            if(parent == node) {
+                return node;
+            }
+
+            // Path halving, losing the race only means a longer path next time
+            const size_t grandparent = mParents[parent].load();
+            if(parent != grandparent) {
+                mParents[node].compare_exchange_weak(parent, grandparent);
+            }
+            node = grandparent;
+        }
+    }
+
+    /// Split the component back into single nodes, they need to be united again before updateLabels()
+    void resetComponent(size_t label) {
+        for(const size_t node : getComponent(label)) {
+            mParents[node].store(node, std::memory_order_relaxed);
+        }
+    }
+
+    /// Label the nodes by the components united so far. Must not be called together with unite().
+    void updateLabels() {
+        for(size_t node = 0; node < mLabels.size(); ++node) {
+            mLabels[node] = find(node);
+            mParents[node].store(mLabels[node], std::memory_order_relaxed);
+        }
+        updateComponents();
+    }
+
+    size_t getLabel(size_t node) const {
+        P_ASSERT(node < mLabels.size());
+        return mLabels[node];
+    }
+
+    /// Nodes of the component with the label, sorted
+    struct Component {
+        const size_t* first;
+        const size_t* last;
+
+        const size_t* begin() const {
+            return first;
+        }
+
+        const size_t* end() const {
+            return last;
+        }
+
+        size_t size() const {
+            return last - first;
+        }
+    };
+
+    Component getComponent(size_t label) const {
+        P_ASSERT(label < mLabels.size());
+        P_ASSERT(mLabels[label] == label);
+        return {mNodesByLabel.data() + mComponentStarts[label], mNodesByLabel.data() + mComponentStarts[label + 1]};
+    }
+
+   private:
+    /// Union-find forest, parent of a root is the root itself
+    std::vector<std::atomic<size_t>> mParents;
+
+    std::vector<size_t> mLabels;
+
+    /// Nodes grouped by their labels, the group of a label starts at mComponentStarts[label]
+    std::vector<size_t> mNodesByLabel;
+    std::vector<size_t> mComponentStarts;
+
+    /// Group the nodes by their labels with a counting sort
+    void updateComponents() {
+        mComponentStarts.assign(mLabels.size() + 1, 0);
+        for(const size_t label : mLabels) {
+            ++mComponentStarts[label + 1];
+        }
+        for(size_t label = 0; label < mLabels.size(); ++label) {
+            mComponentStarts[label + 1] += mComponentStarts[label];
+        }
+
+        mNodesByLabel.resize(mLabels.size());
+        std::vector<size_t> nextPosition(mComponentStarts.begin(), mComponentStarts.end() - 1);
+        for(size_t node = 0; node < mLabels.size(); ++node) {
+            mNodesByLabel[nextPosition[mLabels[node]]++] = node;
+        }
+    }
+};
+
+}  // namespace pepr3d
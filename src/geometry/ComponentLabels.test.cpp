@@ -0,0 +1,91 @@
+#include "geometry/ComponentLabels.h"
+#ifdef _TEST_
+#include <gtest/gtest.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace pepr3d {
+
+/// Labels of all nodes
+std::vector<size_t> getLabels(const ComponentLabels& labels) {
+    std::vector<size_t> result;
+    for(size_t node = 0; node < labels.size(); ++node) {
+        result.push_back(labels.getLabel(node));
+    }
+    return result;
+}
+
+TEST(ComponentLabels, SmallestNodeLabels) {
+    /**
+     * Test that the components are labelled by their smallest nodes and grouped by the labels
+     */
+
+    ComponentLabels labels(8);
+    EXPECT_EQ(getLabels(labels), std::vector<size_t>({0, 1, 2, 3, 4, 5, 6, 7}));
+
+    labels.unite(6, 3);
+    labels.unite(3, 7);
+    labels.unite(5, 1);
+    labels.unite(7, 6);
+    labels.updateLabels();
+    EXPECT_EQ(getLabels(labels), std::vector<size_t>({0, 1, 2, 3, 4, 1, 3, 3}));
+
+    const ComponentLabels::Component component = labels.getComponent(3);
+    EXPECT_EQ(std::vector<size_t>(component.begin(), component.end()), std::vector<size_t>({3, 6, 7}));
+    EXPECT_EQ(labels.getComponent(4).size(), 1u);
+
+    // A reset component gets split unless its nodes are united again
+    labels.resetComponent(3);
+    labels.unite(7, 6);
+    labels.unite(6, 1);
+    labels.updateLabels();
+    EXPECT_EQ(getLabels(labels), std::vector<size_t>({0, 1, 2, 3, 4, 1, 1, 1}));
+    EXPECT_EQ(labels.getComponent(1).size(), 4u);
+}
+
+TEST(ComponentLabels, ConcurrentUnite) {
+    /**
+     * Test that uniting from multiple threads gives the same labels as uniting from a single thread
+     */
+
+    const size_t nodeCount = 100000;
+    std::vector<std::pair<size_t, size_t>> edges;
+    for(size_t node = 0; node < nodeCount; ++node) {
+        // Chains of nodes with the same remainder, some of them joined together
+        if(node + 7 < nodeCount) {
+            edges.emplace_back(node + 7, node);
+        }
+        if(node % 7 == 2 && node % 1000 == 2) {
+            edges.emplace_back(node, node + 1);
+        }
+    }
+
+    ComponentLabels singleLabels(nodeCount);
+    for(const auto& edge : edges) {
+        singleLabels.unite(edge.first, edge.second);
+    }
+    singleLabels.updateLabels();
+
+    ComponentLabels concurrentLabels(nodeCount);
+    const size_t threadCount = 4;
+    std::vector<std::thread> threads;
+    for(size_t threadIdx = 0; threadIdx < threadCount; ++threadIdx) {
+        threads.emplace_back([&edges, &concurrentLabels, threadIdx, threadCount]() {
+            for(size_t edgeIdx = threadIdx; edgeIdx < edges.size(); edgeIdx += threadCount) {
+                concurrentLabels.unite(edges[edgeIdx].first, edges[edgeIdx].second);
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+    concurrentLabels.updateLabels();
+
+    EXPECT_EQ(getLabels(concurrentLabels), getLabels(singleLabels));
+    EXPECT_EQ(concurrentLabels.getLabel(nodeCount - 1), (nodeCount - 1) % 7);
+    EXPECT_EQ(concurrentLabels.getLabel(3), 2u);
+}
+
+}  // namespace pepr3d
+#endif
@@ -5,6 +5,13 @@ namespace pepr3d {
 std::vector<std::vector<FontRasterizer::Tri>> FontRasterizer::rasterizeText(const std::string textString,
                                                                             const size_t fontHeight,
                                                                             const size_t bezierSteps) {
+    std::vector<std::vector<Outline>> outlinesPerLetter;
+    return rasterizeText(textString, fontHeight, bezierSteps, outlinesPerLetter);
+}
+
+std::vector<std::vector<FontRasterizer::Tri>> FontRasterizer::rasterizeText(
+    const std::string textString, const size_t fontHeight, const size_t bezierSteps,
+    std::vector<std::vector<Outline>>& outOutlines) {
     mPrevCharIndex = 0;
     mCurCharIndex = 0;
     mPrev_rsb_delta = 0;
@@ -13,20 +20,23 @@ std::vector<std::vector<FontRasterizer::Tri>> FontRasterizer::rasterizeText(cons
     FT_Set_Char_Size(mFace, converted, converted, 96, 96);
 
     std::vector<std::vector<Tri>> trianglesPerLetter;
+    outOutlines.clear();
 
     double offset = 0;
     for(size_t i = 0; i < textString.size(); i++) {
         trianglesPerLetter.push_back({});
-        offset = addOneCharacter(textString[i], bezierSteps, offset, trianglesPerLetter.back());
+        outOutlines.push_back({});
+        offset = addOneCharacter(textString[i], bezierSteps, offset, trianglesPerLetter.back(), outOutlines.back());
     }
 
     // postprocess by offsetting y-axis to positive numbers
-    outlinePostprocess(trianglesPerLetter);
+    outlinePostprocess(trianglesPerLetter, outOutlines);
 
     return trianglesPerLetter;
 }
 
-void FontRasterizer::outlinePostprocess(std::vector<std::vector<Tri>>& trianglesPerLetter) const {
+void FontRasterizer::outlinePostprocess(std::vector<std::vector<Tri>>& trianglesPerLetter,
+                                        std::vector<std::vector<Outline>>& outlinesPerLetter) const {
     float min = std::numeric_limits<float>::max();
 
     // Find the minimum of all y-axis of all triangles of all letters
@@ -54,25 +64,19 @@ void FontRasterizer::outlinePostprocess(std::vector<std::vector<Tri>>& triangles
         }
     }
 
-    /// Uncomment the following part if you need the outline, not a triangulation
-
-    // double min = std::numeric_limits<double>::max();
-    //// Find the minimum of all y-axis of all holes and outlines
-    // for(auto& cs : outCircumference) {
-    //    for(auto& p : cs) {
-    //        if(min > p.y) {
-    //            min = p.y;
-    //        }
-    //    }
-    //}
-
-    //// Add its abs to push all values into non-negative
-    // const double addToZero = abs(min);
-    // for(auto& cs : outCircumference) {
-    //    for(auto& p : cs) {
-    //        p.y += static_cast<float>(addToZero);
-    //    }
-    //}
+    // Outlines have the same points as the triangles, shift them the same way
+    for(auto& letterOutlines : outlinesPerLetter) {
+        for(auto& outline : letterOutlines) {
+            for(auto& p : outline.boundary) {
+                p.y += addToZero;
+            }
+            for(auto& hole : outline.holes) {
+                for(auto& p : hole) {
+                    p.y += addToZero;
+                }
+            }
+        }
+    }
 }
 
 /// The following code originated from https://github.com/codetiger/Font23D and was modified by the Pepr team
@@ -86,10 +90,22 @@ std::vector<p2t::Point*> FontRasterizer::triangulateContour(Vectoriser* vectoris
     return polyline;
 }
 
+std::vector<glm::vec3> FontRasterizer::getContourPoints(Vectoriser* vectoriser, const int c, const float offset) {
+    std::vector<glm::vec3> points;
+    const Contour* contour = vectoriser->GetContour(c);
+    for(size_t p = 0; p < contour->PointCount(); ++p) {
+        const double* d = contour->GetPoint(p);
+        // Same conversion as the triangles, y-axis is flipped
+        points.emplace_back(static_cast<float>((d[0] / 64.0f) + offset), static_cast<float>(-d[1] / 64.0f), 0.0f);
+    }
+    return points;
+}
+
 /// The following code originated from https://github.com/codetiger/Font23D and was modified by the Pepr team
 double FontRasterizer::addOneCharacter(const char ch, const size_t bezierSteps, const double offset,
-                                       std::vector<Tri>& outTriangles) {
+                                       std::vector<Tri>& outTriangles, std::vector<Outline>& outOutlines) {
     std::vector<Tri> trianglesLetter;
+    std::vector<Outline> outlinesLetter;
 
     mCurCharIndex = FT_Get_Char_Index(mFace, ch);
     if(FT_Load_Glyph(mFace, mCurCharIndex, FT_LOAD_DEFAULT)) {
@@ -128,21 +144,12 @@ double FontRasterizer::addOneCharacter(const char ch, const size_t bezierSteps,
     for(size_t c = 0; c < vectoriser->ContourCount(); ++c) {
         const Contour* contour = vectoriser->GetContour(c);
 
-        /// Uncomment the following part if you need the outline, not a triangulation
-        /// Beware, the order of the outlines seems to be random - the first (0) is NOT always the outermost
-        /// Depends on the font.
-
-        // outCircumference.push_back({});
-        // std::vector<glm::vec2>& circumPart = outCircumference.back();
-        //// Add the circumference
-        // for(size_t p = 0; p < contour->PointCount(); ++p) {
-        //    const double* d1 = contour->GetPoint(p);
-        //    circumPart.push_back(glm::vec2((static_cast<float>(d1[0]) / 64.0f) + static_cast<float>(modifiedOffset),
-        //                                    -1 * static_cast<float>(d1[1]) / 64.0f));
-        //}
-
         // Calc the triangulation
+        // Beware, the order of the contours seems to be random - the first (0) is NOT always the outermost
         if(contour->GetDirection()) {
+            outlinesLetter.push_back(
+                {getContourPoints(vectoriser.get(), static_cast<int>(c), static_cast<float>(modifiedOffset)), {}});
+
             // CAREFUL, this vector is filled with pointers INTO the CDT structure, do NOT delete this as the CDT will
             // crash.
             std::vector<p2t::Point*> polyline =
@@ -157,6 +164,8 @@ double FontRasterizer::addOneCharacter(const char ch, const size_t bezierSteps,
                     std::vector<p2t::Point*> pl =
                         triangulateContour(vectoriser.get(), static_cast<int>(cm), static_cast<float>(modifiedOffset));
                     cdt->AddHole(pl);
+                    outlinesLetter.back().holes.push_back(
+                        getContourPoints(vectoriser.get(), static_cast<int>(cm), static_cast<float>(modifiedOffset)));
                 }
             }
 
@@ -182,6 +191,7 @@ double FontRasterizer::addOneCharacter(const char ch, const size_t bezierSteps,
     mPrevCharIndex = mCurCharIndex;
     const double chSize = static_cast<double>(mFace->glyph->advance.x >> 6);
     outTriangles = std::move(trianglesLetter);
+    outOutlines = std::move(outlinesLetter);
     return modifiedOffset + chSize;
 }
 
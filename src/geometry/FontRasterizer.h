@@ -28,6 +28,12 @@ class FontRasterizer {
         glm::vec3 a, b, c;
     };
 
+    /// Outer contour of a glyph with the contours of its holes
+    struct Outline {
+        std::vector<glm::vec3> boundary;
+        std::vector<std::vector<glm::vec3>> holes;
+    };
+
    private:
     std::string mFontFile;
     bool mFontLoaded = false;
@@ -64,10 +70,20 @@ class FontRasterizer {
     std::vector<std::vector<FontRasterizer::Tri>> rasterizeText(const std::string textString, const size_t fontHeight,
                                                                 const size_t bezierSteps);
 
+    /// Triangulate the text and keep the outlines of its letters too, in the same coordinates as the triangles
+    /// @param outOutlines Outlines of each letter, painting them avoids joining the triangles back together
+    std::vector<std::vector<FontRasterizer::Tri>> rasterizeText(const std::string textString, const size_t fontHeight,
+                                                                const size_t bezierSteps,
+                                                                std::vector<std::vector<Outline>>& outOutlines);
+
    private:
-    double addOneCharacter(const char ch, const size_t bezierSteps, double offset, std::vector<Tri>& outTriangles);
+    double addOneCharacter(const char ch, const size_t bezierSteps, double offset, std::vector<Tri>& outTriangles,
+                           std::vector<Outline>& outOutlines);
+
+    void outlinePostprocess(std::vector<std::vector<Tri>>& trianglesPerLetter,
+                            std::vector<std::vector<Outline>>& outlinesPerLetter) const;
 
-    void outlinePostprocess(std::vector<std::vector<Tri>>& trianglesPerLetter) const;
+    static std::vector<glm::vec3> getContourPoints(Vectoriser* vectoriser, int c, float offset);
 
     static std::vector<p2t::Point*> triangulateContour(Vectoriser* vectoriser, int c, float offset);
 };
@@ -6,6 +6,7 @@
 
 #ifdef _TEST_
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <vector>
 
 namespace pepr3d {
@@ -136,6 +137,40 @@ TEST(FontRasterizer, rasterizeText_postprocessShift) {
     }
 }
 
+TEST(FontRasterizer, rasterizeText_outlines) {
+    /**
+     * Test that the outlines of the word "TO" have the letter "O" with a hole and use the points of the triangles
+     */
+
+    FontRasterizer fr(getAssetPath("fonts/SourceSansPro-SemiBold.ttf"));
+    EXPECT_TRUE(fr.isValid());
+
+    std::vector<std::vector<FontRasterizer::Outline>> outlinesByLetters;
+    auto trisByLetters = fr.rasterizeText("TO", 90, 3, outlinesByLetters);
+
+    ASSERT_EQ(outlinesByLetters.size(), 2);  // two letters
+    ASSERT_EQ(outlinesByLetters.front().size(), 1);
+    EXPECT_TRUE(outlinesByLetters.front().front().holes.empty());
+    ASSERT_EQ(outlinesByLetters.back().size(), 1);
+    EXPECT_EQ(outlinesByLetters.back().front().holes.size(), 1);
+
+    // Triangles of the letter "T" are made of its outline points, shifted the same way
+    const std::vector<glm::vec3>& boundary = outlinesByLetters.front().front().boundary;
+    const auto isOutlinePoint = [&boundary](const glm::vec3& pt) {
+        return std::any_of(boundary.begin(), boundary.end(), [&pt](const glm::vec3& outlinePt) {
+            return glm::all(glm::epsilonEqual(pt, outlinePt, 0.0001f));
+        });
+    };
+    for(auto& t : trisByLetters.front()) {
+        EXPECT_TRUE(isOutlinePoint(t.a));
+        EXPECT_TRUE(isOutlinePoint(t.b));
+        EXPECT_TRUE(isOutlinePoint(t.c));
+    }
+    for(const glm::vec3& pt : boundary) {
+        EXPECT_GE(pt.y, 0);
+    }
+}
+
 TEST(FontRasterizer, rasterizeText_hardcodeCheck) {
     /**
      * Test a simple rasterization of the word "T", checking every vertex for the correct position
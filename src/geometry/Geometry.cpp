@@ -5,7 +5,13 @@
 
 #include <CGAL/Sphere_3.h>
 #include <CGAL/Spherical_kernel_3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <functional>
+#include <iterator>
+#include <numeric>
 #include <set>
 #include <unordered_map>
 #include "geometry/SdfValuesException.h"
@@ -15,25 +21,96 @@ namespace pepr3d {
 /* -------------------- Commands -------------------- */
 
 Geometry::GeometryState Geometry::saveState() const {
+    // The colors of a capture in progress are shared with this state if they did not change
+    waitForStateCapture();
+
     // Save only necessary data to keep snapshot size low
-    std::vector<size_t> triangleColors;
-    triangleColors.reserve(mTriangles.size());
-    for(const DataTriangle& tri : mTriangles) {
-        triangleColors.push_back(tri.getColor());
+    auto triangleColors = std::make_shared<const CompactColorArray>(
+        mTriangles.size(), [this](size_t triIdx) { return mTriangles[triIdx].getColor(); });
+
+    // Share the colors with the previous state if they did not change
+    if(mLastSavedColors && *mLastSavedColors == *triangleColors) {
+        triangleColors = mLastSavedColors;
+    } else {
+        mLastSavedColors = triangleColors;
     }
 
-    return GeometryState{triangleColors, mTriangleDetails, ColorManager::ColorMap(mColorManager.getColorMap())};
+    // Details are not copied, only shared. Any later change to them makes a copy first.
+    if(!mLastSavedDetails || *mLastSavedDetails != mTriangleDetails) {
+        mLastSavedDetails = std::make_shared<const TriangleDetailMap>(mTriangleDetails);
+    }
+
+    return GeometryState{std::move(triangleColors), mLastSavedDetails, mColorManager.getPalette()};
+}
+
+std::shared_future<Geometry::GeometryState> Geometry::saveStateAsync() const {
+    const auto start = std::chrono::high_resolution_clock::now();
+    waitForStateCapture();
+
+    // Details and palette are frozen right away, shared details get copied on write
+    if(!mLastSavedDetails || *mLastSavedDetails != mTriangleDetails) {
+        mLastSavedDetails = std::make_shared<const TriangleDetailMap>(mTriangleDetails);
+    }
+    GeometryState frozenState{nullptr, mLastSavedDetails, mColorManager.getPalette()};
+
+    // The capture owns everything it reads, the colors are copied here and compressed on a worker
+    std::vector<uint8_t> colors(mTriangles.size());
+    for(size_t triIdx = 0; triIdx < mTriangles.size(); ++triIdx) {
+        P_ASSERT(mTriangles[triIdx].getColor() <= UINT8_MAX);
+        colors[triIdx] = static_cast<uint8_t>(mTriangles[triIdx].getColor());
+    }
+
+    mStateCapture = MainApplication::getThreadPool()
+                        .enqueue([start, colors = std::move(colors), previousColors = mLastSavedColors,
+                                  state = std::move(frozenState)]() mutable {
+                            auto triangleColors = std::make_shared<const CompactColorArray>(
+                                colors.size(), [&colors](size_t triIdx) { return colors[triIdx]; });
+
+                            if(previousColors && *previousColors == *triangleColors) {
+                                triangleColors = std::move(previousColors);
+                            }
+                            state.triangleColors = std::move(triangleColors);
+
+                            const auto end = std::chrono::high_resolution_clock::now();
+                            const std::chrono::duration<double, std::milli> timeMs = end - start;
+                            CI_LOG_I("State captured in " + std::to_string(timeMs.count()) + " ms");
+                            return std::move(state);
+                        })
+                        .share();
+
+    const auto end = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double, std::milli> timeMs = end - start;
+    CI_LOG_I("State capture started, main thread stalled for " + std::to_string(timeMs.count()) + " ms");
+
+    return mStateCapture;
+}
+
+void Geometry::waitForStateCapture() const {
+    if(!mStateCapture.valid()) {
+        return;
+    }
+
+    if(mStateCapture.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        mStateCapture.wait();
+        const auto end = std::chrono::high_resolution_clock::now();
+        const std::chrono::duration<double, std::milli> timeMs = end - start;
+        CI_LOG_I("Waited " + std::to_string(timeMs.count()) + " ms for the state capture to finish");
+    }
+
+    // Published on the main thread, the next saved state shares the colors if they do not change
+    mLastSavedColors = mStateCapture.get().triangleColors;
+    mStateCapture = {};
 }
 
 void Geometry::loadState(const GeometryState& state) {
     // mTriangles only possibly changes color
-    P_ASSERT(mTriangles.size() == state.triangleColors.size());
-    for(size_t triIdx = 0; triIdx < mTriangles.size(); triIdx++) {
-        mTriangles[triIdx].setColor(state.triangleColors[triIdx]);
-    }
-    mTriangleDetails = state.triangleDetails;
+    P_ASSERT(state.triangleColors && state.triangleDetails);
+    P_ASSERT(mTriangles.size() == state.triangleColors->size());
+    state.triangleColors->forEach([this](size_t triIdx, size_t color) { mTriangles[triIdx].setColor(color); });
+    mTriangleDetails = *state.triangleDetails;
 
-    mColorManager.replaceColors(state.colorMap.begin(), state.colorMap.end());
+    mColorManager.setPalette(state.palette);
     P_ASSERT(!mColorManager.empty());
 
     // Set opengl state to dirty so it gets updated eventually
@@ -45,6 +122,167 @@ void Geometry::loadState(const GeometryState& state) {
     invalidateTemporaryDetailedData();
 }
 
+void Geometry::GeometryDiff::join(GeometryDiff&& later) {
+    for(auto& colorIt : later.triangleColors) {
+        auto inserted = triangleColors.emplace(colorIt.first, colorIt.second);
+        if(!inserted.second) {
+            inserted.first->second.second = colorIt.second.second;
+        }
+    }
+
+    for(auto& detailIt : later.triangleDetails) {
+        auto inserted = triangleDetails.emplace(detailIt.first, detailIt.second);
+        if(!inserted.second) {
+            inserted.first->second.second = std::move(detailIt.second.second);
+        }
+    }
+
+    if(later.palette) {
+        if(palette) {
+            palette->second = std::move(later.palette->second);
+        } else {
+            palette = std::move(later.palette);
+        }
+    }
+}
+
+/// Approximate size of a node of std::map or std::unordered_map holding the value
+template <typename Value>
+static constexpr size_t mapNodeSize() {
+    return sizeof(Value) + 4 * sizeof(void*);
+}
+
+static size_t paletteMemoryUsage(const ColorManager::Palette& palette) {
+    return palette.colors.capacity() * sizeof(glm::vec4) + palette.order.capacity() * sizeof(size_t);
+}
+
+static void countDetailMemoryUsage(const std::shared_ptr<TriangleDetail>& detail, MemoryUsageCounter& counter) {
+    counter.addShared(detail.get(), [](const TriangleDetail& d) { return d.getMemoryUsage(); });
+}
+
+void Geometry::GeometryState::countMemoryUsage(MemoryUsageCounter& counter) const {
+    counter.add(sizeof(GeometryState) + paletteMemoryUsage(palette));
+    counter.addShared(triangleColors.get(), [](const CompactColorArray& colors) { return colors.getMemoryUsage(); });
+
+    // Details of a shared map are counted once along with the map
+    const bool mapCounted = counter.addShared(triangleDetails.get(), [](const TriangleDetailMap& details) {
+        return details.size() * mapNodeSize<TriangleDetailMap::value_type>();
+    });
+    if(mapCounted) {
+        for(const auto& detailIt : *triangleDetails) {
+            countDetailMemoryUsage(detailIt.second, counter);
+        }
+    }
+}
+
+void Geometry::GeometryDiff::countMemoryUsage(MemoryUsageCounter& counter) const {
+    counter.add(sizeof(GeometryDiff) +
+                triangleColors.size() * mapNodeSize<decltype(triangleColors)::value_type>() +
+                triangleDetails.size() * mapNodeSize<decltype(triangleDetails)::value_type>());
+    if(palette) {
+        counter.add(paletteMemoryUsage(palette->first) + paletteMemoryUsage(palette->second));
+    }
+    for(const auto& detailIt : triangleDetails) {
+        countDetailMemoryUsage(detailIt.second.first, counter);
+        countDetailMemoryUsage(detailIt.second.second, counter);
+    }
+}
+
+void Geometry::beginDiff() {
+    P_ASSERT(!mRecordedDiff);
+    mRecordedDiff = std::make_unique<GeometryDiff>();
+}
+
+Geometry::GeometryDiff Geometry::endDiff() {
+    P_ASSERT(mRecordedDiff);
+    GeometryDiff diff = std::move(*mRecordedDiff);
+    mRecordedDiff.reset();
+
+    // Fill in the current state and drop everything that did not change
+    for(auto it = diff.triangleColors.begin(); it != diff.triangleColors.end();) {
+        it->second.second = mTriangles[it->first].getColor();
+        if(it->second.first == it->second.second) {
+            it = diff.triangleColors.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for(auto it = diff.triangleDetails.begin(); it != diff.triangleDetails.end();) {
+        auto detailIt = mTriangleDetails.find(it->first);
+        it->second.second = detailIt == mTriangleDetails.end() ? nullptr : detailIt->second;
+
+        // Recorded details are shared, so any modification made a new copy
+        if(it->second.first == it->second.second) {
+            it = diff.triangleDetails.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // The palette is recorded only when a command was about to change it, see recordPalette()
+    if(diff.palette) {
+        if(diff.palette->first == mColorManager.getPalette()) {
+            diff.palette.reset();
+        } else {
+            diff.palette->second = mColorManager.getPalette();
+        }
+    }
+
+    return diff;
+}
+
+void Geometry::revertDiff(const GeometryDiff& diff) {
+    loadDiff(diff, false);
+}
+
+void Geometry::applyDiff(const GeometryDiff& diff) {
+    loadDiff(diff, true);
+}
+
+void Geometry::loadDiff(const GeometryDiff& diff, bool after) {
+    P_ASSERT(!mRecordedDiff);
+
+    if(!diff.triangleDetails.empty()) {
+        for(const auto& detailIt : diff.triangleDetails) {
+            const std::shared_ptr<TriangleDetail>& detail = after ? detailIt.second.second : detailIt.second.first;
+            if(detail) {
+                mTriangleDetails[detailIt.first] = detail;
+            } else {
+                mTriangleDetails.erase(detailIt.first);
+            }
+        }
+
+        mOgl.isDirty = true;
+        invalidateTemporaryDetailedData();
+    }
+
+    for(const auto& colorIt : diff.triangleColors) {
+        const size_t triangleIndex = colorIt.first;
+        const size_t color = after ? colorIt.second.second : colorIt.second.first;
+        P_ASSERT(triangleIndex < mTriangles.size());
+        mTriangles[triangleIndex].setColor(color);
+        markBucketRegionRecolored(DetailedTriangleId(triangleIndex));
+
+        // Without detail changes the buffers stay valid, update only the changed colors
+        if(!mOgl.isDirty && isSimpleTriangle(triangleIndex)) {
+            const size_t vertexPosition = triangleIndex * 3;
+            P_ASSERT(vertexPosition + 2 < mOgl.colorBuffer.size());
+
+            const ColorIndex newColorIndex = static_cast<ColorIndex>(color);
+            mOgl.colorBuffer[vertexPosition] = newColorIndex;
+            mOgl.colorBuffer[vertexPosition + 1] = newColorIndex;
+            mOgl.colorBuffer[vertexPosition + 2] = newColorIndex;
+            mOgl.info.didColorUpdate = true;
+        }
+    }
+
+    if(diff.palette) {
+        mColorManager.setPalette(after ? diff.palette->second : diff.palette->first);
+        P_ASSERT(!mColorManager.empty());
+    }
+}
+
 /* -------------------- Mesh loading -------------------- */
 
 void Geometry::recomputeFromData() {
@@ -98,6 +336,8 @@ void Geometry::recomputeFromData() {
     /// Wait for building the polyhedron and tree
     buildTreeFuture.get();
     buildPolyhedronFuture.get();
+
+    computeNeighbourCosines();
 }
 
 void Geometry::buildTree() {
@@ -159,7 +399,7 @@ void Geometry::generateVertexBuffer() {
     }
 
     for(auto& it : mTriangleDetails) {
-        const auto& detailTriangles = it.second.getTriangles();
+        const auto& detailTriangles = it.second->getTriangles();
 
         for(const auto& triangle : detailTriangles) {
             mOgl.vertexBuffer.push_back(triangle.getVertex(0));
@@ -192,7 +432,7 @@ void Geometry::generateColorBuffer() {
     }
 
     for(auto& it : mTriangleDetails) {
-        const auto& detailTriangles = it.second.getTriangles();
+        const auto& detailTriangles = it.second->getTriangles();
 
         mTriangleDetailColorBufferStart[it.first] = mOgl.colorBuffer.size();
         for(const auto& triangle : detailTriangles) {
@@ -217,8 +457,8 @@ void Geometry::generateNormalBuffer() {
     }
 
     for(auto& it : mTriangleDetails) {
-        const auto& detailTriangles = it.second.getTriangles();
-        glm::vec3 normal = it.second.getOriginal().getNormal();
+        const auto& detailTriangles = it.second->getTriangles();
+        glm::vec3 normal = it.second->getOriginal().getNormal();
 
         for(const auto& triangle : detailTriangles) {
             mOgl.normalBuffer.push_back(normal);
@@ -230,49 +470,48 @@ void Geometry::generateNormalBuffer() {
 }
 
 void Geometry::generateHighlightBuffer() {
-    std::set<size_t>& paintSet = mAreaHighlight.triangles;
-    const BrushSettings& settings = mAreaHighlight.settings;
+    const std::vector<bool>& highlightMask = mAreaHighlight.triangleMask;
+    const bool continuous = mAreaHighlight.settings.continuous;
+    const auto isHighlighted = [&highlightMask, continuous](size_t triangleIdx) -> GLint {
+        return !continuous || (triangleIdx < highlightMask.size() && highlightMask[triangleIdx]);
+    };
 
     mOgl.highlightMask.clear();
     // Mark all triangles with attribute assigned to vertex
-    mOgl.highlightMask.reserve(mTriangles.size() * 3);
+    mOgl.highlightMask.reserve(mOgl.vertexBuffer.size());
     for(size_t triangleIdx = 0; triangleIdx < mTriangles.size(); triangleIdx++) {
         // Fill 3 vertices of a triangle
-        if(settings.continuous && paintSet.find(triangleIdx) == paintSet.end()) {
-            mOgl.highlightMask.emplace_back(0);
-            mOgl.highlightMask.emplace_back(0);
-            mOgl.highlightMask.emplace_back(0);
-
-        } else {
-            mOgl.highlightMask.emplace_back(1);
-            mOgl.highlightMask.emplace_back(1);
-            mOgl.highlightMask.emplace_back(1);
-        }
+        mOgl.highlightMask.insert(mOgl.highlightMask.end(), 3, isHighlighted(triangleIdx));
     }
 
     // If the original triangle has highlight enabled also enable for detail
     for(auto& it : mTriangleDetails) {
-        const size_t triangleIdx = it.first;
-        const auto& detailTriangles = it.second.getTriangles();
+        const size_t detailVertexCount = 3 * it.second->getTriangles().size();
+        mOgl.highlightMask.insert(mOgl.highlightMask.end(), detailVertexCount, isHighlighted(it.first));
+    }
 
-        const bool enableHighlight = !settings.continuous || paintSet.find(triangleIdx) != paintSet.end();
+    P_ASSERT(mOgl.highlightMask.size() == mOgl.vertexBuffer.size());
 
-        for(const auto& triangle : detailTriangles) {
-            if(enableHighlight) {
-                mOgl.highlightMask.emplace_back(1);
-                mOgl.highlightMask.emplace_back(1);
-                mOgl.highlightMask.emplace_back(1);
-            } else {
-                mOgl.highlightMask.emplace_back(0);
-                mOgl.highlightMask.emplace_back(0);
-                mOgl.highlightMask.emplace_back(0);
-            }
-        }
-    }
+    mOgl.info.markHighlightUpdate(0, mOgl.highlightMask.size());
+}
 
+void Geometry::updateHighlightBuffer(size_t triangleIdx) {
+    P_ASSERT(!mOgl.isDirty);
     P_ASSERT(mOgl.highlightMask.size() == mOgl.vertexBuffer.size());
 
-    mOgl.info.didHighlightUpdate = true;
+    const GLint value = !mAreaHighlight.settings.continuous || mAreaHighlight.triangleMask[triangleIdx];
+    const auto updateVertices = [this, value](size_t begin, size_t end) {
+        std::fill(mOgl.highlightMask.begin() + begin, mOgl.highlightMask.begin() + end, value);
+        mOgl.info.markHighlightUpdate(begin, end);
+    };
+
+    updateVertices(3 * triangleIdx, 3 * triangleIdx + 3);
+
+    auto detailIt = mTriangleDetails.find(triangleIdx);
+    if(detailIt != mTriangleDetails.end()) {
+        const size_t detailStart = mTriangleDetailColorBufferStart.at(triangleIdx);
+        updateVertices(detailStart, detailStart + 3 * detailIt->second->getTriangles().size());
+    }
 }
 
 void Geometry::generateTriangleBounds() {
@@ -419,53 +658,88 @@ std::vector<size_t> Geometry::getTrianglesUnderBrush(const glm::vec3& originPoin
 }
 
 void Geometry::highlightArea(const ci::Ray& ray, const BrushSettings& settings) {
-    const glm::vec3 source = ray.getOrigin();
     const glm::vec3 rayDirection = ray.getDirection();
 
     glm::vec3 intersectionPoint{};
     auto intersectedTri = intersectMesh(ray, intersectionPoint);
-    if(intersectedTri) {
-        std::vector<size_t> trianglesToPaint;
+    if(!intersectedTri) {
+        mAreaHighlight.enabled = false;
+        return;
+    }
 
-        if(settings.continuous) {
-            trianglesToPaint = getTrianglesUnderBrush(intersectionPoint, rayDirection, *intersectedTri, settings);
-        }
+    // Nothing changes when the same point is hovered with the same brush
+    if(mAreaHighlight.enabled && mAreaHighlight.hitTriangle == *intersectedTri &&
+       mAreaHighlight.origin == intersectionPoint && mAreaHighlight.direction == rayDirection &&
+       mAreaHighlight.settings == settings) {
+        return;
+    }
 
-        mAreaHighlight.triangles = std::set<size_t>(trianglesToPaint.begin(), trianglesToPaint.end());
-        trianglesToPaint.clear();
-        mAreaHighlight.settings = settings;
-        mAreaHighlight.size = settings.size;
-        mAreaHighlight.origin = intersectionPoint;
-        mAreaHighlight.direction = ray.getDirection();
-        mAreaHighlight.enabled = true;
-        mAreaHighlight.dirty = true;
+    std::vector<size_t> triangles;
+    if(settings.continuous) {
+        triangles = getTrianglesUnderBrush(intersectionPoint, rayDirection, *intersectedTri, settings);
+        std::sort(triangles.begin(), triangles.end());
+        triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+    }
 
-        // Generate highlight buffer only if our openGlBuffers are valid
-        // Otherwise delay until everything is generated again
-        if(!mOgl.isDirty) {
+    // The whole buffer changes when the continuous setting does, otherwise only the triangles that changed
+    std::vector<size_t> changedTriangles;
+    const bool fullUpdate = mAreaHighlight.triangleMask.size() != mTriangles.size() ||
+                            mAreaHighlight.settings.continuous != settings.continuous;
+    if(fullUpdate) {
+        mAreaHighlight.triangleMask.assign(mTriangles.size(), false);
+    } else {
+        std::set_symmetric_difference(mAreaHighlight.triangles.begin(), mAreaHighlight.triangles.end(),
+                                      triangles.begin(), triangles.end(), std::back_inserter(changedTriangles));
+    }
+
+    for(const size_t triangleIdx : mAreaHighlight.triangles) {
+        mAreaHighlight.triangleMask[triangleIdx] = false;
+    }
+    for(const size_t triangleIdx : triangles) {
+        mAreaHighlight.triangleMask[triangleIdx] = true;
+    }
+
+    mAreaHighlight.triangles = std::move(triangles);
+    mAreaHighlight.hitTriangle = *intersectedTri;
+    mAreaHighlight.settings = settings;
+    mAreaHighlight.size = settings.size;
+    mAreaHighlight.origin = intersectionPoint;
+    mAreaHighlight.direction = rayDirection;
+    mAreaHighlight.enabled = true;
+    mAreaHighlight.dirty = true;
+
+    // Update highlight buffer only if our openGlBuffers are valid
+    // Otherwise delay until everything is generated again
+    if(!mOgl.isDirty) {
+        if(fullUpdate) {
             generateHighlightBuffer();
+        } else {
+            for(const size_t triangleIdx : changedTriangles) {
+                updateHighlightBuffer(triangleIdx);
+            }
         }
-
-        // TODO: Improvement: Try to avoid doing all this if we are highlighting the same triangle with the same
-        // size
-    } else {
-        mAreaHighlight.enabled = false;
     }
 }
 
-void Geometry::paintWithShape(const ci::Ray& ray, const std::vector<Point3>& shape, size_t color, bool paintBackfaces) {
+void Geometry::paintWithShape(const ci::Ray& ray, const std::vector<Point3>& shape, size_t color, bool paintBackfaces,
+                              double gridSize) {
     const std::pair<Point3, double> shapeBounds = GeometryUtils::getBoundingSphere(shape);
     const auto rd = ray.getDirection();
     const Line3 rayLine(shapeBounds.first, Vector3(rd.x, rd.y, rd.z));
 
     std::vector<size_t> trianglesInCylinder = getTrianglesInRadius(rayLine, shapeBounds.second);
 
+    const glm::dvec3 direction(rd);
+    const std::vector<glm::dvec2> projectedShape = GeometryUtils::projectAlongDirection(shape, direction);
+
     // Gather all the TriangleDetails that we want to update
-    std::vector<size_t> detailsToUpdate;
+    std::vector<TriangleDetail*> detailsToUpdate;
+    std::vector<size_t> detailedTriangles;
     for(size_t triIdx : trianglesInCylinder) {
         const auto& cgalTri = getTriangle(triIdx).getTri();
 
-        if(glm::dot(rd, getTriangle(triIdx).getNormal()) > 0 && !paintBackfaces) {
+        const float facing = glm::dot(rd, getTriangle(triIdx).getNormal());
+        if(facing > 0 && !paintBackfaces) {
             continue;  // Skip triangles facing away
         }
 
@@ -473,8 +747,24 @@ void Geometry::paintWithShape(const ci::Ray& ray, const std::vector<Point3>& sha
             continue;  // Do not paint simple triangles of the same color
         }
 
-        detailsToUpdate.emplace_back(triIdx);
-        getTriangleDetail(triIdx);  // Make sure triangle detail is created
+        // Conservative test first, only triangles partially covered by the shape need a detail
+        const auto relation = GeometryUtils::relateProjectedShape(
+            projectedShape,
+            GeometryUtils::projectAlongDirection({cgalTri.vertex(0), cgalTri.vertex(1), cgalTri.vertex(2)}, direction));
+        if(relation == GeometryUtils::ProjectedShapeRelation::Disjoint) {
+            continue;
+        }
+
+        // Triangles parallel to the direction are not painted by the detail either
+        if(relation == GeometryUtils::ProjectedShapeRelation::CoversTriangle &&
+           std::abs(facing) > MIN_COVERED_TRIANGLE_FACING) {
+            setTriangleColor(triIdx, color);
+            continue;
+        }
+
+        // Create or copy the detail here, the map must not be modified from multiple threads
+        detailsToUpdate.emplace_back(getTriangleDetail(triIdx));
+        detailedTriangles.push_back(triIdx);
     }
 
     if(!detailsToUpdate.empty()) {
@@ -484,31 +774,62 @@ void Geometry::paintWithShape(const ci::Ray& ray, const std::vector<Point3>& sha
     // Update in parallel
     auto& threadPool = MainApplication::getThreadPool();
     threadPool.parallel_for(detailsToUpdate.begin(), detailsToUpdate.end(),
-                            [this, &shape, color, &rayLine](size_t triIdx) {
-                                getTriangleDetail(triIdx)->paintShape(shape, rayLine.direction().vector(), color);
+                            [&shape, color, &rayLine, gridSize](TriangleDetail* detail) {
+                                detail->paintShape(shape, rayLine.direction().vector(), color, gridSize);
                             });
 
+    collapseUniformTriangleDetails(detailedTriangles);
     mOgl.isDirty = true;
 }
 
-void Geometry::paintWithShape(const ci::Ray& ray, const std::vector<DataTriangle::Triangle>& triangles, size_t color) {
-    CI_LOG_I(std::string("Shape of ") + std::to_string(triangles.size()) + std::string(" triangles"));
+void Geometry::paintWithShapes(const ci::Ray& ray,
+                               const std::vector<std::vector<TriangleDetail::PolygonOutline>>& shapes, size_t color,
+                               double gridSize) {
+    const auto start = std::chrono::high_resolution_clock::now();
 
-    const std::pair<Point3, double> shapeBounds = GeometryUtils::getBoundingSphere(triangles);
+    // Bounds of each shape, in doubles for the fast test of the triangle bounds
+    std::vector<std::pair<glm::dvec3, double>> shapeBounds;
+    std::vector<const std::vector<TriangleDetail::PolygonOutline>*> nonEmptyShapes;
+    for(const std::vector<TriangleDetail::PolygonOutline>& shape : shapes) {
+        // Holes lie inside the boundaries, only the boundaries are bounded
+        std::vector<Point3> boundaryPoints;
+        for(const TriangleDetail::PolygonOutline& outline : shape) {
+            boundaryPoints.insert(boundaryPoints.end(), outline.boundary.begin(), outline.boundary.end());
+        }
+        if(boundaryPoints.empty()) {
+            continue;
+        }
+        const std::pair<Point3, double> bounds = GeometryUtils::getBoundingSphere(boundaryPoints);
+        const Point3& center = bounds.first;
+        shapeBounds.emplace_back(
+            glm::dvec3(CGAL::to_double(center.x()), CGAL::to_double(center.y()), CGAL::to_double(center.z())),
+            bounds.second);
+        nonEmptyShapes.push_back(&shape);
+    }
+    if(shapeBounds.empty()) {
+        return;
+    }
 
-    CI_LOG_I(std::string("Bounds size: ") + std::to_string(shapeBounds.second));
+    // A single cylinder around all shapes
+    glm::dvec3 textCenter(0.0);
+    for(const auto& bounds : shapeBounds) {
+        textCenter += bounds.first / static_cast<double>(shapeBounds.size());
+    }
+    double textRadius = 0.0;
+    for(const auto& bounds : shapeBounds) {
+        textRadius = std::max(textRadius, glm::distance(textCenter, bounds.first) + bounds.second);
+    }
 
     const auto rd = ray.getDirection();
-    const Line3 rayLine(shapeBounds.first, Vector3(rd.x, rd.y, rd.z));
-
-    std::vector<size_t> trianglesInCylinder = getTrianglesInRadius(rayLine, shapeBounds.second);
-    CI_LOG_I(std::string("Triangles in radius: ") + std::to_string(trianglesInCylinder.size()));
-
-    // Gather all the TriangleDetails that we want to update
-    std::vector<size_t> detailsToUpdate;
+    const glm::dvec3 direction = glm::normalize(glm::dvec3(rd));
+    const Line3 rayLine(Point3(textCenter.x, textCenter.y, textCenter.z), Vector3(rd.x, rd.y, rd.z));
+    const std::vector<size_t> trianglesInCylinder = getTrianglesInRadius(rayLine, textRadius);
+
+    // Group the shapes by the triangles they reach
+    std::vector<TriangleDetail*> detailsToUpdate;
+    std::vector<std::vector<const std::vector<TriangleDetail::PolygonOutline>*>> shapesOfDetails;
+    std::vector<size_t> detailedTriangles;
     for(size_t triIdx : trianglesInCylinder) {
-        const auto& cgalTri = getTriangle(triIdx).getTri();
-
         if(glm::dot(rd, getTriangle(triIdx).getNormal()) >= 0) {
             continue;  // Skip triangles facing away
         }
@@ -517,20 +838,45 @@ void Geometry::paintWithShape(const ci::Ray& ray, const std::vector<DataTriangle
             continue;  // Do not paint simple triangles of the same color
         }
 
-        detailsToUpdate.emplace_back(triIdx);
-        getTriangleDetail(triIdx);  // Make sure triangle detail is created
+        const Point3& triCenter = mTriangleBounds[triIdx].first;
+        const glm::dvec3 triangleCenter(CGAL::to_double(triCenter.x()), CGAL::to_double(triCenter.y()),
+                                        CGAL::to_double(triCenter.z()));
+        std::vector<const std::vector<TriangleDetail::PolygonOutline>*> triangleShapes;
+        for(size_t shapeIdx = 0; shapeIdx < shapeBounds.size(); ++shapeIdx) {
+            // Distance of the bounding spheres perpendicular to the direction, with a margin for rounding
+            const glm::dvec3 offset = triangleCenter - shapeBounds[shapeIdx].first;
+            const glm::dvec3 perpendicular = offset - glm::dot(offset, direction) * direction;
+            const double limit = (shapeBounds[shapeIdx].second + mTriangleBounds[triIdx].second) * (1.0 + 1e-6);
+            if(glm::dot(perpendicular, perpendicular) <= limit * limit) {
+                triangleShapes.push_back(nonEmptyShapes[shapeIdx]);
+            }
+        }
+        if(triangleShapes.empty()) {
+            continue;
+        }
+
+        // Create or copy the detail here, the map must not be modified from multiple threads
+        detailsToUpdate.emplace_back(getTriangleDetail(triIdx));
+        shapesOfDetails.emplace_back(std::move(triangleShapes));
+        detailedTriangles.push_back(triIdx);
     }
-    CI_LOG_I(std::string("Triangles to paint: ") + std::to_string(detailsToUpdate.size()));
     if(!detailsToUpdate.empty()) {
         invalidateTemporaryDetailedData();
     }
 
-    // Update in parallel
+    // Update in parallel, each detail once with all of its shapes
+    std::vector<size_t> detailIndices(detailsToUpdate.size());
+    std::iota(detailIndices.begin(), detailIndices.end(), 0);
+    std::atomic<size_t> detailsDone{0};
     try {
         auto& threadPool = MainApplication::getThreadPool();
         threadPool.parallel_for(
-            detailsToUpdate.begin(), detailsToUpdate.end(), [this, &triangles, color, &rayLine](size_t triIdx) {
-                getTriangleDetail(triIdx)->paintShape(triangles, rayLine.direction().vector(), color);
+            detailIndices.begin(), detailIndices.end(),
+            [&detailsToUpdate, &shapesOfDetails, &detailsDone, color, gridSize, &rayLine, this](size_t detailIdx) {
+                detailsToUpdate[detailIdx]->paintShapes(shapesOfDetails[detailIdx], rayLine.direction().vector(),
+                                                        color, gridSize);
+                mProgress->paintTextPercentage =
+                    static_cast<float>(++detailsDone) / static_cast<float>(detailsToUpdate.size());
             });
 
     } catch(const std::exception& e) {
@@ -538,7 +884,14 @@ void Geometry::paintWithShape(const ci::Ray& ray, const std::vector<DataTriangle
         throw;
     }
 
+    collapseUniformTriangleDetails(detailedTriangles);
     mOgl.isDirty = true;
+
+    const auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> timeMs = end - start;
+    CI_LOG_I("Painted " + std::to_string(shapeBounds.size()) + " shapes into " +
+             std::to_string(detailsToUpdate.size()) + " of " + std::to_string(trianglesInCylinder.size()) +
+             " triangles in radius, " + std::to_string(timeMs.count()) + " ms");
 }
 
 void Geometry::paintAreaWithSphere(const ci::Ray& ray, const BrushSettings& settings) {
@@ -551,7 +904,8 @@ void Geometry::paintAreaWithSphere(const ci::Ray& ray, const BrushSettings& sett
 
     const auto trisInBrush = getTrianglesUnderBrush(intersectionPoint, ray.getDirection(), *intersectedTri, settings);
 
-    std::vector<size_t> detailsToUpdate;
+    std::vector<TriangleDetail*> detailsToUpdate;
+    std::vector<size_t> detailedTriangles;
 
     for(const size_t triangleIdx : trisInBrush) {
         const auto& cgalTri = getTriangle(triangleIdx).getTri();
@@ -568,8 +922,9 @@ void Geometry::paintAreaWithSphere(const ci::Ray& ray, const BrushSettings& sett
             } else {
                 // Do not paint triangles that are already the same color
                 if(!isSimpleTriangle(triangleIdx) || getTriangle(triangleIdx).getColor() != settings.color) {
-                    detailsToUpdate.emplace_back(triangleIdx);
-                    getTriangleDetail(triangleIdx);  // Create triangle detail so that we dont modify
+                    // Create or copy the detail here, the map must not be modified from multiple threads
+                    detailsToUpdate.emplace_back(getTriangleDetail(triangleIdx));
+                    detailedTriangles.push_back(triangleIdx);
                 }
             }
         }
@@ -582,27 +937,294 @@ void Geometry::paintAreaWithSphere(const ci::Ray& ray, const BrushSettings& sett
     const Sphere brushShape(Point3(intersectionPoint.x, intersectionPoint.y, intersectionPoint.z),
                             settings.size * settings.size);
 
+    // Intersections with the edges are shared by the neighbouring details
+    std::vector<std::pair<size_t, size_t>> triangleSpheres;
+    for(const size_t triangleIdx : detailedTriangles) {
+        triangleSpheres.emplace_back(triangleIdx, 0);
+    }
+    const auto edgeIntersections = getSphereEdgeIntersections({brushShape}, triangleSpheres);
+
+    std::vector<std::pair<TriangleDetail*, const TriangleDetail::SphereEdgeIntersections*>> detailsToPaint;
+    for(size_t i = 0; i < detailsToUpdate.size(); ++i) {
+        auto intersectionsIt = edgeIntersections.find({detailedTriangles[i], 0});
+        detailsToPaint.emplace_back(detailsToUpdate[i],
+                                    intersectionsIt != edgeIntersections.end() ? &intersectionsIt->second : nullptr);
+    }
+
     try {
         auto& threadPool = MainApplication::getThreadPool();
         threadPool.parallel_for(
-            detailsToUpdate.begin(), detailsToUpdate.end(), [this, &brushShape, &settings](size_t triIdx) {
-                getTriangleDetail(triIdx)->paintSphere(brushShape, settings.segments, settings.color);
+            detailsToPaint.begin(), detailsToPaint.end(),
+            [&brushShape, &settings, this](
+                const std::pair<TriangleDetail*, const TriangleDetail::SphereEdgeIntersections*>& detailIt) {
+                detailIt.first->paintSphere(brushShape, settings.segments, settings.color, settings.gridSize,
+                                            detailIt.second, settings.chordTolerance);
             });
     } catch(const std::exception& e) {
         CI_LOG_E(e.what());
         throw;
     }
 
+    collapseUniformTriangleDetails(detailedTriangles);
     mOgl.isDirty = true;
 }
 
+std::vector<Geometry::StrokePoint> Geometry::getStrokePoints(const std::vector<ci::Ray>& rays,
+                                                              float brushSize) const {
+    const float maxSpacing = brushSize / 2.f;
+    std::vector<StrokePoint> strokePoints;
+    std::optional<ci::Ray> previousRay;
+    for(const ci::Ray& ray : rays) {
+        glm::vec3 position{};
+        const std::optional<size_t> triangle = intersectMesh(ray, position);
+        if(!triangle) {
+            previousRay.reset();
+            continue;
+        }
+
+        bool connected = previousRay.has_value();
+        if(connected) {
+            const float distance = glm::distance(strokePoints.back().position, position);
+            const int steps = std::min(MAX_STROKE_SUBDIVISIONS, static_cast<int>(std::ceil(distance / maxSpacing)));
+            for(int step = 1; step < steps; ++step) {
+                const float t = static_cast<float>(step) / steps;
+                const ci::Ray sampleRay(glm::mix(previousRay->getOrigin(), ray.getOrigin(), t),
+                                        glm::normalize(glm::mix(previousRay->getDirection(), ray.getDirection(), t)));
+                glm::vec3 samplePosition{};
+                if(const std::optional<size_t> sampleTriangle = intersectMesh(sampleRay, samplePosition)) {
+                    strokePoints.push_back({samplePosition, sampleRay.getDirection(), *sampleTriangle, connected});
+                    connected = true;
+                } else {
+                    connected = false;
+                }
+            }
+        }
+
+        strokePoints.push_back({position, ray.getDirection(), *triangle, connected});
+        previousRay = ray;
+    }
+    return strokePoints;
+}
+
+void Geometry::paintStrokeWithSphere(const std::vector<ci::Ray>& rays, const BrushSettings& settings) {
+    if(settings.respectOriginalTriangles) {
+        // Only whole triangles get painted, there is no shape to sweep
+        for(const ci::Ray& ray : rays) {
+            paintAreaWithSphere(ray, settings);
+        }
+        return;
+    }
+
+    const std::vector<StrokePoint> strokePoints = getStrokePoints(rays, settings.size);
+
+    // Stroke points whose brush touches each triangle
+    std::map<size_t, std::vector<size_t>> trianglePoints;
+    for(size_t pointIdx = 0; pointIdx < strokePoints.size(); ++pointIdx) {
+        const StrokePoint& point = strokePoints[pointIdx];
+        for(const size_t triangleIdx :
+            getTrianglesUnderBrush(point.position, point.direction, point.triangle, settings)) {
+            trianglePoints[triangleIdx].push_back(pointIdx);
+        }
+    }
+
+    std::vector<Sphere> spheres;
+    spheres.reserve(strokePoints.size());
+    for(const StrokePoint& point : strokePoints) {
+        spheres.emplace_back(Point3(point.position.x, point.position.y, point.position.z),
+                             settings.size * settings.size);
+    }
+
+    /// Indices of the stroke points at the start and at the end of the segment
+    using PointSegments = std::vector<std::pair<size_t, size_t>>;
+    std::vector<std::pair<TriangleDetail*, PointSegments>> detailsToUpdate;
+    std::vector<size_t> detailedTriangles;
+    std::vector<std::pair<size_t, size_t>> triangleSpheres;
+    for(const auto& triangleIt : trianglePoints) {
+        const size_t triangleIdx = triangleIt.first;
+        const auto& cgalTri = getTriangle(triangleIdx).getTri();
+
+        const bool isFullyInside =
+            std::any_of(triangleIt.second.begin(), triangleIt.second.end(), [&](size_t pointIdx) {
+                return GeometryUtils::isFullyInsideASphere(cgalTri, strokePoints[pointIdx].position, settings.size);
+            });
+        if(isFullyInside) {
+            // Triangles fully inside are colored whole
+            setTriangleColor(triangleIdx, settings.color);
+            continue;
+        }
+
+        // Do not paint triangles that are already the same color
+        if(isSimpleTriangle(triangleIdx) && getTriangle(triangleIdx).getColor() == settings.color) {
+            continue;
+        }
+
+        // Segments ending or starting in a point touching the triangle, isolated points are painted as spheres
+        std::set<size_t> segmentStarts;
+        PointSegments segments;
+        for(const size_t pointIdx : triangleIt.second) {
+            const bool connectedToPrevious = strokePoints[pointIdx].connected;
+            const bool connectedToNext = pointIdx + 1 < strokePoints.size() && strokePoints[pointIdx + 1].connected;
+            if(connectedToPrevious) {
+                segmentStarts.insert(pointIdx - 1);
+            }
+            if(connectedToNext) {
+                segmentStarts.insert(pointIdx);
+            }
+            if(!connectedToPrevious && !connectedToNext) {
+                segments.emplace_back(pointIdx, pointIdx);
+            }
+        }
+        for(const size_t startIdx : segmentStarts) {
+            segments.emplace_back(startIdx, startIdx + 1);
+        }
+
+        std::set<size_t> segmentPoints;
+        for(const auto& segment : segments) {
+            segmentPoints.insert(segment.first);
+            segmentPoints.insert(segment.second);
+        }
+        for(const size_t pointIdx : segmentPoints) {
+            triangleSpheres.emplace_back(triangleIdx, pointIdx);
+        }
+
+        // Create or copy the detail here, the map must not be modified from multiple threads
+        detailsToUpdate.emplace_back(getTriangleDetail(triangleIdx), std::move(segments));
+        detailedTriangles.push_back(triangleIdx);
+    }
+
+    if(!detailsToUpdate.empty()) {
+        invalidateTemporaryDetailedData();
+    }
+
+    // Intersections with the edges are shared by the neighbouring details
+    const auto edgeIntersections = getSphereEdgeIntersections(spheres, triangleSpheres);
+    const auto findEdgeIntersections = [&edgeIntersections](size_t triangleIdx, size_t pointIdx) {
+        auto intersectionsIt = edgeIntersections.find({triangleIdx, pointIdx});
+        return intersectionsIt != edgeIntersections.end() ? &intersectionsIt->second : nullptr;
+    };
+
+    using SweptSegments = std::vector<TriangleDetail::SweptSegment>;
+    std::vector<std::pair<TriangleDetail*, SweptSegments>> detailsToPaint;
+    for(size_t i = 0; i < detailsToUpdate.size(); ++i) {
+        const size_t triangleIdx = detailedTriangles[i];
+        SweptSegments segments;
+        for(const auto& segment : detailsToUpdate[i].second) {
+            segments.push_back({spheres[segment.first], spheres[segment.second],
+                                findEdgeIntersections(triangleIdx, segment.first),
+                                findEdgeIntersections(triangleIdx, segment.second)});
+        }
+        detailsToPaint.emplace_back(detailsToUpdate[i].first, std::move(segments));
+    }
+
+    try {
+        auto& threadPool = MainApplication::getThreadPool();
+        threadPool.parallel_for(detailsToPaint.begin(), detailsToPaint.end(),
+                                [&settings, this](const std::pair<TriangleDetail*, SweptSegments>& detailIt) {
+                                    detailIt.first->paintSweptSphere(detailIt.second, settings.segments,
+                                                                     settings.color, settings.gridSize,
+                                                                     settings.chordTolerance);
+                                });
+    } catch(const std::exception& e) {
+        CI_LOG_E(e.what());
+        throw;
+    }
+
+    collapseUniformTriangleDetails(detailedTriangles);
+    mOgl.isDirty = true;
+}
+
+std::map<std::pair<size_t, size_t>, TriangleDetail::SphereEdgeIntersections> Geometry::getSphereEdgeIntersections(
+    const std::vector<Sphere>& spheres, const std::vector<std::pair<size_t, size_t>>& triangleSpheres) const {
+    std::map<std::pair<size_t, size_t>, TriangleDetail::SphereEdgeIntersections> result;
+    if(!mPolyhedronData.valid) {
+        return result;
+    }
+
+    const auto& mesh = mPolyhedronData.mMesh;
+
+    /// Intersection of a sphere with a mesh edge. The points are kept rational, each detail gets its own lazy copies,
+    /// because details painted in parallel must not share any lazy evaluation.
+    struct EdgeQuery {
+        size_t sphereIdx;
+        glm::vec3 first;
+        glm::vec3 second;
+        std::vector<TriangleDetail::RationalK::Point_3> points;
+    };
+
+    // Find the mesh edge of each triangle edge, every pair of a sphere and a mesh edge is queried once
+    std::map<std::pair<size_t, size_t>, size_t> queryIds;
+    std::vector<EdgeQuery> queries;
+    std::vector<std::pair<std::pair<size_t, size_t>, std::array<size_t, 3>>> triangleQueries;
+    for(const auto& triangleSphere : triangleSpheres) {
+        const size_t triangleIdx = triangleSphere.first;
+        const DataTriangle& triangle = getTriangle(triangleIdx);
+        P_ASSERT(triangleSphere.second < spheres.size());
+        P_ASSERT(triangleIdx < mPolyhedronData.mFaceDescs.size());
+
+        std::array<size_t, 3> edgeQueries{};
+        bool foundAllEdges = true;
+        for(size_t i = 0; i < 3 && foundAllEdges; ++i) {
+            // Edge i of the triangle goes from vertex i to vertex i + 1
+            const Point3 first = triangle.getTri().vertex(static_cast<int>(i));
+            const Point3 second = triangle.getTri().vertex(static_cast<int>((i + 1) % 3));
+
+            std::optional<size_t> edgeIdx;
+            auto halfedge = mesh.halfedge(mPolyhedronData.mFaceDescs[triangleIdx]);
+            for(int halfedgeIdx = 0; halfedgeIdx < 3 && !edgeIdx; ++halfedgeIdx) {
+                const Point3& source = mesh.point(mesh.source(halfedge));
+                const Point3& target = mesh.point(mesh.target(halfedge));
+                if((source == first && target == second) || (source == second && target == first)) {
+                    edgeIdx = static_cast<size_t>(mesh.edge(halfedge).idx());
+                }
+                halfedge = mesh.next(halfedge);
+            }
+            if(!edgeIdx) {
+                foundAllEdges = false;
+                break;
+            }
+
+            auto queryIt = queryIds.emplace(std::make_pair(triangleSphere.second, *edgeIdx), queries.size());
+            if(queryIt.second) {
+                queries.push_back({triangleSphere.second, triangle.getVertex(i), triangle.getVertex((i + 1) % 3), {}});
+            }
+            edgeQueries[i] = queryIt.first->second;
+        }
+
+        if(foundAllEdges) {
+            triangleQueries.emplace_back(triangleSphere, edgeQueries);
+        }
+    }
+
+    std::vector<size_t> queryIndices(queries.size());
+    std::iota(queryIndices.begin(), queryIndices.end(), 0);
+    MainApplication::getThreadPool().parallel_for(
+        queryIndices.begin(), queryIndices.end(), [&queries, &spheres](size_t queryIdx) {
+            EdgeQuery& query = queries[queryIdx];
+            for(const TriangleDetail::Point3& point :
+                TriangleDetail::intersectSphereWithEdge(spheres[query.sphereIdx], query.first, query.second)) {
+                query.points.push_back(TriangleDetail::toRational(point));
+            }
+        });
+
+    for(const auto& triangleQuery : triangleQueries) {
+        TriangleDetail::SphereEdgeIntersections& intersections = result[triangleQuery.first];
+        for(size_t i = 0; i < 3; ++i) {
+            for(const auto& point : queries[triangleQuery.second[i]].points) {
+                intersections[i].push_back(TriangleDetail::fromRational(point));
+            }
+        }
+    }
+    return result;
+}
+
 TriangleDetail* Geometry::createTriangleDetail(size_t triangleIdx) {
-    auto result = mTriangleDetails.emplace(triangleIdx, TriangleDetail(getTriangle(triangleIdx)));
+    auto result = mTriangleDetails.emplace(triangleIdx, std::make_shared<TriangleDetail>(getTriangle(triangleIdx)));
 
-    return &(result.first->second);
+    return result.first->second.get();
 }
 
 void Geometry::removeTriangleDetail(const size_t triangleIndex) {
+    recordTriangleDetail(triangleIndex);
     mOgl.isDirty = true;
     mTriangleDetails.erase(triangleIndex);
 
@@ -610,7 +1232,23 @@ void Geometry::removeTriangleDetail(const size_t triangleIndex) {
     invalidateTemporaryDetailedData();
 }
 
+void Geometry::collapseUniformTriangleDetails(const std::vector<size_t>& triangleIndices) {
+    for(const size_t triangleIdx : triangleIndices) {
+        const TriangleDetail* detail = findTriangleDetail(triangleIdx);
+        if(!detail) {
+            continue;
+        }
+
+        if(const std::optional<size_t> uniformColor = detail->getUniformColor()) {
+            setTriangleColor(triangleIdx, *uniformColor);
+        }
+    }
+}
+
 void Geometry::setTriangleColor(const size_t triangleIndex, const size_t newColor) {
+    P_ASSERT(triangleIndex < mTriangles.size());
+    recordTriangleColor(triangleIndex);
+
     if(isSimpleTriangle(triangleIndex)) {
         if(!mOgl.isDirty) {
             // Change it in the buffer
@@ -626,6 +1264,7 @@ void Geometry::setTriangleColor(const size_t triangleIndex, const size_t newColo
             mOgl.colorBuffer[vertexPosition + 2] = newColorIndex;
             mOgl.info.didColorUpdate = true;
         }
+        markBucketRegionRecolored(DetailedTriangleId(triangleIndex));
     } else {
         removeTriangleDetail(triangleIndex);
     }
@@ -646,6 +1285,7 @@ void Geometry::setTriangleColor(const DetailedTriangleId triangleId, const size_
 
         TriangleDetail* detail = getTriangleDetail(baseId);
         detail->setColor(detailId, newColor);
+        markBucketRegionRecolored(triangleId);
 
         if(!mOgl.isDirty) {
             const size_t vertexPosition =
@@ -662,12 +1302,220 @@ void Geometry::setTriangleColor(const DetailedTriangleId triangleId, const size_
     }
 }
 
+void Geometry::setTriangleColors(const TriangleSelection& selection, const size_t newColor) {
+    ::ThreadPool& threadPool = MainApplication::getThreadPool();
+    const ColorIndex newColorIndex = static_cast<ColorIndex>(newColor);
+
+    // Amount of triangles colored by a single task
+    const size_t chunkSize = 4096;
+
+    /// Detailed triangles of one base triangle to be colored
+    struct DetailUpdate {
+        TriangleDetail* detail;
+        const TriangleSelection::RangeList* ranges;
+        std::optional<size_t> colorBufferStart;
+    };
+
+    // Collect the details first, getting a detail may copy it or record it in a diff
+    const bool detailBufferValid = !mOgl.isDirty;
+    std::vector<DetailUpdate> detailsToUpdate;
+    detailsToUpdate.reserve(selection.getDetailRanges().size());
+    for(const auto& detailIt : selection.getDetailRanges()) {
+        const size_t baseId = detailIt.first;
+        P_ASSERT(baseId < mTriangles.size());
+        P_ASSERT(!isSimpleTriangle(baseId));
+        P_ASSERT(detailIt.second.back().end <= getTriangleDetailCount(baseId));
+
+        std::optional<size_t> colorBufferStart;
+        if(detailBufferValid) {
+            colorBufferStart = mTriangleDetailColorBufferStart.at(baseId);
+        }
+        detailsToUpdate.push_back({getTriangleDetail(baseId), &detailIt.second, colorBufferStart});
+    }
+
+    const auto updateDetail = [this, newColor, newColorIndex](const DetailUpdate& update) {
+        for(const TriangleSelection::Range& range : *update.ranges) {
+            for(size_t detailId = range.begin; detailId < range.end; ++detailId) {
+                update.detail->setColor(detailId, newColor);
+
+                if(update.colorBufferStart) {
+                    const size_t vertexPosition = *update.colorBufferStart + 3 * detailId;
+                    P_ASSERT(vertexPosition + 2 < mOgl.colorBuffer.size());
+                    mOgl.colorBuffer[vertexPosition] = newColorIndex;
+                    mOgl.colorBuffer[vertexPosition + 1] = newColorIndex;
+                    mOgl.colorBuffer[vertexPosition + 2] = newColorIndex;
+                }
+            }
+        }
+    };
+
+    if(detailsToUpdate.size() > 1) {
+        threadPool.parallel_for(detailsToUpdate.begin(), detailsToUpdate.end(), updateDetail);
+    } else {
+        std::for_each(detailsToUpdate.begin(), detailsToUpdate.end(), updateDetail);
+    }
+    if(mBucketRegions) {
+        selection.forEach([this](const DetailedTriangleId triangleId) {
+            if(triangleId.getDetailId()) {
+                markBucketRegionRecolored(triangleId);
+            }
+        });
+    }
+
+    // Details whose triangles all got the new color are not needed anymore
+    std::vector<size_t> detailedTriangles;
+    detailedTriangles.reserve(selection.getDetailRanges().size());
+    for(const auto& detailIt : selection.getDetailRanges()) {
+        detailedTriangles.push_back(detailIt.first);
+    }
+    collapseUniformTriangleDetails(detailedTriangles);
+
+    // Base triangles that get colored as a whole lose their details
+    for(const TriangleSelection::Range& range : selection.getBaseRanges()) {
+        P_ASSERT(range.end <= mTriangles.size());
+        for(size_t triangleIndex = range.begin; triangleIndex < range.end; ++triangleIndex) {
+            recordTriangleColor(triangleIndex);
+            if(!isSimpleTriangle(triangleIndex)) {
+                removeTriangleDetail(triangleIndex);
+            } else {
+                markBucketRegionRecolored(DetailedTriangleId(triangleIndex));
+            }
+        }
+    }
+
+    // Removing a detail makes the buffers dirty, only patch them if they are still valid
+    const bool baseBufferValid = !mOgl.isDirty;
+    const auto updateBase = [this, newColor, newColorIndex, baseBufferValid](const TriangleSelection::Range& range) {
+        for(size_t triangleIndex = range.begin; triangleIndex < range.end; ++triangleIndex) {
+            mTriangles[triangleIndex].setColor(newColor);
+
+            if(baseBufferValid) {
+                // Color buffer has 1 ColorA for each vertex, each triangle has 3 vertices
+                const size_t vertexPosition = triangleIndex * 3;
+                P_ASSERT(vertexPosition + 2 < mOgl.colorBuffer.size());
+                mOgl.colorBuffer[vertexPosition] = newColorIndex;
+                mOgl.colorBuffer[vertexPosition + 1] = newColorIndex;
+                mOgl.colorBuffer[vertexPosition + 2] = newColorIndex;
+            }
+        }
+    };
+
+    const TriangleSelection::RangeList chunks = TriangleSelection::splitRanges(selection.getBaseRanges(), chunkSize);
+    if(chunks.size() > 1) {
+        threadPool.parallel_for(chunks.begin(), chunks.end(), updateBase);
+    } else {
+        std::for_each(chunks.begin(), chunks.end(), updateBase);
+    }
+
+    if(!mOgl.isDirty && !selection.empty()) {
+        mOgl.info.didColorUpdate = true;
+    }
+}
+
+void Geometry::compactTriangleDetails() {
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    // Compacting is not recorded, the compacted detail has the same values
+    P_ASSERT(!mRecordedDiff);
+
+    std::vector<std::shared_ptr<TriangleDetail>*> detailsToCompact;
+    for(auto& detailIt : mTriangleDetails) {
+        if(detailIt.second->hasUncompactedOperations()) {
+            detailsToCompact.push_back(&detailIt.second);
+        }
+    }
+
+    if(detailsToCompact.empty()) {
+        return;
+    }
+
+    // Details shared with saved states and diffs are copied first. The copies still share the lazy values with the
+    // saved details, so they are compacted in this thread only, the rest of the details in parallel.
+    std::vector<std::shared_ptr<TriangleDetail>*> unsharedDetails;
+    for(std::shared_ptr<TriangleDetail>* detail : detailsToCompact) {
+        if(detail->use_count() > 1) {
+            *detail = std::make_shared<TriangleDetail>(**detail);
+            (*detail)->compactExactValues();
+        } else {
+            unsharedDetails.push_back(detail);
+        }
+    }
+
+    auto& threadPool = MainApplication::getThreadPool();
+    threadPool.parallel_for(unsharedDetails.begin(), unsharedDetails.end(),
+                            [](std::shared_ptr<TriangleDetail>* detail) { (*detail)->compactExactValues(); });
+
+    const auto endTime = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> timeMs = endTime - startTime;
+    CI_LOG_I("Compacting " + std::to_string(detailsToCompact.size()) + " triangle details took " +
+             std::to_string(timeMs.count()) + " ms");
+}
+
+void Geometry::remapColorIds(const std::vector<size_t>& newColorIds) {
+    ::ThreadPool& threadPool = MainApplication::getThreadPool();
+    const auto newColorId = [&newColorIds](size_t colorId) {
+        P_ASSERT(colorId < newColorIds.size());
+        return newColorIds[colorId];
+    };
+
+    // Amount of triangles or buffer entries remapped by a single task
+    const size_t chunkSize = 4096;
+
+    // Colors may get merged, the regions stopping on colors have to be labelled again
+    if(mBucketRegions && mBucketRegions->key.stopOnColor) {
+        mBucketRegions.reset();
+    }
+
+    for(size_t triangleIndex = 0; triangleIndex < mTriangles.size(); ++triangleIndex) {
+        if(mTriangles[triangleIndex].getColor() != newColorId(mTriangles[triangleIndex].getColor())) {
+            recordTriangleColor(triangleIndex);
+        }
+    }
+
+    // Collect the details first, getting a detail may copy it or record it in a diff. Details whose colors stay the
+    // same are left shared with the saved states.
+    std::vector<TriangleDetail*> detailsToUpdate;
+    for(auto& detailIt : mTriangleDetails) {
+        if(detailIt.second->changesColorIds(newColorId)) {
+            detailsToUpdate.push_back(getTriangleDetail(detailIt.first));
+        }
+    }
+
+    const TriangleSelection::RangeList triangleChunks =
+        TriangleSelection::splitRanges({{0, mTriangles.size()}}, chunkSize);
+    threadPool.parallel_for(triangleChunks.begin(), triangleChunks.end(),
+                            [this, &newColorId](const TriangleSelection::Range& chunk) {
+                                for(size_t triangleIndex = chunk.begin; triangleIndex < chunk.end; ++triangleIndex) {
+                                    DataTriangle& triangle = mTriangles[triangleIndex];
+                                    triangle.setColor(newColorId(triangle.getColor()));
+                                }
+                            });
+
+    threadPool.parallel_for(detailsToUpdate.begin(), detailsToUpdate.end(),
+                            [&newColorId](TriangleDetail* detail) { detail->changeColorIds(newColorId); });
+
+    // The buffers keep their layout, only the color ids in them change
+    if(!mOgl.isDirty) {
+        const TriangleSelection::RangeList bufferChunks =
+            TriangleSelection::splitRanges({{0, mOgl.colorBuffer.size()}}, chunkSize);
+        threadPool.parallel_for(bufferChunks.begin(), bufferChunks.end(),
+                                [this, &newColorId](const TriangleSelection::Range& chunk) {
+                                    for(size_t i = chunk.begin; i < chunk.end; ++i) {
+                                        mOgl.colorBuffer[i] = static_cast<ColorIndex>(newColorId(mOgl.colorBuffer[i]));
+                                    }
+                                });
+        mOgl.info.didColorUpdate = true;
+    }
+}
+
 void Geometry::buildPolyhedron() {
     mProgress->polyhedronPercentage = 0.0f;
     mPolyhedronData.mMesh.clear();
     mPolyhedronData.mMesh.remove_property_map(mPolyhedronData.mIdMap);
     mPolyhedronData.mMesh.remove_property_map(mPolyhedronData.sdf_property_map);
     mPolyhedronData.isSdfComputed = false;
+    mPolyhedronData.neighbourIds.clear();
+    mPolyhedronData.neighbourCosines.clear();
     mPolyhedronData.valid = false;
     mPolyhedronData.mFaceDescs.clear();
 
@@ -722,6 +1570,76 @@ void Geometry::buildPolyhedron() {
     mProgress->polyhedronPercentage = 1.0f;
 }
 
+void Geometry::computeNeighbourCosines() {
+    if(!mPolyhedronData.valid) {
+        return;
+    }
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    // Filled aside, gatherNeighbours() reads the table once it is set
+    const size_t triangleCount = mPolyhedronData.mFaceDescs.size();
+    std::vector<int> neighbourIds(3 * triangleCount, -1);
+    std::vector<double> neighbourCosines(3 * triangleCount, std::numeric_limits<double>::quiet_NaN());
+
+    // Amount of triangles computed by a single task
+    const size_t chunkSize = 4096;
+
+    const auto computeCosines = [this, &neighbourIds, &neighbourCosines](const TriangleSelection::Range& range) {
+        for(size_t triIdx = range.begin; triIdx < range.end; ++triIdx) {
+            const std::array<int, 3> neighbours = gatherNeighbours(triIdx);
+            const glm::vec3 normal = glm::normalize(mTriangles[triIdx].getNormal());
+            for(int i = 0; i < 3; ++i) {
+                if(neighbours[i] == -1) {
+                    continue;
+                }
+
+                neighbourIds[3 * triIdx + i] = neighbours[i];
+                neighbourCosines[3 * triIdx + i] =
+                    glm::dot(normal, glm::normalize(mTriangles[neighbours[i]].getNormal()));
+            }
+        }
+    };
+
+    const TriangleSelection::RangeList chunks = TriangleSelection::splitRanges({{0, triangleCount}}, chunkSize);
+    MainApplication::getThreadPool().parallel_for(chunks.begin(), chunks.end(), computeCosines);
+    mPolyhedronData.neighbourIds = std::move(neighbourIds);
+    mPolyhedronData.neighbourCosines = std::move(neighbourCosines);
+
+    const auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> timeMs = end - start;
+    CI_LOG_I("Computing cosines of neighbours of " + std::to_string(triangleCount) + " triangles took " +
+             std::to_string(timeMs.count()) + " ms");
+}
+
+double Geometry::getNeighbourCosine(const size_t firstTriangle, const size_t secondTriangle) const {
+    if(!mPolyhedronData.neighbourIds.empty()) {
+        P_ASSERT(3 * firstTriangle + 2 < mPolyhedronData.neighbourIds.size());
+        const int* neighbours = &mPolyhedronData.neighbourIds[3 * firstTriangle];
+        for(int i = 0; i < 3; ++i) {
+            if(neighbours[i] == static_cast<int>(secondTriangle)) {
+                return getEdgeCosine(firstTriangle, i);
+            }
+        }
+    }
+
+    return glm::dot(glm::normalize(getTriangle(firstTriangle).getNormal()),
+                    glm::normalize(getTriangle(secondTriangle).getNormal()));
+}
+
+std::vector<std::pair<size_t, size_t>> Geometry::getSharpEdges(const double cosThreshold) const {
+    std::vector<std::pair<size_t, size_t>> result;
+    const std::vector<int>& neighbourIds = mPolyhedronData.neighbourIds;
+    for(size_t slot = 0; slot < neighbourIds.size(); ++slot) {
+        // Each edge is in the table twice, borders are NaN and never sharp
+        const size_t triIdx = slot / 3;
+        if(neighbourIds[slot] > static_cast<int>(triIdx) && mPolyhedronData.neighbourCosines[slot] < cosThreshold) {
+            result.emplace_back(triIdx, static_cast<size_t>(neighbourIds[slot]));
+        }
+    }
+    return result;
+}
+
 void Geometry::buildDetailedTree() {
     mTreeDetailed = std::make_unique<Tree>();
 
@@ -731,7 +1649,7 @@ void Geometry::buildDetailedTree() {
             mTreeDetailed->insert(DataTriangleAABBPrimitive(this, DetailedTriangleId(triangleIdx)));
         } else {
             // Insert all detail triangles for this tri
-            const TriangleDetail* detail = getTriangleDetail(triangleIdx);
+            const TriangleDetail* detail = findTriangleDetail(triangleIdx);
             P_ASSERT(detail);
             const auto& detailTriangles = detail->getTriangles();
             for(size_t detailIdx = 0; detailIdx < detailTriangles.size(); detailIdx++) {
@@ -751,6 +1669,7 @@ void Geometry::buildDetailedMesh() {
 
     mMeshDetailed = std::make_unique<PolyhedronData::Mesh>();
     mMeshDetailedFaceDescs.clear();
+    mBucketRegions.reset();
     mMeshDetailedIdMap.reset();
     bool created;
     boost::tie(mMeshDetailedIdMap, created) =
@@ -801,7 +1720,7 @@ void Geometry::buildDetailedMesh() {
     // Add detailed faces
     for(const auto& triDetailIt : mTriangleDetails) {
         const size_t triangleId = triDetailIt.first;
-        const auto& detailTriangles = triDetailIt.second.getTriangles();
+        const auto& detailTriangles = triDetailIt.second->getTriangles();
 
         // Add detail triangles while combining common vertices
         for(size_t detailTriangleIdx = 0; detailTriangleIdx < detailTriangles.size(); detailTriangleIdx++) {
@@ -876,6 +1795,14 @@ void Geometry::correctSharedVertices() {
         const size_t secondTriIdx = mPolyhedronData.mIdMap[secondFace];
 
         if(!isSimpleTriangle(firstTriIdx) || !isSimpleTriangle(secondTriIdx)) {
+            const TriangleDetail* firstDetail = findTriangleDetail(firstTriIdx);
+            const TriangleDetail* secondDetail = findTriangleDetail(secondTriIdx);
+
+            // Check without modifying first, so that details shared with saved states do not get copied needlessly
+            if(firstDetail && secondDetail && firstDetail->hasMatchingSharedVertices(*secondDetail)) {
+                continue;
+            }
+
             std::pair<bool, bool> didAdd =
                 getTriangleDetail(firstTriIdx)->correctSharedVertices(*getTriangleDetail(secondTriIdx));
 
@@ -924,9 +1851,17 @@ void Geometry::updateTemporaryDetailedData() {
 void Geometry::invalidateTemporaryDetailedData() {
     mTreeDetailed.reset();
     mMeshDetailed.reset();
+    mBucketRegions.reset();
 }
 
 std::array<int, 3> Geometry::gatherNeighbours(const size_t triIndex) const {
+    // Read from the table once it is filled, see computeNeighbourCosines()
+    const std::vector<int>& neighbourIds = mPolyhedronData.neighbourIds;
+    if(!neighbourIds.empty()) {
+        P_ASSERT(3 * triIndex + 2 < neighbourIds.size());
+        return {neighbourIds[3 * triIndex], neighbourIds[3 * triIndex + 1], neighbourIds[3 * triIndex + 2]};
+    }
+
     const auto& faceDescriptors = mPolyhedronData.mFaceDescs;
     const auto& mesh = mPolyhedronData.mMesh;
     P_ASSERT(triIndex < faceDescriptors.size());
@@ -976,6 +1911,149 @@ std::array<std::optional<DetailedTriangleId>, 3> Geometry::gatherNeighbours(cons
     return returnValue;
 }
 
+std::array<std::optional<size_t>, 3> Geometry::gatherDetailedNeighbourFaces(const size_t faceIdx) const {
+    P_ASSERT(mMeshDetailed);
+
+    const auto& mesh = *mMeshDetailed;
+    std::array<std::optional<size_t>, 3> returnValue = {};
+    const PolyhedronData::face_descriptor face(static_cast<PolyhedronData::Mesh::size_type>(faceIdx));
+    const auto edge = mesh.halfedge(face);
+    auto itEdge = edge;
+
+    for(int i = 0; i < 3; ++i) {
+        const auto oppositeEdge = mesh.opposite(itEdge);
+        if(oppositeEdge.is_valid() && !mesh.is_border(oppositeEdge)) {
+            returnValue[i] = static_cast<size_t>(mesh.face(oppositeEdge));
+        }
+
+        itEdge = mesh.next(itEdge);
+    }
+    P_ASSERT(edge == itEdge);
+
+    return returnValue;
+}
+
+void Geometry::uniteBucketRegions(const std::vector<size_t>& faces, bool allNeighbours,
+                                  const BucketCondition& stopFunctor) {
+    P_ASSERT(mMeshDetailed && mBucketRegions);
+
+    // Amount of faces checked by a single task
+    const size_t chunkSize = 4096;
+
+    ComponentLabels& labels = mBucketRegions->labels;
+    const auto uniteFaces = [this, &faces, allNeighbours, &stopFunctor,
+                             &labels](const TriangleSelection::Range& range) {
+        for(size_t i = range.begin; i < range.end; ++i) {
+            const size_t faceIdx = faces[i];
+            const DetailedTriangleId faceId = mMeshDetailedIdMap[PolyhedronData::face_descriptor(
+                static_cast<PolyhedronData::Mesh::size_type>(faceIdx))];
+            for(const std::optional<size_t>& neighbourIdx : gatherDetailedNeighbourFaces(faceIdx)) {
+                if(!neighbourIdx || (!allNeighbours && *neighbourIdx < faceIdx)) {
+                    continue;
+                }
+
+                const DetailedTriangleId neighbourId = mMeshDetailedIdMap[PolyhedronData::face_descriptor(
+                    static_cast<PolyhedronData::Mesh::size_type>(*neighbourIdx))];
+                if(stopFunctor(neighbourId, faceId)) {
+                    labels.unite(faceIdx, *neighbourIdx);
+                }
+            }
+        }
+    };
+
+    const TriangleSelection::RangeList chunks = TriangleSelection::splitRanges({{0, faces.size()}}, chunkSize);
+    if(chunks.size() > 1) {
+        MainApplication::getThreadPool().parallel_for(chunks.begin(), chunks.end(), uniteFaces);
+    } else {
+        std::for_each(chunks.begin(), chunks.end(), uniteFaces);
+    }
+    labels.updateLabels();
+}
+
+std::vector<DetailedTriangleId> Geometry::bucketRegion(const DetailedTriangleId startTriangle,
+                                                       const BucketRegionKey& key,
+                                                       const BucketCondition& stopFunctor) {
+    if(mPolyhedronData.mMesh.is_empty()) {
+        return {};
+    }
+
+    if(!isTemporaryDetailedDataValid()) {
+        updateTemporaryDetailedData();
+    }
+    if(!mMeshDetailed) {
+        return bucket(startTriangle, stopFunctor);
+    }
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    const size_t faceCount = mMeshDetailed->number_of_faces();
+    if(!mBucketRegions || !(mBucketRegions->key == key)) {
+        mBucketRegions = std::make_unique<BucketRegions>(BucketRegions{key, ComponentLabels(faceCount), {}});
+
+        std::vector<size_t> faces(faceCount);
+        std::iota(faces.begin(), faces.end(), 0);
+        uniteBucketRegions(faces, false, stopFunctor);
+
+        const auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> timeMs = end - start;
+        CI_LOG_I("Labelling bucket regions took " + std::to_string(timeMs.count()) + " ms");
+    } else if(!mBucketRegions->recoloredLabels.empty()) {
+        // Split the recolored regions and let their faces spread again, also into the regions around them
+        std::vector<size_t>& recoloredLabels = mBucketRegions->recoloredLabels;
+        std::sort(recoloredLabels.begin(), recoloredLabels.end());
+        recoloredLabels.erase(std::unique(recoloredLabels.begin(), recoloredLabels.end()), recoloredLabels.end());
+
+        ComponentLabels& labels = mBucketRegions->labels;
+        std::vector<size_t> faces;
+        for(const size_t label : recoloredLabels) {
+            const ComponentLabels::Component component = labels.getComponent(label);
+            faces.insert(faces.end(), component.begin(), component.end());
+            labels.resetComponent(label);
+        }
+        recoloredLabels.clear();
+        uniteBucketRegions(faces, true, stopFunctor);
+
+        const auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> timeMs = end - start;
+        CI_LOG_I("Labelling " + std::to_string(faces.size()) + " recolored bucket region triangles took " +
+                 std::to_string(timeMs.count()) + " ms");
+    }
+
+    const auto faceIt = mMeshDetailedFaceDescs.find(startTriangle);
+    P_ASSERT(faceIt != mMeshDetailedFaceDescs.end());
+    if(faceIt == mMeshDetailedFaceDescs.end()) {
+        return {};
+    }
+
+    const ComponentLabels& labels = mBucketRegions->labels;
+    const ComponentLabels::Component component =
+        labels.getComponent(labels.getLabel(static_cast<size_t>(faceIt->second)));
+    std::vector<DetailedTriangleId> result;
+    result.reserve(component.size());
+    for(const size_t faceIdx : component) {
+        result.push_back(
+            mMeshDetailedIdMap[PolyhedronData::face_descriptor(static_cast<PolyhedronData::Mesh::size_type>(faceIdx))]);
+    }
+    return result;
+}
+
+void Geometry::markBucketRegionRecolored(const DetailedTriangleId triangleId) {
+    if(!mBucketRegions || !mBucketRegions->key.stopOnColor || !mMeshDetailed) {
+        return;
+    }
+
+    const auto faceIt = mMeshDetailedFaceDescs.find(triangleId);
+    if(faceIt == mMeshDetailedFaceDescs.end()) {
+        mBucketRegions.reset();
+        return;
+    }
+    // Recolored triangles usually come in whole regions
+    const size_t label = mBucketRegions->labels.getLabel(static_cast<size_t>(faceIt->second));
+    std::vector<size_t>& recoloredLabels = mBucketRegions->recoloredLabels;
+    if(recoloredLabels.empty() || recoloredLabels.back() != label) {
+        recoloredLabels.push_back(label);
+    }
+}
+
 void Geometry::computeSdf() {
     mProgress->sdfPercentage = 0.0f;
     mPolyhedronData.isSdfComputed = false;
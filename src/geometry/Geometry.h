@@ -12,12 +12,18 @@
 #include <cereal/types/vector.hpp>
 #include "cinder/Log.h"
 
+#include <functional>
+#include <future>
 #include <map>
+#include <memory>
 #include <optional>
 #include <unordered_map>
 #include <vector>
 
+#include "MemoryUsageCounter.h"
 #include "geometry/ColorManager.h"
+#include "geometry/CompactColorArray.h"
+#include "geometry/ComponentLabels.h"
 #include "geometry/GeometryProgress.h"
 #include "geometry/GlmSerialization.h"
 #include "geometry/ModelImporter.h"
@@ -25,6 +31,7 @@
 #include "geometry/Triangle.h"
 #include "geometry/TriangleDetail.h"
 #include "geometry/TrianglePrimitive.h"
+#include "geometry/TriangleSelection.h"
 #include "peprassert.h"
 #include "tools/Brush.h"
 
@@ -47,10 +54,38 @@ class Geometry {
     using BoundingBox = My_AABB_traits::Bounding_box;
     using ColorIndex = GLuint;
 
+    /// Triangle details are shared between the Geometry and its saved states and copied only when they are modified
+    /// (copy-on-write). A detail that is referenced from more than one place must never be changed in place.
+    using TriangleDetailMap = std::map<size_t, std::shared_ptr<TriangleDetail>>;
+
+    /// Changes done by a single command, so that it can be undone and redone without replaying it. See beginDiff().
+    struct GeometryDiff {
+        /// Colors of triangles before and after the change
+        std::unordered_map<size_t, std::pair<size_t, size_t>> triangleColors;
+
+        /// Details before and after the change, nullptr for a simple triangle. Shared, see TriangleDetailMap.
+        std::map<size_t, std::pair<std::shared_ptr<TriangleDetail>, std::shared_ptr<TriangleDetail>>> triangleDetails;
+
+        /// Palette before and after the change, only if it did change
+        std::optional<std::pair<ColorManager::Palette, ColorManager::Palette>> palette;
+
+        /// Add changes that were done after this diff
+        void join(GeometryDiff&& later);
+
+        /// Count the bytes used by this diff, details shared with states or other diffs are counted once
+        void countMemoryUsage(MemoryUsageCounter& counter) const;
+    };
+
+    using DiffType = GeometryDiff;
+
     /// A highlight of a part of the Geometry
     struct AreaHighlight {
-        // all the triangles in highlight
-        std::set<size_t> triangles;
+        /// All the triangles in highlight, sorted
+        std::vector<size_t> triangles;
+        /// Same triangles as a dense bitmap indexed by the triangle id
+        std::vector<bool> triangleMask;
+        /// Triangle hit by the highlight ray
+        size_t hitTriangle{};
         BrushSettings settings;
         ci::Ray ray;
         glm::vec3 origin{};
@@ -92,6 +127,10 @@ class Geometry {
             mutable bool didColorUpdate{false};
             mutable bool didHighlightUpdate{false};
 
+            /// Ranges of vertices [begin, end) whose highlight mask changed, valid when didHighlightUpdate is set.
+            /// Base triangles and details lie far apart in the buffers, so the ranges are not merged into one.
+            mutable std::vector<std::pair<size_t, size_t>> highlightUpdateRanges;
+
             void unsetColorFlag() const {
                 didColorUpdate = false;
             }
@@ -99,6 +138,22 @@ class Geometry {
             void unsetHighlightFlag() const {
                 didHighlightUpdate = false;
             }
+
+            void markHighlightUpdate(size_t begin, size_t end) const {
+                if(!didHighlightUpdate) {
+                    highlightUpdateRanges.clear();
+                }
+
+                // Extend the last range if the change touches it
+                if(!highlightUpdateRanges.empty() && begin <= highlightUpdateRanges.back().second &&
+                   end >= highlightUpdateRanges.back().first) {
+                    highlightUpdateRanges.back().first = std::min(highlightUpdateRanges.back().first, begin);
+                    highlightUpdateRanges.back().second = std::max(highlightUpdateRanges.back().second, end);
+                } else {
+                    highlightUpdateRanges.emplace_back(begin, end);
+                }
+                didHighlightUpdate = true;
+            }
         } info;
     };
 
@@ -112,11 +167,21 @@ class Geometry {
     std::vector<std::pair<Point3, double>> mTriangleBounds;
 
     /// Map of triangle details. (Detailed triangles that replace the original)
-    std::map<size_t, TriangleDetail> mTriangleDetails;
+    TriangleDetailMap mTriangleDetails;
 
     /// Map of baseTriangleId -> Index of first detail triangle color in mOgl.colorBuffer
     std::map<size_t, size_t> mTriangleDetailColorBufferStart;
 
+    /// Size of the grid painted shapes are snapped to, 0 for exact shapes. Only picked by the user and saved with the
+    /// project, the painting commands store the grid they were executed with.
+    double mPaintGridSize = 0.0;
+
+    /// Triangles covered by a painted shape are colored whole only when facing the shape at least this much
+    static constexpr float MIN_COVERED_TRIANGLE_FACING = 1e-3f;
+
+    /// Maximum number of rays interpolated between two rays of a stroke, see paintStrokeWithSphere()
+    static constexpr int MAX_STROKE_SUBDIVISIONS = 32;
+
     /// All open GL buffers
     OpenGlData mOgl;
 
@@ -140,6 +205,17 @@ class Geometry {
     /// Map converting a face_descriptor into an ID
     PolyhedronData::Mesh::Property_map<PolyhedronData::face_descriptor, DetailedTriangleId> mMeshDetailedIdMap;
 
+    /// Regions of the paint bucket for a single stopping condition, labelled by the faces of mMeshDetailed
+    struct BucketRegions {
+        BucketRegionKey key;
+        ComponentLabels labels;
+        /// Labels of regions with recolored triangles, they are labelled again before the next use
+        std::vector<size_t> recoloredLabels;
+    };
+
+    /// Cached regions of the paint bucket, see bucketRegion()
+    std::unique_ptr<BucketRegions> mBucketRegions;
+
     // ----- END of Detailed Mesh Data ------
 
     /// AABB of the whole mesh
@@ -154,18 +230,40 @@ class Geometry {
     /// Current progress of import, tree, polyhedron building, export, etc.
     std::unique_ptr<GeometryProgress> mProgress;
 
+    /// Diff that is being recorded between beginDiff() and endDiff()
+    std::unique_ptr<GeometryDiff> mRecordedDiff;
+
+    /// Saved state of the Geometry. Parts that did not change since the previous saved state are shared with it.
     struct GeometryState {
-        std::vector<size_t> triangleColors;
-        std::map<size_t, TriangleDetail> triangleDetails;
-        ColorManager::ColorMap colorMap;
+        std::shared_ptr<const CompactColorArray> triangleColors;
+        /// Shares the details with the Geometry, see TriangleDetailMap
+        std::shared_ptr<const TriangleDetailMap> triangleDetails;
+        ColorManager::Palette palette;
+
+        /// Count the bytes used by this state, colors and details shared with other states or diffs are counted once
+        void countMemoryUsage(MemoryUsageCounter& counter) const;
     };
 
+    /// Last saved parts of a state, to be shared with the next saved state when they do not change
+    mutable std::shared_ptr<const CompactColorArray> mLastSavedColors;
+    mutable std::shared_ptr<const TriangleDetailMap> mLastSavedDetails;
+
+    /// State being captured in the background by saveStateAsync(), owns a copy of the colors it compresses
+    mutable std::shared_future<GeometryState> mStateCapture;
+
+    /// Wait until the state capture finishes and keep its colors as the last saved ones, called before saving the next
+    /// state
+    void waitForStateCapture() const;
+
     friend class cereal::access;
 
    public:
     /// Empty constructor
     Geometry() : mTree(std::make_unique<Tree>()), mProgress(std::make_unique<GeometryProgress>()) {}
 
+    Geometry(Geometry&&) = default;
+    Geometry& operator=(Geometry&&) = default;
+
     Geometry(std::vector<DataTriangle>&& triangles)
         : mTriangles(std::move(triangles)), mProgress(std::make_unique<GeometryProgress>()) {
         generateVertexBuffer();
@@ -183,6 +281,18 @@ class Geometry {
         }
     }
 
+    /// Geometry with the polyhedron built, as after loadNewGeometry()
+    /// @param vertices Joined vertices of the triangles
+    /// @param indices Indices of the vertices of each triangle, in CCW order
+    Geometry(std::vector<DataTriangle>&& triangles, std::vector<glm::vec3>&& vertices,
+             std::vector<std::array<size_t, 3>>&& indices)
+        : Geometry(std::move(triangles)) {
+        mPolyhedronData.vertices = std::move(vertices);
+        mPolyhedronData.indices = std::move(indices);
+        buildPolyhedron();
+        computeNeighbourCosines();
+    }
+
     std::vector<glm::vec3>& getVertexBuffer() {
         return mOgl.vertexBuffer;
     }
@@ -270,7 +380,7 @@ class Geometry {
         if(detailId) {
             P_ASSERT(!isSimpleTriangle(baseId));
             P_ASSERT(*detailId < getTriangleDetailCount(baseId));
-            return mTriangleDetails.at(baseId).getTriangles()[*detailId];
+            return mTriangleDetails.at(baseId)->getTriangles()[*detailId];
         } else {
             return mTriangles[baseId];
         }
@@ -297,6 +407,14 @@ class Geometry {
         return mColorManager;
     }
 
+    /// Palette commands call this before changing the palette, so that the recorded diff remembers the palette before
+    /// the change. Does nothing when no diff is recorded.
+    void recordPalette() {
+        if(mRecordedDiff && !mRecordedDiff->palette) {
+            mRecordedDiff->palette.emplace(mColorManager.getPalette(), ColorManager::Palette());
+        }
+    }
+
     bool isSimpleTriangle(size_t triangleIdx) const {
         // Triangle is single color when it has no detail triangles
         auto it = mTriangleDetails.find(triangleIdx);
@@ -335,6 +453,9 @@ class Geometry {
     /// Set new triangle color.
     void setTriangleColor(const DetailedTriangleId triangleId, const size_t newColor);
 
+    /// Set the same color to all selected triangles, updating the colors and the color buffer in one parallel pass
+    void setTriangleColors(const TriangleSelection& selection, const size_t newColor);
+
     /// Intersects the mesh with the given ray and returns the index of the triangle intersected, if it exists.
     /// Example use: generate ray based on a mouse click, call this method, then call setTriangleColor.
     std::optional<size_t> intersectMesh(const ci::Ray& ray) const;
@@ -354,17 +475,59 @@ class Geometry {
     /// Paint area with a shaped brush
     /// @param ray Ray along which to project the shape, using orthogonal projection
     /// @param shape Points in world space representing a polygonal shape
+    /// @param gridSize Size of the grid the shape is snapped to, see getPaintGridSize()
     void paintWithShape(const ci::Ray& ray, const std::vector<Point3>& shape, size_t color,
-                        bool paintBackfaces = false);
+                        bool paintBackfaces = false, double gridSize = 0.0);
 
-    /// Paint area with a shaped brush
-    /// @param ray Ray along which to project the shape, using orthogonal projection
-    /// @param triangles Triangles in world space representing the shape
-    void paintWithShape(const ci::Ray& ray, const std::vector<DataTriangle::Triangle>& triangles, size_t color);
+    /// Paint several shapes at once, e.g. the letters of a text. Triangles are found in a single pass over the
+    /// model and each of them is painted only once, with the union of all shapes that reach it.
+    /// @param ray Ray along which to project the shapes, using orthogonal projection
+    /// @param shapes Outlines in world space representing each shape
+    /// @param gridSize Size of the grid the shapes are snapped to, see getPaintGridSize()
+    void paintWithShapes(const ci::Ray& ray, const std::vector<std::vector<TriangleDetail::PolygonOutline>>& shapes,
+                         size_t color, double gridSize = 0.0);
 
     /// Paint continuous spherical area with a brush of specified size
     void paintAreaWithSphere(const ci::Ray& ray, const BrushSettings& settings);
 
+    /// Hit of a brush stroke on the surface
+    struct StrokePoint {
+        glm::vec3 position;
+        glm::vec3 direction;
+        size_t triangle;
+        /// Is the point connected to the previous one by the swept sphere
+        bool connected;
+    };
+
+    /// Hits of the stroke rays on the surface, as painted by paintStrokeWithSphere(). Rays between two distant hits
+    /// are interpolated, so that the swept shape follows the surface.
+    std::vector<StrokePoint> getStrokePoints(const std::vector<ci::Ray>& rays, float brushSize) const;
+
+    /// Paint a stroke with a spherical brush. Consecutive hits of the rays are connected by the shape swept by the
+    /// sphere, each triangle detail is painted with a single polygon operation for the whole stroke.
+    /// @param rays Rays of the stroke in order, a ray that misses the mesh splits the stroke
+    void paintStrokeWithSphere(const std::vector<ci::Ray>& rays, const BrushSettings& settings);
+
+    /// Set the size of the grid painted shapes are snapped to, in model units. Details finer than the printer
+    /// resolution are pointless and make painting slower. 0 keeps the exact shapes. The tools pass it to the painting
+    /// commands, changing it does not affect the commands executed before.
+    void setPaintGridSize(double gridSize) {
+        P_ASSERT(gridSize >= 0.0);
+        mPaintGridSize = gridSize;
+    }
+
+    double getPaintGridSize() const {
+        return mPaintGridSize;
+    }
+
+    /// Compact exact coordinates of all triangle details painted since the last compaction, call at the end of a
+    /// stroke. See TriangleDetail::compactExactValues()
+    void compactTriangleDetails();
+
+    /// Change all color ID's using a lookup table, in one parallel pass over the triangles, details and color buffer
+    /// @param newColorIds new color ID for each original color ID
+    void remapColorIds(const std::vector<size_t>& newColorIds);
+
     /// Change all color ID's from one to another
     /// @param ColorFunc functor of type size_t func(size_t originalColor), that returns the new color ID
     template <typename ColorFunc>
@@ -379,15 +542,35 @@ class Geometry {
             }
         }
 
+        if(mBucketRegions && mBucketRegions->key.stopOnColor) {
+            mBucketRegions.reset();
+        }
         mOgl.isDirty = true;
     }
 
     /// Save current state into a struct so that it can be restored later (CommandManager target requirement)
     GeometryState saveState() const;
 
+    /// Save current state in the background (CommandManager async snapshot support)
+    /// Details, palette and triangle colors are captured immediately, the colors are compressed on a worker thread.
+    /// The capture does not read the Geometry, which can change or move meanwhile.
+    std::shared_future<GeometryState> saveStateAsync() const;
+
     /// Load previous state from a struct (CommandManager target requirement)
     void loadState(const GeometryState&);
 
+    /// Start recording all changes of triangle colors, details and palette (CommandManager diff support)
+    void beginDiff();
+
+    /// Stop recording and return the changes done since beginDiff() (CommandManager diff support)
+    GeometryDiff endDiff();
+
+    /// Return to the state before the diff (CommandManager diff support)
+    void revertDiff(const GeometryDiff& diff);
+
+    /// Return to the state after the diff (CommandManager diff support)
+    void applyDiff(const GeometryDiff& diff);
+
     /// Spreads as BFS, starting from startTriangle to wherever it can reach.
     /// Stopping is handled by the StoppingCondition functor/lambda.
     /// A vector of reached triangle indices is returned;
@@ -401,10 +584,53 @@ class Geometry {
     template <typename StoppingCondition>
     std::vector<size_t> bucket(const std::vector<size_t>& startTriangles, const StoppingCondition& stopFunctor);
 
+    /// Identifies the stopping condition of the cached bucket regions, see bucketRegion()
+    struct BucketRegionKey {
+        /// The condition compares colors of the triangles, so the regions change when triangles get recolored
+        bool stopOnColor = false;
+        bool stopOnNormal = false;
+        /// Cosine of the largest angle between neighbouring normals
+        double normalThreshold = 0.0;
+
+        bool operator==(const BucketRegionKey& other) const {
+            return stopOnColor == other.stopOnColor && stopOnNormal == other.stopOnNormal &&
+                   normalThreshold == other.normalThreshold;
+        }
+    };
+
+    using BucketCondition = std::function<bool(const DetailedTriangleId, const DetailedTriangleId)>;
+
+    /// Same as bucket(), but all regions of the detailed mesh are labelled once by a parallel union-find and reused
+    /// by the following calls with the same key. Recoloring triangles labels again only the regions containing them.
+    /// @param stopFunctor Must be symmetric and depend only on the two triangles and the key
+    std::vector<DetailedTriangleId> bucketRegion(const DetailedTriangleId startTriangle, const BucketRegionKey& key,
+                                                 const BucketCondition& stopFunctor);
+
+    /// Cosine of the angle between the normals of two neighbouring triangles, read from the table computed with the
+    /// polyhedron. Computed from the normals when the triangles do not share an edge.
+    double getNeighbourCosine(const size_t firstTriangle, const size_t secondTriangle) const;
+
+    /// Cosine of the angle between the normals of the triangle and its neighbour across the edge, NaN on borders
+    /// @param edge Index of the neighbour returned by gatherNeighbours()
+    double getEdgeCosine(const size_t triangle, const int edge) const {
+        P_ASSERT(3 * triangle + edge < mPolyhedronData.neighbourCosines.size());
+        return mPolyhedronData.neighbourCosines[3 * triangle + edge];
+    }
+
+    /// Pairs of neighbouring triangles whose normals are further apart than the angle with the cosine
+    std::vector<std::pair<size_t, size_t>> getSharpEdges(const double cosThreshold) const;
+
     /// Spread as BFS from starting triangle, until the limits of brush settings are reached
     std::vector<size_t> getTrianglesUnderBrush(const glm::vec3& originPoint, const glm::vec3& insideDirection,
                                                size_t startTriangle, const struct BrushSettings& settings);
 
+    /// Intersections of spheres with the edges of triangles, keyed by the triangle and the sphere index. Each mesh
+    /// edge is intersected with each sphere only once, so both triangles of an edge get exactly the same points.
+    /// @param triangleSpheres Pairs of a triangle and an index into spheres
+    /// @return Empty if the polyhedron is not valid, the details compute the intersections themselves
+    std::map<std::pair<size_t, size_t>, TriangleDetail::SphereEdgeIntersections> getSphereEdgeIntersections(
+        const std::vector<Sphere>& spheres, const std::vector<std::pair<size_t, size_t>>& triangleSpheres) const;
+
     /// Get all triangles that are closer to the object than radius
     /// This function operates on spherical bounds of triangles and may therefore return false positives
     /// @param object CGAL Object - point, line, etc
@@ -486,8 +712,29 @@ class Geometry {
         if(it == mTriangleDetails.end()) {
             return 0;
         } else {
-            return it->second.getTriangles().size();
+            return it->second->getTriangles().size();
+        }
+    }
+
+    /// Number of triangles that are replaced by a TriangleDetail
+    size_t getTriangleDetailsCount() const {
+        return mTriangleDetails.size();
+    }
+
+    /// Exclude the details used by the Geometry from the memory used by its saved states and diffs (CommandManager)
+    void excludeLiveMemory(MemoryUsageCounter& counter) const {
+        for(const auto& detailIt : mTriangleDetails) {
+            counter.exclude(detailIt.second.get());
+        }
+    }
+
+    /// Approximate number of bytes used by all triangle details, see TriangleDetail::getMemoryUsage()
+    size_t getTriangleDetailsMemoryUsage() const {
+        size_t result = 0;
+        for(const auto& detailIt : mTriangleDetails) {
+            result += detailIt.second->getMemoryUsage();
         }
+        return result;
     }
 
     const bool* sdfValuesValid() const {
@@ -512,12 +759,19 @@ class Geometry {
     /// Generate a buffer of highlight information. Saves per-triangle data to each vertex
     void generateHighlightBuffer();
 
+    /// Update the highlight mask of a single triangle and its detail in the highlight buffer
+    void updateHighlightBuffer(size_t triangleIdx);
+
     /// Generate spherical bounds for each original triangle. Used to speed up capsule querries.
     void generateTriangleBounds();
 
     /// Build the CGAL Polyhedron construct in mPolyhedronData. Takes a bit of time to rebuild.
     void buildPolyhedron();
 
+    /// Fill the tables of neighbours and cosines between their normals, in the thread pool. Called after
+    /// buildPolyhedron(), outside of its task.
+    void computeNeighbourCosines();
+
     /// Builds AABB tree over the original mesh
     void buildTree();
 
@@ -536,17 +790,60 @@ class Geometry {
 
     TriangleDetail* createTriangleDetail(size_t triangleIdx);
 
+    /// Get a detail that can be modified. Creates the detail if it does not exist yet and makes a private copy of it
+    /// if it is shared with a saved state.
     TriangleDetail* getTriangleDetail(const size_t triangleIndex) {
+        recordTriangleDetail(triangleIndex);
+
         auto it = mTriangleDetails.find(triangleIndex);
         if(it == mTriangleDetails.end()) {
             return createTriangleDetail(triangleIndex);
         } else {
-            return &(it->second);
+            if(it->second.use_count() > 1) {
+                it->second = std::make_shared<TriangleDetail>(*it->second);
+            }
+            return it->second.get();
+        }
+    }
+
+    /// Get a detail for reading only, never copies it. Returns nullptr for simple triangles.
+    const TriangleDetail* findTriangleDetail(const size_t triangleIndex) const {
+        auto it = mTriangleDetails.find(triangleIndex);
+        if(it == mTriangleDetails.end()) {
+            return nullptr;
+        } else {
+            return it->second.get();
         }
     }
 
     void removeTriangleDetail(size_t triangleIndex);
 
+    /// Replace details covered by a single color with simple triangles of that color, called after painting.
+    /// See TriangleDetail::getUniformColor()
+    void collapseUniformTriangleDetails(const std::vector<size_t>& triangleIndices);
+
+    /// Remember the current color of the triangle, if a diff is being recorded and it is not remembered already
+    void recordTriangleColor(size_t triangleIndex) {
+        if(mRecordedDiff) {
+            const size_t color = mTriangles[triangleIndex].getColor();
+            mRecordedDiff->triangleColors.emplace(triangleIndex, std::make_pair(color, color));
+        }
+    }
+
+    /// Remember the current detail of the triangle, if a diff is being recorded and it is not remembered already
+    /// Must be called before the detail is modified, this keeps the detail shared so that it gets copied on write.
+    void recordTriangleDetail(size_t triangleIndex) {
+        if(mRecordedDiff) {
+            auto it = mTriangleDetails.find(triangleIndex);
+            std::shared_ptr<TriangleDetail> detail = it == mTriangleDetails.end() ? nullptr : it->second;
+            mRecordedDiff->triangleDetails.emplace(triangleIndex, std::make_pair(std::move(detail), nullptr));
+        }
+    }
+
+    /// Load one side of the diff
+    /// @param after load the state after the diff, otherwise before it
+    void loadDiff(const GeometryDiff& diff, bool after);
+
     /// Used by BFS in bucket painting. Aggregates the neighbours of the triangle at triIndex by looking
     /// into the CGAL Polyhedron construct.
     std::array<int, 3> gatherNeighbours(const size_t triIndex) const;
@@ -555,6 +852,16 @@ class Geometry {
     /// into the CGAL Polyhedron construct.
     std::array<std::optional<DetailedTriangleId>, 3> gatherNeighbours(const DetailedTriangleId triIndex) const;
 
+    /// Indices of the faces of mMeshDetailed neighbouring the face
+    std::array<std::optional<size_t>, 3> gatherDetailedNeighbourFaces(const size_t faceIdx) const;
+
+    /// Unite the regions of the detailed mesh faces with the neighbours they can spread to, in the thread pool
+    /// @param allNeighbours Check neighbours in both directions, otherwise each edge is checked once
+    void uniteBucketRegions(const std::vector<size_t>& faces, bool allNeighbours, const BucketCondition& stopFunctor);
+
+    /// Label the cached bucket regions of the triangle again after it got recolored
+    void markBucketRegionRecolored(const DetailedTriangleId triangleId);
+
     /// Used by BFS in bucket painting. Manages the queue used to search through the graph.
     template <typename StoppingCondition>
     void addNeighboursToQueue(const size_t currentVertex, std::unordered_set<size_t>& alreadyVisited,
@@ -573,12 +880,14 @@ class Geometry {
                    std::unordered_map<size_t, size_t>& triangleToSegmentMap);
 
     /// Method to allow the Cereal library to serialize this class. Used for saving a .p3d project.
+    /// @param version Version of the project format, see CEREAL_CLASS_VERSION below
     template <class Archive>
-    void save(Archive& saveArchive) const;
+    void save(Archive& saveArchive, std::uint32_t version) const;
 
     /// Method to allow the Cereal library to deserialize this class. Used for loading a .p3d project.
+    /// @param version Version of the loaded project format, version 0 has no paint grid
     template <class Archive>
-    void load(Archive& loadArchive);
+    void load(Archive& loadArchive, std::uint32_t version);
 
     template <typename StoppingCondition>
     std::vector<size_t> bucketSpread(const StoppingCondition& stopFunctor, std::deque<size_t>& toVisit,
@@ -748,22 +1057,72 @@ void Geometry::addNeighboursToQueue(const DetailedTriangleId currentVertex,
 /* -------------------- Serialization -------------------- */
 
 template <class Archive>
-void Geometry::save(Archive& saveArchive) const {
-    saveArchive(mColorManager);
-    saveArchive(mTriangles);
-    saveArchive(mTriangleDetails);
+void Geometry::save(Archive& saveArchive, std::uint32_t version) const {
+    // The palette order is not saved, a reordered palette saves the color ids as positions in the palette instead
+    const bool isReordered = !mColorManager.isInIdOrder();
+    const std::vector<size_t> colorPositions = mColorManager.getColorPositions();
+    const auto toPosition = [&colorPositions](size_t colorId) { return colorPositions[colorId]; };
+
+    if(isReordered) {
+        saveArchive(mColorManager.getWithIdsInPaletteOrder());
+        std::vector<DataTriangle> triangles(mTriangles);
+        for(DataTriangle& triangle : triangles) {
+            triangle.setColor(toPosition(triangle.getColor()));
+        }
+        saveArchive(triangles);
+    } else {
+        saveArchive(mColorManager);
+        saveArchive(mTriangles);
+    }
+
+    // Keep the same format as std::map<size_t, TriangleDetail>
+    saveArchive(cereal::make_size_tag(static_cast<cereal::size_type>(mTriangleDetails.size())));
+    for(const auto& detailIt : mTriangleDetails) {
+        if(isReordered) {
+            TriangleDetail detail(*detailIt.second);
+            detail.changeColorIds(toPosition);
+            saveArchive(cereal::make_map_item(detailIt.first, detail));
+        } else {
+            saveArchive(cereal::make_map_item(detailIt.first, *detailIt.second));
+        }
+    }
+
     saveArchive(mPolyhedronData.vertices);
     saveArchive(mPolyhedronData.indices);
+
+    if(version >= 1) {
+        saveArchive(mPaintGridSize);
+    }
 }
 
 template <class Archive>
-void Geometry::load(Archive& loadArchive) {
+void Geometry::load(Archive& loadArchive, std::uint32_t version) {
     loadArchive(mColorManager);
     loadArchive(mTriangles);
-    loadArchive(mTriangleDetails);
+
+    cereal::size_type detailCount;
+    loadArchive(cereal::make_size_tag(detailCount));
+    mTriangleDetails.clear();
+    for(cereal::size_type i = 0; i < detailCount; ++i) {
+        size_t triangleIdx;
+        auto detail = std::make_shared<TriangleDetail>();
+        loadArchive(cereal::make_map_item(triangleIdx, *detail));
+        if(const std::optional<size_t> uniformColor = detail->getUniformColor()) {
+            // Projects saved by older versions may contain details painted over with a single color
+            mTriangles[triangleIdx].setColor(*uniformColor);
+            continue;
+        }
+        mTriangleDetails.emplace_hint(mTriangleDetails.end(), triangleIdx, std::move(detail));
+    }
+
     loadArchive(mPolyhedronData.vertices);
     loadArchive(mPolyhedronData.indices);
 
+    mPaintGridSize = 0.0;
+    if(version >= 1) {
+        loadArchive(mPaintGridSize);
+    }
+
     // Reset progress
     mProgress->resetLoad();
 
@@ -779,4 +1138,7 @@ void Geometry::load(Archive& loadArchive) {
     P_ASSERT(!mPolyhedronData.indices.empty());
 }
 
-}  // namespace pepr3d
\ No newline at end of file
+}  // namespace pepr3d
+
+/// Version of the .p3d project format, version 1 saves the paint grid size
+CEREAL_CLASS_VERSION(pepr3d::Geometry, 1);
\ No newline at end of file
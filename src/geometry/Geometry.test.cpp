@@ -1,7 +1,20 @@
 #ifdef _TEST_
 
 #include <gtest/gtest.h>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/array.hpp>
+#include <cereal/types/map.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <sstream>
 
+#include "commands/CmdColorManager.h"
+#include "commands/CmdPaintBrush.h"
+#include "commands/CmdPaintSingleColor.h"
+#include "commands/CommandManager.h"
 #include "geometry/Geometry.h"
 
 /// Return a simple testing geometry of a cube
@@ -107,4 +120,1028 @@ TEST(Geometry, setColor) {
         EXPECT_EQ(colorBuffer.at(i), colorIndex);
     }
 }
-#endif
\ No newline at end of file
+
+/// Paint a small square over the diagonal of the top face of the cube, creating details for both top triangles
+void paintSquareOnTop(pepr3d::Geometry& geo, size_t color) {
+    const ci::Ray ray(glm::vec3(0, 2, 0), glm::vec3(0, -1, 0));
+    const std::vector<pepr3d::Geometry::Point3> square = {
+        {-0.2, 1, -0.2}, {0.2, 1, -0.2}, {0.2, 1, 0.2}, {-0.2, 1, 0.2}};
+    geo.paintWithShape(ray, square, color);
+}
+
+TEST(Geometry, saveStateSharesDetails) {
+    /**
+     * Test that saved states share triangle details with the geometry and only modified details get copied
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    paintSquareOnTop(geo, 1);
+    ASSERT_FALSE(geo.isSimpleTriangle(0));
+    ASSERT_FALSE(geo.isSimpleTriangle(1));
+
+    const auto firstState = geo.saveState();
+    const auto secondState = geo.saveState();
+    // Nothing changed between the states, so all their data is shared
+    EXPECT_EQ(firstState.triangleDetails, secondState.triangleDetails);
+    EXPECT_EQ(firstState.triangleColors, secondState.triangleColors);
+    ASSERT_EQ(firstState.triangleColors->size(), geo.getTriangleCount());
+
+    const pepr3d::DetailedTriangleId firstDetailTri(0, 0);
+    const size_t originalColor = geo.getTriangleColor(firstDetailTri);
+    geo.setTriangleColor(firstDetailTri, 2);
+    EXPECT_EQ(geo.getTriangleColor(firstDetailTri), 2);
+
+    // Only the modified detail was copied, the saved state kept the original data
+    const auto thirdState = geo.saveState();
+    EXPECT_NE(firstState.triangleDetails->at(0).get(), thirdState.triangleDetails->at(0).get());
+    EXPECT_EQ(firstState.triangleDetails->at(1).get(), thirdState.triangleDetails->at(1).get());
+    EXPECT_EQ(firstState.triangleDetails->at(0)->getTriangles()[0].getColor(), originalColor);
+    EXPECT_NE(firstState.triangleDetails, thirdState.triangleDetails);
+
+    geo.loadState(firstState);
+    EXPECT_EQ(geo.getTriangleColor(firstDetailTri), originalColor);
+
+    geo.loadState(thirdState);
+    EXPECT_EQ(geo.getTriangleColor(firstDetailTri), 2);
+}
+
+TEST(Geometry, remapColorIdsCopiesChangedDetails) {
+    /**
+     * Test that remapping the color ids copies only the details shared with a saved state whose colors change
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    paintSquareOnTop(geo, 1);
+    const pepr3d::DetailedTriangleId firstDetailTri(0, 0);
+    geo.setTriangleColor(firstDetailTri, 2);
+    const auto state = geo.saveState();
+
+    // Swap the ids of the third and the fourth color, only the first detail uses them
+    std::vector<size_t> newColorIds(geo.getColorManager().size());
+    std::iota(newColorIds.begin(), newColorIds.end(), 0);
+    ASSERT_GT(newColorIds.size(), 3u);
+    std::swap(newColorIds[2], newColorIds[3]);
+    geo.remapColorIds(newColorIds);
+    EXPECT_EQ(geo.getTriangleColor(firstDetailTri), 3);
+    EXPECT_EQ(state.triangleDetails->at(0)->getTriangles()[0].getColor(), 2);
+
+    const auto remappedState = geo.saveState();
+    EXPECT_NE(remappedState.triangleDetails->at(0).get(), state.triangleDetails->at(0).get());
+    EXPECT_EQ(remappedState.triangleDetails->at(1).get(), state.triangleDetails->at(1).get());
+}
+
+TEST(Geometry, compactionCopiesSharedDetails) {
+    /**
+     * Test that compacting the details does not modify the details shared with a saved state
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    paintSquareOnTop(geo, 1);
+    const auto state = geo.saveState();
+    const pepr3d::TriangleDetail* savedDetail = state.triangleDetails->at(0).get();
+    ASSERT_TRUE(savedDetail->hasUncompactedOperations());
+
+    geo.compactTriangleDetails();
+    EXPECT_TRUE(savedDetail->hasUncompactedOperations());
+    EXPECT_EQ(state.triangleDetails->at(0).get(), savedDetail);
+
+    const auto compactedState = geo.saveState();
+    EXPECT_NE(compactedState.triangleDetails->at(0).get(), savedDetail);
+    EXPECT_FALSE(compactedState.triangleDetails->at(0)->hasUncompactedOperations());
+}
+
+TEST(Geometry, saveStateAsyncMatchesSaveState) {
+    /**
+     * Test that a state captured in the background holds the data from the time it was requested
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    paintSquareOnTop(geo, 1);
+    geo.setTriangleColor(5, 3);
+
+    const auto syncState = geo.saveState();
+    const auto asyncState = geo.saveStateAsync();
+
+    // Changing colors right away must not leak into the captured state
+    for(size_t triIdx = 0; triIdx < geo.getTriangleCount(); ++triIdx) {
+        geo.setTriangleColor(triIdx, 2);
+    }
+
+    const auto& capturedState = asyncState.get();
+    EXPECT_EQ(*capturedState.triangleColors, *syncState.triangleColors);
+    EXPECT_EQ(*capturedState.triangleDetails, *syncState.triangleDetails);
+    EXPECT_EQ(capturedState.palette, syncState.palette);
+
+    geo.loadState(capturedState);
+    EXPECT_EQ(geo.getTriangleColor(5), 3);
+    EXPECT_FALSE(geo.isSimpleTriangle(0));
+
+    // The capture owns its data, the Geometry can be moved while it runs. Unchanged colors are shared.
+    const auto movedState = geo.saveStateAsync();
+    pepr3d::Geometry movedGeo(std::move(geo));
+    EXPECT_EQ(movedState.get().triangleColors->size(), movedGeo.getTriangleCount());
+    EXPECT_EQ(movedState.get().triangleColors, capturedState.triangleColors);
+}
+
+/// Expect that both geometries have the same colors, details and palette
+void expectSameGeometry(const pepr3d::Geometry& first, const pepr3d::Geometry& second) {
+    ASSERT_EQ(first.getTriangleCount(), second.getTriangleCount());
+    EXPECT_EQ(first.getColorManager().getPalette(), second.getColorManager().getPalette());
+
+    for(size_t triIdx = 0; triIdx < first.getTriangleCount(); ++triIdx) {
+        ASSERT_EQ(first.isSimpleTriangle(triIdx), second.isSimpleTriangle(triIdx));
+        if(first.isSimpleTriangle(triIdx)) {
+            EXPECT_EQ(first.getTriangleColor(triIdx), second.getTriangleColor(triIdx));
+            continue;
+        }
+
+        ASSERT_EQ(first.getTriangleDetailCount(triIdx), second.getTriangleDetailCount(triIdx));
+        for(size_t detailIdx = 0; detailIdx < first.getTriangleDetailCount(triIdx); ++detailIdx) {
+            const pepr3d::DetailedTriangleId id(triIdx, detailIdx);
+            EXPECT_EQ(first.getTriangleColor(id), second.getTriangleColor(id));
+            for(int i = 0; i < 3; ++i) {
+                EXPECT_EQ(first.getTriangle(id).getVertex(i), second.getTriangle(id).getVertex(i));
+            }
+        }
+    }
+}
+
+TEST(Geometry, setTriangleColorsMatchesSingleCalls) {
+    /**
+     * Test that coloring a selection at once gives the same result as coloring the triangles one by one
+     */
+
+    pepr3d::Geometry bulkGeo(getGeometryWithCube());
+    pepr3d::Geometry singleGeo(getGeometryWithCube());
+    paintSquareOnTop(bulkGeo, 1);
+    paintSquareOnTop(singleGeo, 1);
+    ASSERT_GT(bulkGeo.getTriangleDetailCount(0), 1);
+
+    // Detailed triangles of the first top triangle, a whole painted detail and some repeated base triangles
+    std::vector<pepr3d::DetailedTriangleId> triangleIds = {pepr3d::DetailedTriangleId(0, 1),
+                                                           pepr3d::DetailedTriangleId(0, 0),
+                                                           pepr3d::DetailedTriangleId(1, 0),
+                                                           pepr3d::DetailedTriangleId(1),
+                                                           pepr3d::DetailedTriangleId(5),
+                                                           pepr3d::DetailedTriangleId(4),
+                                                           pepr3d::DetailedTriangleId(5),
+                                                           pepr3d::DetailedTriangleId(7)};
+    const pepr3d::TriangleSelection selection(triangleIds);
+    EXPECT_EQ(selection.size(), 6);
+
+    bulkGeo.setTriangleColors(selection, 3);
+    selection.forEach([&singleGeo](pepr3d::DetailedTriangleId id) { singleGeo.setTriangleColor(id, 3); });
+
+    EXPECT_EQ(bulkGeo.getTriangleColor(pepr3d::DetailedTriangleId(0, 0)), 3);
+    EXPECT_EQ(bulkGeo.getTriangleColor(pepr3d::DetailedTriangleId(0, 1)), 3);
+    EXPECT_TRUE(bulkGeo.isSimpleTriangle(1));
+    EXPECT_EQ(bulkGeo.getTriangleColor(1), 3);
+    EXPECT_EQ(bulkGeo.getTriangleColor(6), 0);
+    expectSameGeometry(bulkGeo, singleGeo);
+}
+
+TEST(Geometry, paintWithShapeFastPaths) {
+    /**
+     * Test that shapes covering whole triangles paint them without details and missed triangles stay untouched
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    paintSquareOnTop(geo, 1);
+    ASSERT_FALSE(geo.isSimpleTriangle(0));
+    ASSERT_FALSE(geo.isSimpleTriangle(1));
+
+    // Side triangles are parallel to the projection, no details get created for them
+    for(size_t triIdx = 2; triIdx < geo.getTriangleCount(); ++triIdx) {
+        EXPECT_TRUE(geo.isSimpleTriangle(triIdx));
+    }
+
+    // Shape larger than the top face collapses its details into simple triangles
+    const ci::Ray ray(glm::vec3(0, 2, 0), glm::vec3(0, -1, 0));
+    const std::vector<pepr3d::Geometry::Point3> largeSquare = {
+        {-0.6, 1, -0.6}, {0.6, 1, -0.6}, {0.6, 1, 0.6}, {-0.6, 1, 0.6}};
+    geo.paintWithShape(ray, largeSquare, 2);
+    EXPECT_TRUE(geo.isSimpleTriangle(0));
+    EXPECT_TRUE(geo.isSimpleTriangle(1));
+    EXPECT_EQ(geo.getTriangleColor(0), 2u);
+    EXPECT_EQ(geo.getTriangleColor(1), 2u);
+
+    // Shape next to the cube does not change anything
+    const std::vector<pepr3d::Geometry::Point3> missingSquare = {
+        {0.7, 1, -0.2}, {0.9, 1, -0.2}, {0.9, 1, 0.2}, {0.7, 1, 0.2}};
+    const ci::Ray missingRay(glm::vec3(0.8, 2, 0), glm::vec3(0, -1, 0));
+    geo.paintWithShape(missingRay, missingSquare, 3);
+    for(size_t triIdx = 0; triIdx < geo.getTriangleCount(); ++triIdx) {
+        EXPECT_TRUE(geo.isSimpleTriangle(triIdx));
+        EXPECT_NE(geo.getTriangleColor(triIdx), 3u);
+    }
+}
+
+/// Size of the geometry saved as a project
+size_t getSavedSize(const pepr3d::Geometry& geo) {
+    std::stringstream stream;
+    {
+        cereal::BinaryOutputArchive saveArchive(stream);
+        saveArchive(geo);
+    }
+    return stream.str().size();
+}
+
+TEST(Geometry, uniformDetailsCollapse) {
+    /**
+     * Test that details painted over with a single color turn back into simple triangles
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    geo.updateOpenGlBuffers();
+    const size_t simpleBufferSize = geo.getVertexBuffer().size();
+    const size_t simpleSavedSize = getSavedSize(geo);
+
+    paintSquareOnTop(geo, 1);
+    ASSERT_FALSE(geo.isSimpleTriangle(0));
+    ASSERT_FALSE(geo.isSimpleTriangle(1));
+    geo.updateOpenGlBuffers();
+    EXPECT_GT(geo.getVertexBuffer().size(), simpleBufferSize);
+    EXPECT_GT(getSavedSize(geo), simpleSavedSize);
+
+    // Painting the square again with the original color leaves a single color in both details
+    paintSquareOnTop(geo, 0);
+    EXPECT_TRUE(geo.isSimpleTriangle(0));
+    EXPECT_TRUE(geo.isSimpleTriangle(1));
+    EXPECT_EQ(geo.getTriangleColor(0), 0u);
+    EXPECT_EQ(geo.getTriangleColor(1), 0u);
+
+    geo.updateOpenGlBuffers();
+    EXPECT_EQ(geo.getVertexBuffer().size(), simpleBufferSize);
+    EXPECT_EQ(geo.getOpenGlData().colorBuffer.size(), simpleBufferSize);
+    EXPECT_EQ(getSavedSize(geo), simpleSavedSize);
+}
+
+TEST(Geometry, loadCollapsesUniformDetails) {
+    /**
+     * Test that loading a project replaces details with a single color by simple triangles
+     */
+
+    const pepr3d::Geometry geo(getGeometryWithCube());
+    std::vector<pepr3d::DataTriangle> triangles;
+    std::vector<glm::vec3> vertices;
+    std::vector<std::array<size_t, 3>> indices;
+    for(size_t triIdx = 0; triIdx < geo.getTriangleCount(); ++triIdx) {
+        triangles.push_back(geo.getTriangle(triIdx));
+        indices.push_back({vertices.size(), vertices.size() + 1, vertices.size() + 2});
+        for(int i = 0; i < 3; ++i) {
+            vertices.push_back(triangles.back().getVertex(i));
+        }
+    }
+
+    // Project with a detail of a single color, as saved before the details were collapsed. Version 0 of the format
+    // has no paint grid.
+    pepr3d::DataTriangle paintedTriangle = triangles[3];
+    paintedTriangle.setColor(2);
+    std::map<size_t, pepr3d::TriangleDetail> details;
+    details.emplace(3, pepr3d::TriangleDetail(paintedTriangle));
+
+    std::stringstream stream;
+    {
+        cereal::BinaryOutputArchive saveArchive(stream);
+        saveArchive(std::uint32_t(0), geo.getColorManager(), triangles, details, vertices, indices);
+    }
+    const size_t projectSize = stream.str().size();
+
+    pepr3d::Geometry loaded;
+    {
+        cereal::BinaryInputArchive loadArchive(stream);
+        loadArchive(loaded);
+    }
+
+    EXPECT_TRUE(loaded.isSimpleTriangle(3));
+    EXPECT_EQ(loaded.getTriangleColor(3), 2u);
+    EXPECT_EQ(loaded.getTriangleColor(2), 0u);
+    EXPECT_EQ(loaded.getPaintGridSize(), 0.0);
+    EXPECT_LT(getSavedSize(loaded), projectSize);
+}
+
+TEST(Geometry, paintGridSizeSavedWithProject) {
+    /**
+     * Test that the paint grid size is saved with the project and restored when it is loaded
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    geo.setPaintGridSize(0.125);
+
+    std::stringstream stream;
+    {
+        cereal::BinaryOutputArchive saveArchive(stream);
+        saveArchive(geo);
+    }
+
+    pepr3d::Geometry loaded;
+    {
+        cereal::BinaryInputArchive loadArchive(stream);
+        loadArchive(loaded);
+    }
+    EXPECT_EQ(loaded.getPaintGridSize(), 0.125);
+    EXPECT_EQ(loaded.getTriangleCount(), geo.getTriangleCount());
+}
+
+TEST(Geometry, diffUndoMatchesReplay) {
+    /**
+     * Test that undoing commands through recorded diffs gives the same geometry as replaying the commands
+     */
+
+    pepr3d::BrushSettings brush;
+    brush.spherical = false;
+    brush.size = 0.2f;
+    const glm::vec3 down(0, -1, 0);
+
+    std::vector<std::function<std::unique_ptr<pepr3d::CommandBase<pepr3d::Geometry>>()>> commands = {
+        [&]() {
+            brush.color = 1;
+            return std::make_unique<pepr3d::CmdPaintBrush>(ci::Ray(glm::vec3(0, 2, 0), down), brush);
+        },
+        []() { return std::make_unique<pepr3d::CmdPaintSingleColor>(4, 2); },
+        []() { return std::make_unique<pepr3d::CmdColorManagerChangeColor>(0, glm::vec4(0.5f, 0.5f, 0.5f, 1.f)); },
+        [&]() {
+            brush.color = 2;
+            return std::make_unique<pepr3d::CmdPaintBrush>(ci::Ray(glm::vec3(0.2f, 2, 0.1f), down), brush);
+        },
+        []() { return std::make_unique<pepr3d::CmdPaintSingleColor>(pepr3d::DetailedTriangleId(1, 0), 3); },
+        []() { return std::make_unique<pepr3d::CmdColorManagerReorderColors>(1, 2); },
+        []() { return std::make_unique<pepr3d::CmdPaintSingleColor>(0, 1); },
+        []() { return std::make_unique<pepr3d::CmdColorManagerSwapColors>(0, 3); },
+        []() { return std::make_unique<pepr3d::CmdColorManagerRemoveColor>(1); },
+        []() { return std::make_unique<pepr3d::CmdPaintSingleColor>(6, 2); },
+    };
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    pepr3d::CommandManager<pepr3d::Geometry> commandManager(geo);
+    for(const auto& command : commands) {
+        commandManager.execute(command());
+    }
+
+    // Undo one command at a time and compare with a geometry that got there by running the commands directly
+    for(size_t executedCount = commands.size(); executedCount-- > 0;) {
+        ASSERT_TRUE(commandManager.canUndo());
+        commandManager.undo();
+
+        pepr3d::Geometry replayed(getGeometryWithCube());
+        pepr3d::CommandManager<pepr3d::Geometry> replayManager(replayed);
+        for(size_t i = 0; i < executedCount; ++i) {
+            replayManager.execute(commands[i]());
+        }
+
+        expectSameGeometry(geo, replayed);
+    }
+
+    // Redo everything and compare with the full replay
+    while(commandManager.canRedo()) {
+        commandManager.redo();
+    }
+
+    pepr3d::Geometry replayed(getGeometryWithCube());
+    pepr3d::CommandManager<pepr3d::Geometry> replayManager(replayed);
+    for(const auto& command : commands) {
+        replayManager.execute(command());
+    }
+    expectSameGeometry(geo, replayed);
+}
+
+TEST(Geometry, diffRecordsPaletteOnlyWhenChanged) {
+    /**
+     * Test that only changes of the palette store it in the diff
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+
+    geo.beginDiff();
+    geo.setTriangleColor(4, 2);
+    const pepr3d::Geometry::GeometryDiff paintDiff = geo.endDiff();
+    EXPECT_FALSE(paintDiff.palette);
+    EXPECT_EQ(paintDiff.triangleColors.size(), 1u);
+
+    geo.beginDiff();
+    geo.getColorManager().getActiveColorIndex();
+    const pepr3d::Geometry::GeometryDiff readDiff = geo.endDiff();
+    EXPECT_FALSE(readDiff.palette);
+
+    geo.beginDiff();
+    geo.recordPalette();
+    geo.getColorManager().setColor(0, glm::vec4(0.5f, 0.5f, 0.5f, 1.f));
+    const pepr3d::Geometry::GeometryDiff paletteDiff = geo.endDiff();
+    ASSERT_TRUE(paletteDiff.palette);
+    EXPECT_EQ(paletteDiff.palette->second, geo.getColorManager().getPalette());
+}
+
+/// Area of all triangles of the color, detailed triangles included
+double getColorArea(const pepr3d::Geometry& geo, size_t color) {
+    double area = 0.0;
+    for(size_t baseIdx = 0; baseIdx < geo.getTriangleCount(); ++baseIdx) {
+        const size_t detailCount = geo.getTriangleDetailCount(baseIdx);
+        std::vector<pepr3d::DetailedTriangleId> triangleIds;
+        if(detailCount == 0) {
+            triangleIds.emplace_back(baseIdx);
+        }
+        for(size_t detailIdx = 0; detailIdx < detailCount; ++detailIdx) {
+            triangleIds.emplace_back(baseIdx, detailIdx);
+        }
+
+        for(const pepr3d::DetailedTriangleId& triangleId : triangleIds) {
+            if(geo.getTriangleColor(triangleId) == color) {
+                area += std::sqrt(geo.getTriangle(triangleId).getTri().squared_area());
+            }
+        }
+    }
+    return area;
+}
+
+TEST(Geometry, paintStrokeMatchesDabs) {
+    /**
+     * Test that a stroke painted with the swept sphere covers the dabs of its rays and only fills the gaps between
+     * them
+     */
+
+    pepr3d::BrushSettings brush;
+    brush.color = 1;
+    brush.size = 0.1f;
+    brush.segments = 24;
+
+    std::vector<ci::Ray> rays;
+    for(float x = -0.3f; x <= 0.31f; x += 0.1f) {
+        rays.emplace_back(glm::vec3(x, 2, 0.05f), glm::vec3(0, -1, 0));
+    }
+
+    pepr3d::Geometry dabGeo(getGeometryWithCube());
+    const auto dabStart = std::chrono::high_resolution_clock::now();
+    for(const ci::Ray& ray : rays) {
+        dabGeo.paintAreaWithSphere(ray, brush);
+    }
+    const auto dabEnd = std::chrono::high_resolution_clock::now();
+
+    pepr3d::Geometry strokeGeo(getGeometryWithCube());
+    const auto strokeStart = std::chrono::high_resolution_clock::now();
+    strokeGeo.paintStrokeWithSphere(rays, brush);
+    const auto strokeEnd = std::chrono::high_resolution_clock::now();
+
+    RecordProperty("DabsMs", std::to_string(std::chrono::duration<double, std::milli>(dabEnd - dabStart).count()));
+    RecordProperty("StrokeMs",
+                   std::to_string(std::chrono::duration<double, std::milli>(strokeEnd - strokeStart).count()));
+
+    // The gaps between dabs are a few percent of the painted area
+    const double dabArea = getColorArea(dabGeo, 1);
+    const double strokeArea = getColorArea(strokeGeo, 1);
+    ASSERT_GT(dabArea, 0.0);
+    EXPECT_GE(strokeArea, dabArea * 0.999);
+    EXPECT_LE(strokeArea, dabArea * 1.05);
+
+    // Side faces are not reached by the brush
+    for(size_t triIdx = 2; triIdx < strokeGeo.getTriangleCount(); ++triIdx) {
+        EXPECT_TRUE(strokeGeo.isSimpleTriangle(triIdx));
+        EXPECT_EQ(strokeGeo.getTriangleColor(triIdx), 0u);
+    }
+}
+
+/// Sorted vertices of the detailed triangles of the base triangle that lie on the segment
+std::vector<pepr3d::Geometry::Point3> getDetailVerticesOnSegment(const pepr3d::Geometry& geo, size_t baseIdx,
+                                                                 const pepr3d::DataTriangle::K::Segment_3& segment) {
+    std::vector<pepr3d::Geometry::Point3> result;
+    for(size_t detailIdx = 0; detailIdx < geo.getTriangleDetailCount(baseIdx); ++detailIdx) {
+        const auto& tri = geo.getTriangle(pepr3d::DetailedTriangleId(baseIdx, detailIdx)).getTri();
+        for(int i = 0; i < 3; ++i) {
+            if(segment.has_on(tri.vertex(i))) {
+                result.push_back(tri.vertex(i));
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+TEST(Geometry, sphereEdgeIntersectionsAreShared) {
+    /**
+     * Test that the details on both sides of an edge crossed by the brush get exactly the same vertices on the edge
+     */
+
+    pepr3d::BrushSettings brush;
+    brush.color = 1;
+    brush.size = 0.2f;
+
+    // Diagonal shared by the two triangles of the top face
+    const pepr3d::DataTriangle::K::Segment_3 diagonal(pepr3d::Geometry::Point3(0.5, 0.5, -0.5),
+                                                      pepr3d::Geometry::Point3(-0.5, 0.5, 0.5));
+
+    pepr3d::Geometry dabGeo(getGeometryWithCube());
+    dabGeo.paintAreaWithSphere(ci::Ray(glm::vec3(0.05f, 2, 0.02f), glm::vec3(0, -1, 0)), brush);
+
+    pepr3d::Geometry strokeGeo(getGeometryWithCube());
+    strokeGeo.paintStrokeWithSphere({ci::Ray(glm::vec3(-0.2f, 2, -0.1f), glm::vec3(0, -1, 0)),
+                                     ci::Ray(glm::vec3(0.2f, 2, 0.1f), glm::vec3(0, -1, 0))},
+                                    brush);
+
+    for(const pepr3d::Geometry* geo : {&dabGeo, &strokeGeo}) {
+        ASSERT_FALSE(geo->isSimpleTriangle(0));
+        ASSERT_FALSE(geo->isSimpleTriangle(1));
+
+        // Both ends of the diagonal and at least the two points where the brush crosses it
+        const auto firstVertices = getDetailVerticesOnSegment(*geo, 0, diagonal);
+        EXPECT_GE(firstVertices.size(), 4u);
+        EXPECT_EQ(firstVertices, getDetailVerticesOnSegment(*geo, 1, diagonal));
+    }
+}
+
+TEST(Geometry, strokeEdgeIntersectionsAreShared) {
+    /**
+     * Test that a stroke over an edge between two faces gives both details the same vertices on the edge
+     */
+
+    pepr3d::BrushSettings brush;
+    brush.color = 1;
+    brush.size = 0.2f;
+
+    // Edge between the top and the front face, the stroke goes from one face to the other
+    const pepr3d::DataTriangle::K::Segment_3 edge(pepr3d::Geometry::Point3(0.5, 0.5, -0.5),
+                                                  pepr3d::Geometry::Point3(0.5, 0.5, 0.5));
+    const glm::vec3 direction = glm::normalize(glm::vec3(-1, -1, 0));
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    geo.paintStrokeWithSphere(
+        {ci::Ray(glm::vec3(1.9f, 2, -0.1f), direction), ci::Ray(glm::vec3(2, 1.9f, 0.1f), direction)}, brush);
+
+    ASSERT_FALSE(geo.isSimpleTriangle(1));
+    ASSERT_FALSE(geo.isSimpleTriangle(5));
+
+    // Both ends of the edge and at least the two points where the brush crosses it
+    const auto topVertices = getDetailVerticesOnSegment(geo, 1, edge);
+    EXPECT_GE(topVertices.size(), 4u);
+    EXPECT_EQ(topVertices, getDetailVerticesOnSegment(geo, 5, edge));
+}
+
+TEST(Geometry, incrementalHighlightMatchesRegeneration) {
+    /**
+     * Test that the highlight buffer patched while hovering over the model matches the buffer generated from scratch
+     */
+
+    pepr3d::BrushSettings brush;
+    brush.color = 1;
+    brush.size = 0.3f;
+    brush.continuous = true;
+
+    const auto getPaintedCube = [paintBrush = brush]() {
+        pepr3d::Geometry geo(getGeometryWithCube());
+        geo.paintAreaWithSphere(ci::Ray(glm::vec3(0.1f, 2, 0.1f), glm::vec3(0, -1, 0)), paintBrush);
+        geo.updateOpenGlBuffers();
+        return geo;
+    };
+
+    pepr3d::Geometry geo = getPaintedCube();
+    for(int step = 0; step < 12; ++step) {
+        const float offset = -0.45f + 0.08f * step;
+        const ci::Ray ray(glm::vec3(offset, 2, 0.4f), glm::vec3(0, -1, 0));
+
+        // Toggling the continuous setting changes the whole buffer
+        brush.continuous = (step != 5);
+
+        geo.getOpenGlData().info.unsetHighlightFlag();
+        geo.highlightArea(ray, brush);
+        ASSERT_TRUE(geo.getAreaHighlight().enabled);
+
+        pepr3d::Geometry freshGeo = getPaintedCube();
+        freshGeo.highlightArea(ray, brush);
+        EXPECT_EQ(geo.getOpenGlData().highlightMask, freshGeo.getOpenGlData().highlightMask);
+        EXPECT_EQ(geo.getAreaHighlight().triangles, freshGeo.getAreaHighlight().triangles);
+
+        // Changes of base triangles and of details are uploaded separately, except when the whole mask is
+        const size_t baseVertexCount = 3 * geo.getTriangleCount();
+        const auto& ranges = geo.getOpenGlData().info.highlightUpdateRanges;
+        const size_t maskSize = geo.getOpenGlData().highlightMask.size();
+        if(std::none_of(ranges.begin(), ranges.end(),
+                        [maskSize](const auto& range) { return range.first == 0 && range.second == maskSize; })) {
+            for(const auto& range : ranges) {
+                EXPECT_TRUE(range.second <= baseVertexCount || range.first >= baseVertexCount);
+            }
+        }
+
+        // Hovering the same point again changes nothing
+        geo.getOpenGlData().info.unsetHighlightFlag();
+        geo.highlightArea(ray, brush);
+        EXPECT_FALSE(geo.getOpenGlData().info.didHighlightUpdate);
+    }
+}
+
+TEST(Geometry, paletteReorderKeepsColors) {
+    /**
+     * Test that reordering and removing palette colors keeps the look of the model, also after saving
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    pepr3d::CommandManager<pepr3d::Geometry> commandManager(geo);
+    paintSquareOnTop(geo, 1);
+    geo.setTriangleColor(5, 2);
+    geo.setTriangleColor(6, 3);
+
+    /// Colors of all triangles, as shown on the screen
+    const auto getShownColors = [](const pepr3d::Geometry& geometry) {
+        std::vector<glm::vec4> colors;
+        for(size_t triIdx = 0; triIdx < geometry.getTriangleCount(); ++triIdx) {
+            if(geometry.isSimpleTriangle(triIdx)) {
+                colors.push_back(geometry.getColorManager().getColor(geometry.getTriangleColor(triIdx)));
+                continue;
+            }
+            for(size_t detailIdx = 0; detailIdx < geometry.getTriangleDetailCount(triIdx); ++detailIdx) {
+                const pepr3d::DetailedTriangleId triangleId(triIdx, detailIdx);
+                colors.push_back(geometry.getColorManager().getColor(geometry.getTriangleColor(triangleId)));
+            }
+        }
+        return colors;
+    };
+    const std::vector<glm::vec4> originalColors = getShownColors(geo);
+    const pepr3d::ColorManager::ColorMap originalPalette = geo.getColorManager().getColorMap();
+
+    // Reordering keeps the color ids in the model
+    commandManager.execute(std::make_unique<pepr3d::CmdColorManagerReorderColors>(0, 3));
+    commandManager.execute(std::make_unique<pepr3d::CmdColorManagerReorderColors>(1, 3));
+    EXPECT_EQ(geo.getTriangleColor(5), 2);
+    EXPECT_EQ(getShownColors(geo), originalColors);
+    EXPECT_EQ(geo.getColorManager().getColor(geo.getColorManager().getColorId(0)), originalPalette[3]);
+    EXPECT_EQ(geo.getColorManager().getColor(geo.getColorManager().getColorId(1)), originalPalette[0]);
+
+    // Saved colors are in the palette order, so a loaded model looks the same
+    std::stringstream stream;
+    {
+        cereal::BinaryOutputArchive saveArchive(stream);
+        saveArchive(geo);
+    }
+    {
+        cereal::BinaryInputArchive loadArchive(stream);
+        std::uint32_t version;
+        pepr3d::ColorManager savedColorManager;
+        std::vector<pepr3d::DataTriangle> savedTriangles;
+        loadArchive(version, savedColorManager, savedTriangles);
+        ASSERT_EQ(savedColorManager.size(), geo.getColorManager().size());
+        for(size_t position = 0; position < savedColorManager.size(); ++position) {
+            EXPECT_EQ(savedColorManager.getColorId(position), position);
+            EXPECT_EQ(savedColorManager.getColor(position),
+                      geo.getColorManager().getColor(geo.getColorManager().getColorId(position)));
+        }
+        ASSERT_EQ(savedTriangles.size(), geo.getTriangleCount());
+        for(size_t triIdx = 0; triIdx < geo.getTriangleCount(); ++triIdx) {
+            if(geo.isSimpleTriangle(triIdx)) {
+                EXPECT_EQ(savedColorManager.getColor(savedTriangles[triIdx].getColor()),
+                          geo.getColorManager().getColor(geo.getTriangleColor(triIdx)));
+            }
+        }
+    }
+
+    // Removing a color replaces it with the first color of the palette
+    const size_t removedId = geo.getColorManager().getColorId(2);
+    const glm::vec4 firstColor = geo.getColorManager().getColor(geo.getColorManager().getColorId(0));
+    commandManager.execute(std::make_unique<pepr3d::CmdColorManagerRemoveColor>(2));
+    EXPECT_EQ(geo.getColorManager().size(), 3);
+    const std::vector<glm::vec4> removedColors = getShownColors(geo);
+    ASSERT_EQ(removedColors.size(), originalColors.size());
+    for(size_t i = 0; i < originalColors.size(); ++i) {
+        if(originalColors[i] == originalPalette[removedId]) {
+            EXPECT_EQ(removedColors[i], firstColor);
+        } else {
+            EXPECT_EQ(removedColors[i], originalColors[i]);
+        }
+    }
+
+    // Undo restores the original palette and model
+    while(commandManager.canUndo()) {
+        commandManager.undo();
+    }
+    EXPECT_EQ(geo.getColorManager().getColorMap(), originalPalette);
+    EXPECT_TRUE(geo.getColorManager().isInIdOrder());
+    EXPECT_EQ(getShownColors(geo), originalColors);
+}
+
+/// Return a testing geometry of a grid of size x size quads with the polyhedron built. The grid is folded into sharp
+/// ridges every 8 quads and colored by diagonal stripes.
+pepr3d::Geometry getGeometryWithGrid(size_t size) {
+    const auto getHeight = [](size_t x) { return 0.5f * static_cast<float>(x % 16 < 8 ? x % 16 : 16 - x % 16); };
+
+    std::vector<glm::vec3> vertices;
+    for(size_t x = 0; x <= size; ++x) {
+        for(size_t z = 0; z <= size; ++z) {
+            vertices.emplace_back(static_cast<float>(x), getHeight(x), static_cast<float>(z));
+        }
+    }
+    const auto vertexIdx = [size](size_t x, size_t z) { return x * (size + 1) + z; };
+
+    std::vector<pepr3d::DataTriangle> triangles;
+    std::vector<std::array<size_t, 3>> indices;
+    const auto addTriangle = [&](size_t a, size_t b, size_t c, size_t color) {
+        const glm::vec3 normal = glm::normalize(glm::cross(vertices[b] - vertices[a], vertices[c] - vertices[a]));
+        triangles.emplace_back(vertices[a], vertices[b], vertices[c], normal, color);
+        indices.push_back({a, b, c});
+    };
+
+    for(size_t x = 0; x < size; ++x) {
+        for(size_t z = 0; z < size; ++z) {
+            const size_t color = ((x + z) / 5) % 2;
+            addTriangle(vertexIdx(x, z), vertexIdx(x, z + 1), vertexIdx(x + 1, z), color);
+            addTriangle(vertexIdx(x + 1, z), vertexIdx(x, z + 1), vertexIdx(x + 1, z + 1), color);
+        }
+    }
+    return pepr3d::Geometry(std::move(triangles), std::move(vertices), std::move(indices));
+}
+
+/// Triangle ids sorted by the base and the detail id
+std::vector<pepr3d::DetailedTriangleId> sortedIds(std::vector<pepr3d::DetailedTriangleId> ids) {
+    std::sort(ids.begin(), ids.end(), [](const pepr3d::DetailedTriangleId& a, const pepr3d::DetailedTriangleId& b) {
+        return a.getBaseId() < b.getBaseId() || (a.getBaseId() == b.getBaseId() && a.getDetailId() < b.getDetailId());
+    });
+    return ids;
+}
+
+TEST(Geometry, bucketRegionMatchesBfs) {
+    /**
+     * Test that the cached bucket regions are the same as the regions found by BFS, also after recoloring
+     */
+
+    pepr3d::Geometry geo(getGeometryWithGrid(48));
+    ASSERT_TRUE(geo.polyhedronValid());
+
+    // A dab creates detailed triangles
+    pepr3d::BrushSettings brush;
+    brush.color = 2;
+    brush.size = 0.3f;
+    geo.paintAreaWithSphere(ci::Ray(glm::vec3(12.3f, 10, 20.6f), glm::vec3(0, -1, 0)), brush);
+    ASSERT_FALSE(geo.isSimpleTriangle(2 * (12 * 48 + 20)));
+
+    const auto colorStopping = [&geo](const pepr3d::DetailedTriangleId a, const pepr3d::DetailedTriangleId b) {
+        return geo.getTriangle(a).getColor() == geo.getTriangle(b).getColor();
+    };
+    const double threshold = std::cos(glm::radians(30.0));
+    const auto normalStopping = [&geo, threshold](const pepr3d::DetailedTriangleId a,
+                                                  const pepr3d::DetailedTriangleId b) {
+        const glm::vec3 normalA = glm::normalize(geo.getTriangle(a).getNormal());
+        const glm::vec3 normalB = glm::normalize(geo.getTriangle(b).getNormal());
+        return a.getBaseId() == b.getBaseId() || glm::dot(normalA, normalB) >= threshold;
+    };
+    const auto bothStopping = [&](const pepr3d::DetailedTriangleId a, const pepr3d::DetailedTriangleId b) {
+        return colorStopping(a, b) && normalStopping(a, b);
+    };
+
+    pepr3d::Geometry::BucketRegionKey colorKey;
+    colorKey.stopOnColor = true;
+    pepr3d::Geometry::BucketRegionKey normalKey;
+    normalKey.stopOnNormal = true;
+    normalKey.normalThreshold = threshold;
+    pepr3d::Geometry::BucketRegionKey bothKey = normalKey;
+    bothKey.stopOnColor = true;
+
+    const auto expectSameRegions = [&geo](const pepr3d::Geometry::BucketRegionKey& key,
+                                          const pepr3d::Geometry::BucketCondition& condition) {
+        std::vector<pepr3d::DetailedTriangleId> starts = {pepr3d::DetailedTriangleId(2 * (12 * 48 + 20), 0)};
+        for(size_t triIdx = 0; triIdx < geo.getTriangleCount(); triIdx += 97) {
+            if(geo.isSimpleTriangle(triIdx)) {
+                starts.emplace_back(triIdx);
+            }
+        }
+
+        for(const pepr3d::DetailedTriangleId start : starts) {
+            const auto region = sortedIds(geo.bucketRegion(start, key, condition));
+            EXPECT_EQ(region, sortedIds(geo.bucket(start, condition)));
+            EXPECT_NE(std::find(region.begin(), region.end(), start), region.end());
+        }
+    };
+
+    expectSameRegions(colorKey, colorStopping);
+    expectSameRegions(normalKey, normalStopping);
+    expectSameRegions(bothKey, bothStopping);
+
+    // Filling a region merges it with the regions of the same color around it
+    const pepr3d::DetailedTriangleId start(0);
+    geo.setTriangleColors(pepr3d::TriangleSelection(geo.bucketRegion(start, bothKey, bothStopping)), 1);
+    expectSameRegions(bothKey, bothStopping);
+
+    // Single recolored triangles split the regions
+    for(size_t triIdx = 1; triIdx < geo.getTriangleCount(); triIdx += 211) {
+        if(geo.isSimpleTriangle(triIdx)) {
+            geo.setTriangleColor(triIdx, 3);
+        }
+    }
+    expectSameRegions(bothKey, bothStopping);
+
+    // Recoloring does not change the regions that ignore colors
+    expectSameRegions(normalKey, normalStopping);
+}
+
+TEST(Geometry, bucketRegionLatency) {
+    /**
+     * Benchmark filling a region of a large mesh by BFS and from the cached regions
+     */
+
+    pepr3d::Geometry geo(getGeometryWithGrid(256));
+    ASSERT_TRUE(geo.polyhedronValid());
+
+    const auto colorStopping = [&geo](const pepr3d::DetailedTriangleId a, const pepr3d::DetailedTriangleId b) {
+        return geo.getTriangle(a).getColor() == geo.getTriangle(b).getColor();
+    };
+    pepr3d::Geometry::BucketRegionKey colorKey;
+    colorKey.stopOnColor = true;
+    const auto doNotStop = [](const pepr3d::DetailedTriangleId, const pepr3d::DetailedTriangleId) { return true; };
+    const pepr3d::Geometry::BucketRegionKey wholeModelKey{};
+
+    const auto measureMs = [](const std::function<void()>& func) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        func();
+        const auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    const pepr3d::DetailedTriangleId start(1000);
+    std::vector<pepr3d::DetailedTriangleId> bfsRegion, cachedRegion;
+    geo.bucket(start, colorStopping);  // Builds the detailed mesh
+    const double bfsMs = measureMs([&]() { bfsRegion = geo.bucket(start, doNotStop); });
+    const double labelMs = measureMs([&]() { geo.bucketRegion(start, wholeModelKey, doNotStop); });
+    const double cachedMs = measureMs([&]() { cachedRegion = geo.bucketRegion(start, wholeModelKey, doNotStop); });
+    EXPECT_EQ(sortedIds(bfsRegion), sortedIds(cachedRegion));
+    EXPECT_EQ(cachedRegion.size(), geo.getTriangleCount());
+
+    // Filling stripes one after another, each fill recolors a region
+    geo.bucketRegion(start, colorKey, colorStopping);
+    double fillMs = 0;
+    for(size_t fill = 0; fill < 16; ++fill) {
+        const pepr3d::DetailedTriangleId fillStart(fill * 4099 % geo.getTriangleCount());
+        fillMs += measureMs([&]() {
+            const auto region = geo.bucketRegion(fillStart, colorKey, colorStopping);
+            geo.setTriangleColors(pepr3d::TriangleSelection(region), 2 + fill % 2);
+        });
+    }
+
+    RecordProperty("Triangles", std::to_string(geo.getTriangleCount()));
+    RecordProperty("BfsMs", std::to_string(bfsMs));
+    RecordProperty("LabelMs", std::to_string(labelMs));
+    RecordProperty("CachedMs", std::to_string(cachedMs));
+    RecordProperty("FillWithRelabelMs", std::to_string(fillMs / 16));
+    EXPECT_LT(cachedMs, bfsMs);
+}
+
+TEST(Geometry, edgeCosines) {
+    /**
+     * Test that the precomputed cosines of neighbouring triangles match their normals and that sharp edges are
+     * found on the ridges of the grid
+     */
+
+    pepr3d::Geometry geo(getGeometryWithGrid(48));
+    ASSERT_TRUE(geo.polyhedronValid());
+
+    const auto directCosine = [&geo](size_t a, size_t b) {
+        return glm::dot(glm::normalize(geo.getTriangle(a).getNormal()),
+                        glm::normalize(geo.getTriangle(b).getNormal()));
+    };
+
+    for(size_t x = 0; x + 1 < 48; ++x) {
+        for(size_t z = 0; z < 48; z += 5) {
+            // Two triangles of a quad and the second one with the first triangle of the next column
+            const size_t quadIdx = 2 * (x * 48 + z);
+            const size_t nextQuadIdx = 2 * ((x + 1) * 48 + z);
+            EXPECT_NEAR(geo.getNeighbourCosine(quadIdx, quadIdx + 1), directCosine(quadIdx, quadIdx + 1), 1e-6);
+            EXPECT_NEAR(geo.getNeighbourCosine(quadIdx + 1, nextQuadIdx), directCosine(quadIdx + 1, nextQuadIdx),
+                        1e-6);
+        }
+    }
+
+    // Triangles that are not neighbours fall back to their normals
+    EXPECT_NEAR(geo.getNeighbourCosine(0, 2 * (10 * 48)), directCosine(0, 2 * (10 * 48)), 1e-6);
+
+    // Cosines by edge are NaN only on the border of the grid
+    const auto countBorderEdges = [&geo](size_t triIdx) {
+        int count = 0;
+        for(int edge = 0; edge < 3; ++edge) {
+            count += std::isnan(geo.getEdgeCosine(triIdx, edge)) ? 1 : 0;
+        }
+        return count;
+    };
+    EXPECT_EQ(countBorderEdges(2 * (10 * 48 + 10)), 0);
+    EXPECT_EQ(countBorderEdges(2 * (10 * 48 + 10) + 1), 0);
+    EXPECT_GT(countBorderEdges(0), 0);
+
+    // Slopes of the grid change on every 8th column, by about 53 degrees
+    const auto sharpEdges = geo.getSharpEdges(std::cos(glm::radians(30.0)));
+    EXPECT_EQ(sharpEdges.size(), 5u * 48u);
+    for(const auto& edge : sharpEdges) {
+        const size_t firstColumn = edge.first / 2 / 48;
+        const size_t secondColumn = edge.second / 2 / 48;
+        EXPECT_EQ(std::max(firstColumn, secondColumn) % 8, 0u);
+        EXPECT_EQ(std::max(firstColumn, secondColumn), std::min(firstColumn, secondColumn) + 1);
+    }
+    EXPECT_TRUE(geo.getSharpEdges(-1.0).empty());
+}
+
+/// Outline of an axis-aligned rectangle in the plane above the grid
+pepr3d::TriangleDetail::PolygonOutline getRectangleOutline(double minX, double minZ, double maxX, double maxZ) {
+    using Point = pepr3d::DataTriangle::Point;
+    return {{Point(minX, 10, minZ), Point(maxX, 10, minZ), Point(maxX, 10, maxZ), Point(minX, 10, maxZ)}, {}};
+}
+
+TEST(Geometry, paintWithShapesMatchesLetters) {
+    /**
+     * Test that painting all letters of a text at once gives the same result as painting them one by one
+     */
+
+    using Outline = pepr3d::TriangleDetail::PolygonOutline;
+
+    // Letters made of two overlapping rectangles, one of them with a hole, neighbouring letters overlap too
+    std::vector<std::vector<Outline>> text;
+    for(size_t letterIdx = 0; letterIdx < 40; ++letterIdx) {
+        const double left = 2.13 + 1.1 * static_cast<double>(letterIdx);
+        const double bottom = 10.37 + 0.3 * static_cast<double>(letterIdx % 5);
+        Outline stem = getRectangleOutline(left, bottom, left + 0.35, bottom + 2.9);
+        stem.holes.push_back(getRectangleOutline(left + 0.1, bottom + 0.4, left + 0.25, bottom + 1.0).boundary);
+        text.push_back({stem, getRectangleOutline(left, bottom + 1.2, left + 1.25, bottom + 1.55)});
+    }
+    const ci::Ray ray(glm::vec3(24, 20, 12), glm::vec3(0, -1, 0));
+
+    pepr3d::Geometry letterGeo(getGeometryWithGrid(48));
+    const auto letterStart = std::chrono::high_resolution_clock::now();
+    for(const std::vector<Outline>& letter : text) {
+        letterGeo.paintWithShapes(ray, {letter}, 2);
+    }
+    const auto letterEnd = std::chrono::high_resolution_clock::now();
+
+    pepr3d::Geometry textGeo(getGeometryWithGrid(48));
+    const auto textStart = std::chrono::high_resolution_clock::now();
+    textGeo.paintWithShapes(ray, text, 2);
+    const auto textEnd = std::chrono::high_resolution_clock::now();
+
+    const double letterMs = std::chrono::duration<double, std::milli>(letterEnd - letterStart).count();
+    const double textMs = std::chrono::duration<double, std::milli>(textEnd - textStart).count();
+    RecordProperty("LettersMs", std::to_string(letterMs));
+    RecordProperty("TextMs", std::to_string(textMs));
+    RecordProperty("Speedup", std::to_string(letterMs / textMs));
+
+    const double letterArea = getColorArea(letterGeo, 2);
+    ASSERT_GT(letterArea, 0.0);
+    EXPECT_NEAR(getColorArea(textGeo, 2), letterArea, letterArea * 1e-9);
+    for(size_t color = 0; color < 2; ++color) {
+        EXPECT_NEAR(getColorArea(textGeo, color), getColorArea(letterGeo, color), letterArea * 1e-9);
+    }
+    for(size_t triIdx = 0; triIdx < textGeo.getTriangleCount(); ++triIdx) {
+        EXPECT_EQ(textGeo.isSimpleTriangle(triIdx), letterGeo.isSimpleTriangle(triIdx));
+    }
+}
+
+/// Area of all triangles of the color projected to the ground plane, detailed triangles included
+double getProjectedColorArea(const pepr3d::Geometry& geo, size_t color) {
+    double area = 0.0;
+    for(size_t baseIdx = 0; baseIdx < geo.getTriangleCount(); ++baseIdx) {
+        const size_t detailCount = geo.getTriangleDetailCount(baseIdx);
+        std::vector<pepr3d::DetailedTriangleId> triangleIds;
+        if(detailCount == 0) {
+            triangleIds.emplace_back(baseIdx);
+        }
+        for(size_t detailIdx = 0; detailIdx < detailCount; ++detailIdx) {
+            triangleIds.emplace_back(baseIdx, detailIdx);
+        }
+
+        for(const pepr3d::DetailedTriangleId& triangleId : triangleIds) {
+            if(geo.getTriangleColor(triangleId) == color) {
+                const pepr3d::DataTriangle& tri = geo.getTriangle(triangleId);
+                const glm::dvec3 a(tri.getVertex(0)), b(tri.getVertex(1)), c(tri.getVertex(2));
+                area += std::abs(glm::cross(b - a, c - a).y) / 2.0;
+            }
+        }
+    }
+    return area;
+}
+
+TEST(Geometry, paintTextParagraph) {
+    /**
+     * Benchmark painting a paragraph of letters with holes, checking that the painted area matches the letters
+     */
+
+    using Outline = pepr3d::TriangleDetail::PolygonOutline;
+
+    // "O" with a bar through its hole, the bar is a separate outline that has to be joined with the ring
+    const size_t lineCount = 8;
+    const size_t lineLength = 60;
+    std::vector<std::vector<Outline>> text;
+    for(size_t line = 0; line < lineCount; ++line) {
+        for(size_t letterIdx = 0; letterIdx < lineLength; ++letterIdx) {
+            const double left = 2.17 + 1.3 * static_cast<double>(letterIdx);
+            const double bottom = 2.31 + 1.7 * static_cast<double>(line);
+            Outline ring = getRectangleOutline(left, bottom, left + 0.8, bottom + 1.2);
+            ring.holes.push_back(getRectangleOutline(left + 0.2, bottom + 0.2, left + 0.6, bottom + 1.0).boundary);
+            text.push_back({ring, getRectangleOutline(left + 0.3, bottom, left + 0.5, bottom + 1.2)});
+        }
+    }
+    const double letterArea = 0.8 * 1.2 - 0.4 * 0.8 + 0.2 * 0.8;
+    const ci::Ray ray(glm::vec3(40, 20, 10), glm::vec3(0, -1, 0));
+
+    pepr3d::Geometry geo(getGeometryWithGrid(128));
+    const auto start = std::chrono::high_resolution_clock::now();
+    geo.paintWithShapes(ray, text, 2);
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    const double textMs = std::chrono::duration<double, std::milli>(end - start).count();
+    RecordProperty("Letters", std::to_string(text.size()));
+    RecordProperty("TextMs", std::to_string(textMs));
+    RecordProperty("LettersPerSecond", std::to_string(1000.0 * static_cast<double>(text.size()) / textMs));
+
+    const double expectedArea = letterArea * static_cast<double>(text.size());
+    EXPECT_NEAR(getProjectedColorArea(geo, 2), expectedArea, expectedArea * 1e-4);
+}
+#endif
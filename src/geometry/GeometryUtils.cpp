@@ -46,6 +46,89 @@ bool GeometryUtils::isFullyInsideASphere(const DataTriangle::K::Triangle_3 &tri,
     return dist0 <= radiusSquared && dist1 <= radiusSquared && dist2 <= radiusSquared;
 }
 
+std::vector<glm::dvec2> GeometryUtils::projectAlongDirection(const std::vector<DataTriangle::K::Point_3> &points,
+                                                             const glm::dvec3 &direction) {
+    const glm::dvec3 dir = glm::normalize(direction);
+
+    // Orthonormal base of the plane perpendicular to the direction
+    const glm::dvec3 notParallel = std::abs(dir.x) < 0.9 ? glm::dvec3(1, 0, 0) : glm::dvec3(0, 1, 0);
+    const glm::dvec3 xBase = glm::normalize(glm::cross(dir, notParallel));
+    const glm::dvec3 yBase = glm::cross(dir, xBase);
+
+    std::vector<glm::dvec2> result;
+    result.reserve(points.size());
+    for(const auto &point : points) {
+        const glm::dvec3 pt(point.x(), point.y(), point.z());
+        result.emplace_back(glm::dot(pt, xBase), glm::dot(pt, yBase));
+    }
+    return result;
+}
+
+GeometryUtils::ProjectedShapeRelation GeometryUtils::relateProjectedShape(const std::vector<glm::dvec2> &shape,
+                                                                          const std::vector<glm::dvec2> &triangle) {
+    P_ASSERT(triangle.size() == 3);
+    if(shape.size() < 3) {
+        return ProjectedShapeRelation::Uncertain;
+    }
+
+    glm::dvec2 shapeMin = shape[0], shapeMax = shape[0];
+    for(const glm::dvec2 &pt : shape) {
+        shapeMin = glm::min(shapeMin, pt);
+        shapeMax = glm::max(shapeMax, pt);
+    }
+    glm::dvec2 triMin = triangle[0], triMax = triangle[0];
+    for(const glm::dvec2 &pt : triangle) {
+        triMin = glm::min(triMin, pt);
+        triMax = glm::max(triMax, pt);
+    }
+
+    // Margin covers rounding of the projection, the exact test works with the same input coordinates
+    const glm::dvec2 largest = glm::max(glm::max(glm::abs(shapeMin), glm::abs(shapeMax)),
+                                        glm::max(glm::abs(triMin), glm::abs(triMax)));
+    const double margin = 1e-8 * std::max(largest.x, largest.y);
+
+    if(triMax.x < shapeMin.x - margin || triMin.x > shapeMax.x + margin || triMax.y < shapeMin.y - margin ||
+       triMin.y > shapeMax.y + margin) {
+        return ProjectedShapeRelation::Disjoint;
+    }
+
+    const auto cross = [](const glm::dvec2 &a, const glm::dvec2 &b) { return a.x * b.y - a.y * b.x; };
+
+    double doubleArea = 0;
+    for(size_t i = 0; i < shape.size(); ++i) {
+        doubleArea += cross(shape[i], shape[(i + 1) % shape.size()]);
+    }
+    if(std::abs(doubleArea) <= margin * margin) {
+        return ProjectedShapeRelation::Uncertain;
+    }
+    const double orientation = doubleArea > 0 ? 1.0 : -1.0;
+
+    for(size_t i = 0; i < shape.size(); ++i) {
+        const glm::dvec2 &edgeStart = shape[i];
+        const glm::dvec2 edge = shape[(i + 1) % shape.size()] - edgeStart;
+        const glm::dvec2 nextEdge = shape[(i + 2) % shape.size()] - shape[(i + 1) % shape.size()];
+        const double edgeLength = glm::length(edge);
+        if(edgeLength <= margin) {
+            return ProjectedShapeRelation::Uncertain;
+        }
+
+        // A reflex vertex makes the shape concave, half-plane tests are not enough then
+        if(orientation * cross(edge, nextEdge) < 0) {
+            return ProjectedShapeRelation::Uncertain;
+        }
+
+        // Every triangle vertex must be inside, clearly away from the edge
+        for(const glm::dvec2 &pt : triangle) {
+            const double distanceInside = orientation * cross(edge, pt - edgeStart) / edgeLength;
+            if(distanceInside <= margin) {
+                return ProjectedShapeRelation::Uncertain;
+            }
+        }
+    }
+
+    return ProjectedShapeRelation::CoversTriangle;
+}
+
 std::pair<DataTriangle::K::Point_3, double> GeometryUtils::getBoundingSphere(
     const std::vector<DataTriangle::K::Point_3> &shape) {
     using K = DataTriangle::K;
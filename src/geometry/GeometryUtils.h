@@ -16,6 +16,8 @@
 #include <CGAL/Polygon_set_2.h>
 #include <CGAL/Polygon_with_holes_2.h>
 #include <CGAL/Simple_cartesian.h>
+#include <algorithm>
+#include <cmath>
 #include <optional>
 #include <vector>
 
@@ -43,6 +45,37 @@ class GeometryUtils {
     };
 
    public:
+    /// Least number of segments of a circle tessellated from a chord tolerance
+    static constexpr int MIN_CIRCLE_SEGMENTS = 6;
+
+    /// Most segments of a circle tessellated from a chord tolerance, stops huge circles from exploding the geometry
+    static constexpr int MAX_CIRCLE_SEGMENTS = 256;
+
+    /// Number of segments of a polygon approximating a circle, so that no point of the circle is further than
+    /// chordTolerance from the polygon. The count grows with the square root of the radius.
+    /// @param segments Fixed number of segments used when chordTolerance is 0
+    static int getCircleSegmentCount(double radius, double chordTolerance, int segments) {
+        if(chordTolerance <= 0.0) {
+            return segments;
+        }
+        if(chordTolerance >= radius) {
+            return MIN_CIRCLE_SEGMENTS;
+        }
+
+        // Sagitta of a segment spanning the angle a is radius * (1 - cos(a / 2))
+        const double maxSegmentAngle = 2.0 * std::acos(1.0 - chordTolerance / radius);
+        const double segmentCount = std::ceil(2.0 * glm::pi<double>() / maxSegmentAngle);
+        return static_cast<int>(std::clamp(segmentCount, static_cast<double>(MIN_CIRCLE_SEGMENTS),
+                                           static_cast<double>(MAX_CIRCLE_SEGMENTS)));
+    }
+
+    /// Relation of a shape and a triangle projected along the same direction
+    enum class ProjectedShapeRelation {
+        Disjoint,        ///< The shape does not touch the triangle
+        CoversTriangle,  ///< The whole triangle is inside the shape
+        Uncertain        ///< Anything else, including cases too close to decide in double precision
+    };
+
     /// Simplify polygon, removing unnecessary vertices
     /// @return true Polygon was simplified
     template <typename K>
@@ -189,6 +222,16 @@ class GeometryUtils {
     static bool isFullyInsideASphere(const DataTriangle::K::Triangle_3& tri, const DataTriangle::K::Point_3& origin,
                                      double radius);
 
+    /// Orthogonally project points along the direction to 2D coordinates of a plane perpendicular to it
+    static std::vector<glm::dvec2> projectAlongDirection(const std::vector<DataTriangle::K::Point_3>& points,
+                                                         const glm::dvec3& direction);
+
+    /// Conservative test of a projected shape against a projected triangle, both from projectAlongDirection().
+    /// Computed in double precision with a safety margin, so Disjoint and CoversTriangle are always correct and the
+    /// exact test is needed only for Uncertain results. CoversTriangle is only detected for convex shapes.
+    static ProjectedShapeRelation relateProjectedShape(const std::vector<glm::dvec2>& shape,
+                                                       const std::vector<glm::dvec2>& triangle);
+
     static bool isFullyInsideASphere(const DataTriangle::K::Triangle_3& tri, const glm::vec3& origin, double radius) {
         return isFullyInsideASphere(tri, DataTriangle::K::Point_3(origin.x, origin.y, origin.z), radius);
     }
@@ -82,5 +82,69 @@ TEST(GeometryUtils, SimplifyPolygon) {
 
     EXPECT_FALSE(GeometryUtils::simplifyPolygon(pgn));
 }
+
+TEST(GeometryUtils, RelateProjectedShape) {
+    /**
+     * Test the conservative relation between a projected shape and a triangle
+     */
+    using Relation = GeometryUtils::ProjectedShapeRelation;
+    using Point3 = DataTriangle::K::Point_3;
+
+    const glm::dvec3 down(0, -1, 0);
+    const std::vector<glm::dvec2> square = GeometryUtils::projectAlongDirection(
+        {Point3(-1, 1, -1), Point3(1, 1, -1), Point3(1, 1, 1), Point3(-1, 1, 1)}, down);
+
+    const auto relate = [&](const std::vector<Point3>& triangle) {
+        return GeometryUtils::relateProjectedShape(square, GeometryUtils::projectAlongDirection(triangle, down));
+    };
+
+    // Height along the projection does not matter
+    EXPECT_EQ(relate({Point3(-0.5, 0, -0.5), Point3(0.5, 3, -0.5), Point3(0, -2, 0.5)}), Relation::CoversTriangle);
+    EXPECT_EQ(relate({Point3(2, 0, 2), Point3(3, 0, 2), Point3(2, 0, 3)}), Relation::Disjoint);
+    EXPECT_EQ(relate({Point3(0.5, 0, 0.5), Point3(3, 0, 0.5), Point3(0.5, 0, 3)}), Relation::Uncertain);
+
+    // Touching the edge of the shape is too close to decide
+    EXPECT_EQ(relate({Point3(-1, 0, -0.5), Point3(0.5, 0, -0.5), Point3(0, 0, 0.5)}), Relation::Uncertain);
+
+    // Concave shapes are never reported as covering
+    const std::vector<glm::dvec2> concave = GeometryUtils::projectAlongDirection(
+        {Point3(-1, 1, -1), Point3(1, 1, -1), Point3(0, 1, 0), Point3(1, 1, 1), Point3(-1, 1, 1)}, down);
+    EXPECT_EQ(GeometryUtils::relateProjectedShape(
+                  concave, GeometryUtils::projectAlongDirection(
+                               {Point3(-0.9, 0, -0.1), Point3(-0.5, 0, -0.1), Point3(-0.7, 0, 0.1)}, down)),
+              Relation::Uncertain);
+}
+
+TEST(GeometryUtils, CircleSegmentCount) {
+    /**
+     * Test picking the number of segments of a circle from a chord tolerance
+     */
+    const double tolerance = 0.001;
+
+    // No tolerance keeps the fixed number of segments
+    EXPECT_EQ(GeometryUtils::getCircleSegmentCount(0.1, 0.0, 12), 12);
+    EXPECT_EQ(GeometryUtils::getCircleSegmentCount(10.0, 0.0, 12), 12);
+
+    // Circles smaller than the tolerance get the minimum, huge circles the maximum
+    EXPECT_EQ(GeometryUtils::getCircleSegmentCount(tolerance / 2, tolerance, 12), GeometryUtils::MIN_CIRCLE_SEGMENTS);
+    EXPECT_EQ(GeometryUtils::getCircleSegmentCount(1000.0, tolerance, 12), GeometryUtils::MAX_CIRCLE_SEGMENTS);
+
+    int previousCount = 0;
+    for(double radius = 0.002; radius < 2.0; radius *= 1.5) {
+        const int count = GeometryUtils::getCircleSegmentCount(radius, tolerance, 12);
+        EXPECT_GE(count, previousCount);
+        previousCount = count;
+
+        // The polygon stays within the tolerance
+        if(count < GeometryUtils::MAX_CIRCLE_SEGMENTS) {
+            EXPECT_LE(radius * (1.0 - std::cos(glm::pi<double>() / count)), tolerance * (1.0 + 1e-9));
+        }
+    }
+
+    // The count grows with the square root of the radius, 4 times larger circle needs about twice the segments
+    const int smallCount = GeometryUtils::getCircleSegmentCount(0.1, tolerance, 12);
+    const int largeCount = GeometryUtils::getCircleSegmentCount(0.4, tolerance, 12);
+    EXPECT_NEAR(static_cast<double>(largeCount) / smallCount, 2.0, 0.1);
+}
 }  // namespace pepr3d
 #endif
\ No newline at end of file
@@ -31,6 +31,14 @@ struct PolyhedronData {
     /// Note: the SDF values are linearly normalized so min=0, max=1
     PolyhedronData::Mesh::Property_map<PolyhedronData::face_descriptor, double> sdf_property_map;
 
+    /// Neighbour of each triangle across each of its edges at 3 * triangle + edge, -1 on borders. Edges are in the
+    /// order of Geometry::gatherNeighbours(). Filled by Geometry::computeNeighbourCosines() after the mesh is built.
+    std::vector<int> neighbourIds;
+
+    /// Cosine of the angle between the normals of the triangle and its neighbour, in the slots of neighbourIds, NaN on
+    /// borders
+    std::vector<double> neighbourCosines;
+
     /// A "map" converting the ID of each triangle (from mTriangles) into a face_descriptor
     std::vector<PolyhedronData::face_descriptor> mFaceDescs;
 
@@ -9,6 +9,7 @@
 #include <CGAL/Polygon_2.h>
 #include <CGAL/Polygon_set_2.h>
 #include <CGAL/Spherical_kernel_intersections.h>
+#include <CGAL/convex_hull_2.h>
 #include <CGAL/partition_2.h>
 
 #ifdef PEPR3D_COLLECT_DEBUG_DATA
@@ -18,6 +19,8 @@
 #endif
 
 #include <cinder/Log.h>
+#include <algorithm>
+#include <cmath>
 #include <deque>
 #include <list>
 #include <optional>
@@ -30,23 +33,114 @@
 
 namespace pepr3d {
 
-void TriangleDetail::paintSphere(const PeprSphere& peprSphere, int minSegments, size_t color) {
+void TriangleDetail::paintSphere(const PeprSphere& peprSphere, int minSegments, size_t color, double gridSize,
+                                 const SphereEdgeIntersections* edgeIntersections, double chordTolerance) {
     // Vertices on the triangle boundaries must be the same across multiple triangle details!
 
-    const Sphere sphere(toExactK(peprSphere.center()), peprSphere.squared_radius());
-    auto intersection = CGAL::intersection(sphere, mOriginalPlane);
+    // Continue only if the intersection is a circle (not a point or miss)
+    const std::optional<Circle3> circleIntersection = intersectWithPlane(peprSphere);
+    if(circleIntersection) {
+        const auto poly =
+            polygonFromCircle(*circleIntersection, minSegments, chordTolerance,
+                              edgeIntersections ? *edgeIntersections : intersectSphereWithEdges(peprSphere));
+        addPolygon(snapToGrid(poly, gridSize), color);
+    }
+}
 
-    if(!intersection) {
+void TriangleDetail::paintSweptSphere(const std::vector<SweptSegment>& segments, int minSegments, size_t color,
+                                      double gridSize, double chordTolerance) {
+    const PeprPlane plane(mOriginal.getTri().vertex(0), mOriginal.getTri().vertex(1), mOriginal.getTri().vertex(2));
+
+    std::vector<Polygon> polygons;
+    for(const SweptSegment& segment : segments) {
+        // Spheres whose intersections make up the shape of the segment
+        std::vector<std::pair<PeprSphere, const SphereEdgeIntersections*>> spheres = {
+            {segment.start, segment.startEdgeIntersections}};
+        if(segment.end != segment.start) {
+            // The swept sphere is convex, so is its intersection with the plane. Radius of the intersection changes
+            // along the segment and is largest where the segment crosses the plane.
+            const double startDistance =
+                CGAL::to_double(plane.orthogonal_vector() * (segment.start.center() - plane.point()));
+            const double endDistance =
+                CGAL::to_double(plane.orthogonal_vector() * (segment.end.center() - plane.point()));
+            if(startDistance * endDistance < 0) {
+                // Its edge points are not shared with the neighbours, the hull gets the shared ones below
+                static const SphereEdgeIntersections noEdgeIntersections;
+                const double t = startDistance / (startDistance - endDistance);
+                const PeprVector3 segmentVector = segment.end.center() - segment.start.center();
+                spheres.emplace_back(PeprSphere(segment.start.center() + t * segmentVector,
+                                                segment.start.squared_radius()),
+                                     &noEdgeIntersections);
+            }
+            spheres.emplace_back(segment.end, segment.endEdgeIntersections);
+        }
+
+        std::vector<Polygon> circlePolygons;
+        for(const auto& sphere : spheres) {
+            if(const std::optional<Circle3> circle = intersectWithPlane(sphere.first)) {
+                circlePolygons.push_back(
+                    polygonFromCircle(*circle, minSegments, chordTolerance,
+                                      sphere.second ? *sphere.second : intersectSphereWithEdges(sphere.first)));
+            }
+        }
+        if(circlePolygons.empty()) {
+            continue;
+        }
+
+        // Convex hull of the intersections approximates the intersection of the whole swept sphere
+        Polygon shape;
+        if(segment.end == segment.start) {
+            shape = std::move(circlePolygons.front());
+        } else {
+            std::vector<Point2> points;
+            for(const Polygon& circlePolygon : circlePolygons) {
+                points.insert(points.end(), circlePolygon.vertices_begin(), circlePolygon.vertices_end());
+            }
+
+            // The hull crosses the edges where the swept sphere does, so the neighbours get the same vertices there
+            for(size_t i = 0; i < 3; i++) {
+                for(const Point3& edgePoint : intersectSweptSphereWithEdge(
+                        segment.start, segment.end, mOriginal.getVertex(i), mOriginal.getVertex((i + 1) % 3))) {
+                    points.push_back(mOriginalPlane.to_2d(edgePoint));
+                }
+            }
+            CGAL::convex_hull_2(points.begin(), points.end(), std::back_inserter(shape.container()));
+        }
+
+        shape = snapToGrid(shape, gridSize);
+        if(shape.size() < 3 || !CGAL::do_overlap(shape.bbox(), mBounds.bbox())) {
+            continue;
+        }
+
+        if(polygonCoversBounds(shape)) {
+#ifdef PEPR3D_COLLECT_DEBUG_DATA
+            history.emplace_back(PolygonEntry{shape, color});
+#endif
+            fillWithColor(color);
+            return;
+        }
+        polygons.push_back(std::move(shape));
+    }
+
+    if(polygons.empty()) {
         return;
     }
 
-    std::optional<Circle3> circleIntersection = boost::apply_visitor(SphereIntersectionVisitor{}, *intersection);
+    PolygonSet pSet{};
+    pSet.join(polygons.begin(), polygons.end());
+    addPolygonSet(pSet, color);
+}
 
-    // Continue only if the intersection is a circle (not a point or miss)
-    if(circleIntersection) {
-        auto poly = polygonFromCircle(*circleIntersection, minSegments);
-        addPolygon(poly, color);
+std::optional<TriangleDetail::Circle3> TriangleDetail::intersectWithPlane(const PeprSphere& peprSphere) const {
+    // Only the intersection is computed in the spherical kernel, the resulting circle is converted to K
+    const Sphere sphere(toSphericalK(peprSphere.center()), peprSphere.squared_radius());
+    auto intersection = CGAL::intersection(sphere, toSphericalK(mOriginalPlane));
+
+    if(!intersection) {
+        return {};
     }
+
+    return boost::apply_visitor(SphereIntersectionVisitor{}, *intersection);
 }
 TriangleDetail::Polygon TriangleDetail::projectShapeToPolygon(const std::vector<PeprPoint3>& shape,
                                                               const PeprVector3& direction) {
@@ -83,25 +177,86 @@ TriangleDetail::Polygon TriangleDetail::projectShapeToPolygon(const std::vector<
 
     return pgn;
 }
-void TriangleDetail::paintShape(const std::vector<PeprPoint3>& shape, const PeprVector3& direction, size_t color) {
-    addPolygon(projectShapeToPolygon(shape, direction), color);
+void TriangleDetail::paintShape(const std::vector<PeprPoint3>& shape, const PeprVector3& direction, size_t color,
+                                double gridSize) {
+    const Polygon pgn = snapToGrid(projectShapeToPolygon(shape, direction), gridSize);
+    if(pgn.is_empty() || !CGAL::do_overlap(pgn.bbox(), mBounds.bbox())) {
+        return;
+    }
+
+    if(polygonCoversBounds(pgn)) {
+#ifdef PEPR3D_COLLECT_DEBUG_DATA
+        history.emplace_back(PolygonEntry{pgn, color});
+#endif
+        fillWithColor(color);
+        return;
+    }
+
+    addPolygon(pgn, color);
 }
 
-void TriangleDetail::paintShape(const std::vector<PeprTriangle>& triangles, const PeprVector3& direction,
-                                size_t color) {
-    std::vector<Polygon> polygons;
-    polygons.reserve(triangles.size());
-    for(const auto& tri : triangles) {
-        // Construct new points instead of a copy (to be safe in multithreaded environment)
-        std::vector<PeprPoint3> points = {PeprPoint3(tri.vertex(0).x(), tri.vertex(0).y(), tri.vertex(0).z()),
-                                          PeprPoint3(tri.vertex(1).x(), tri.vertex(1).y(), tri.vertex(1).z()),
-                                          PeprPoint3(tri.vertex(2).x(), tri.vertex(2).y(), tri.vertex(2).z())};
-        Polygon pgn = projectShapeToPolygon(points, direction);
-        // Add only if intersects the bounds
-        if(trianglePolygonsDoIntersect(pgn, mBounds)) {
+void TriangleDetail::paintShapes(const std::vector<const std::vector<PolygonOutline>*>& shapes,
+                                 const PeprVector3& direction, size_t color, double gridSize) {
+    const CGAL::Bbox_2 boundsBox = mBounds.bbox();
+
+    // Adds the holes of the outline snapped to the grid, returns false if a hole vanishes or leaves the boundary
+    const auto projectHoles = [&direction, this](const PolygonOutline& outline, double grid, PolygonWithHoles& pgn) {
+        for(const std::vector<PeprPoint3>& holeShape : outline.holes) {
+            Polygon hole = snapToGrid(projectShapeToPolygon(holeShape, direction), grid);
+            if(hole.is_empty()) {
+                return false;
+            }
+            hole.reverse_orientation();
+            pgn.add_hole(std::move(hole));
+        }
+        return CGAL::is_valid_polygon_with_holes(pgn, Traits());
+    };
+
+    std::vector<PolygonWithHoles> polygons;
+    for(const std::vector<PolygonOutline>* outlines : shapes) {
+        for(const PolygonOutline& outline : *outlines) {
+            // Outlines far from the detail are skipped before projecting their holes
+            const Polygon boundary = snapToGrid(projectShapeToPolygon(outline.boundary, direction), gridSize);
+            if(boundary.is_empty() || !CGAL::do_overlap(boundary.bbox(), boundsBox)) {
+                continue;
+            }
+
+            // Snapping may remove a hole or move it outside the boundary, the outline is painted exactly then. If
+            // even the exact holes are invalid, e.g. parallel to the direction, the outline is skipped rather than
+            // painted filled.
+            PolygonWithHoles pgn(boundary);
+            if(!projectHoles(outline, gridSize, pgn)) {
+                if(gridSize <= 0.0) {
+                    continue;
+                }
+                const Polygon exactBoundary = projectShapeToPolygon(outline.boundary, direction);
+                if(exactBoundary.is_empty()) {
+                    continue;
+                }
+                pgn = PolygonWithHoles(exactBoundary);
+                if(!projectHoles(outline, 0.0, pgn)) {
+                    continue;
+                }
+            }
+
+            const bool holesOverlapBounds =
+                std::any_of(pgn.holes_begin(), pgn.holes_end(),
+                            [&boundsBox](const Polygon& hole) { return CGAL::do_overlap(hole.bbox(), boundsBox); });
+            if(!holesOverlapBounds && polygonCoversBounds(pgn.outer_boundary())) {
+#ifdef PEPR3D_COLLECT_DEBUG_DATA
+                history.emplace_back(PolygonEntry{pgn.outer_boundary(), color});
+#endif
+                fillWithColor(color);
+                return;
+            }
             polygons.emplace_back(std::move(pgn));
         }
     }
+    if(polygons.empty()) {
+        return;
+    }
+
+    // Aggregated join merges the shapes pairwise in a divide and conquer manner
     PolygonSet pSet{};
     pSet.join(polygons.begin(), polygons.end());
 
@@ -117,9 +272,10 @@ std::pair<bool, bool> TriangleDetail::correctSharedVertices(TriangleDetail& othe
         other.updatePolysFromTriangles();
     }
 
-    std::set<Point3> myPoints = findPointsOnEdge(sharedEdge);
+    // Copies, adding the missing points updates the edge points of both details
+    const std::vector<Point3> myPoints = findPointsOnEdge(sharedEdge);
     P_ASSERT(myPoints.size() >= 2);
-    std::set<Point3> theirPoints = other.findPointsOnEdge(sharedEdge);
+    const std::vector<Point3> theirPoints = other.findPointsOnEdge(sharedEdge);
     P_ASSERT(theirPoints.size() >= 2);
 
     const bool myPointsAdded = addMissingPoints(myPoints, theirPoints, sharedEdge);
@@ -127,7 +283,16 @@ std::pair<bool, bool> TriangleDetail::correctSharedVertices(TriangleDetail& othe
     return std::make_pair(myPointsAdded, otherPointsAdded);
 }
 
-bool TriangleDetail::addMissingPoints(const std::set<Point3>& myPoints, const std::set<Point3>& theirPoints,
+bool TriangleDetail::hasMatchingSharedVertices(const TriangleDetail& other) const {
+    if(mColorChanged || other.mColorChanged) {
+        return false;
+    }
+
+    const Segment3 sharedEdge = findSharedEdge(other);
+    return findPointsOnEdge(sharedEdge) == other.findPointsOnEdge(sharedEdge);
+}
+
+bool TriangleDetail::addMissingPoints(const std::vector<Point3>& myPoints, const std::vector<Point3>& theirPoints,
                                       const Segment3& sharedEdge) {
 #ifdef PEPR3D_COLLECT_DEBUG_DATA
     history.emplace_back(PointEntry{myPoints, theirPoints, sharedEdge});
@@ -137,10 +302,10 @@ bool TriangleDetail::addMissingPoints(const std::set<Point3>& myPoints, const st
         updatePolysFromTriangles();
     }
 
-    // Find missing points
-    std::set<Point3> missingPoints;
+    // Find missing points, both lists are sorted
+    std::vector<Point3> missingPoints;
     std::set_difference(theirPoints.begin(), theirPoints.end(), myPoints.begin(), myPoints.end(),
-                        std::inserter(missingPoints, missingPoints.begin()));
+                        std::back_inserter(missingPoints));
 
     if(missingPoints.empty()) {
         return false;
@@ -154,16 +319,37 @@ bool TriangleDetail::addMissingPoints(const std::set<Point3>& myPoints, const st
     }
 
     // Bring the 3d points to our plane
+    // Recreate them from rational coordinates, so that this detail does not share lazy evaluation with the other one.
+    // Details are triangulated in parallel later.
     std::vector<Point2> points2D;
     std::transform(missingPoints.begin(), missingPoints.end(), std::back_inserter(points2D),
-                   [this](auto& e) { return mOriginalPlane.to_2d(e); });
+                   [this](auto& e) { return fromRational(toRational(mOriginalPlane.to_2d(e))); });
+    std::vector<Point3> points3D;
+    std::transform(missingPoints.begin(), missingPoints.end(), std::back_inserter(points3D),
+                   [](auto& e) { return fromRational(toRational(e)); });
 
     const Line2 sharedEdge2D(mOriginalPlane.to_2d(sharedEdge.vertex(0)), mOriginalPlane.to_2d(sharedEdge.vertex(1)));
+    const size_t edgeIdx = findEdgeIdx(sharedEdge);
 
     // Find edges that contain any of the points
     for(auto& colorSetIt : mColoredPolys) {
+        // Only a layer that has points on both sides of a missing point can have an edge containing it
+        auto layerPointsIt = mLayerEdgePoints.find(colorSetIt.first);
+        if(layerPointsIt == mLayerEdgePoints.end()) {
+            continue;
+        }
+        std::vector<Point3>& layerPoints = layerPointsIt->second[edgeIdx];
+        const bool mayContainPoint =
+            layerPoints.size() >= 2 && std::any_of(points3D.begin(), points3D.end(), [&layerPoints](const Point3& pt) {
+                return layerPoints.front() < pt && pt < layerPoints.back();
+            });
+        if(!mayContainPoint) {
+            continue;
+        }
+
         std::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes());
         colorSetIt.second.polygons_with_holes(polys.begin());
+        bool layerChanged = false;
 
         for(PolygonWithHoles& polyWithHoles : polys) {
             Polygon& poly = polyWithHoles.outer_boundary();
@@ -194,8 +380,16 @@ bool TriangleDetail::addMissingPoints(const std::set<Point3>& myPoints, const st
 
                         P_ASSERT(GeometryUtils::is_valid_polygon_with_holes(polyWithHoles, Traits()));
 
+                        // Keep the layer edge points sorted
+                        Point3& point3D = points3D[pointIt - points2D.begin()];
+                        layerPoints.insert(std::lower_bound(layerPoints.begin(), layerPoints.end(), point3D),
+                                           point3D);
+
+                        std::swap(point3D, points3D.back());
+                        points3D.pop_back();
                         std::swap(*pointIt, points2D.back());
                         points2D.pop_back();  // Remove the point from array
+                        layerChanged = true;
 
                         continue;  // stay at this vertex
                     }
@@ -206,9 +400,14 @@ bool TriangleDetail::addMissingPoints(const std::set<Point3>& myPoints, const st
         }
 
         // Insert the polygon back to color set
-        colorSetIt.second.clear();
-        colorSetIt.second.join(polys.begin(), polys.end());
+        if(layerChanged) {
+            colorSetIt.second.clear();
+            colorSetIt.second.join(polys.begin(), polys.end());
+            mLayerRanges.erase(colorSetIt.first);
+        }
     }
+    mergeLayerEdgePoints();
+    mOperationsSinceCompaction++;
 
     if(!points2D.empty()) {
         CI_LOG_E("Some shared points could not be added!");
@@ -239,44 +438,112 @@ void TriangleDetail::simplifyPolygons() {
     P_ASSERT(!mColorChanged);  // Did you forget to updatePolygons first?
 
     for(auto& colorSetIt : mColoredPolys) {
-        if(colorSetIt.second.is_empty())
-            continue;
+        simplifyPolygonSet(colorSetIt.second);
+    }
+}
 
-        bool updateNeeded = false;
-        std::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes());
-        colorSetIt.second.polygons_with_holes(polys.begin());
-        for(PolygonWithHoles& poly : polys) {
-            P_ASSERT(GeometryUtils::is_valid_polygon_with_holes(poly, Traits()));
-            updateNeeded |= GeometryUtils::simplifyPolygon(poly.outer_boundary());
-            P_ASSERT(GeometryUtils::is_valid_polygon_with_holes(poly, Traits()));
-        }
+void TriangleDetail::simplifyPolygonSet(PolygonSet& polySet) {
+    if(polySet.is_empty())
+        return;
 
-        // Update this polygon set with simplified representation
-        if(updateNeeded) {
-            colorSetIt.second.clear();
-            colorSetIt.second.join(polys.begin(), polys.end());
+    bool updateNeeded = false;
+    std::vector<PolygonWithHoles> polys(polySet.number_of_polygons_with_holes());
+    polySet.polygons_with_holes(polys.begin());
+    for(PolygonWithHoles& poly : polys) {
+        P_ASSERT(GeometryUtils::is_valid_polygon_with_holes(poly, Traits()));
+        updateNeeded |= GeometryUtils::simplifyPolygon(poly.outer_boundary());
+        P_ASSERT(GeometryUtils::is_valid_polygon_with_holes(poly, Traits()));
+    }
+
+    // Update this polygon set with simplified representation
+    if(updateNeeded) {
+        polySet.clear();
+        polySet.join(polys.begin(), polys.end());
+    }
+}
+
+CGAL::Bbox_2 TriangleDetail::getBoundingBox(const PolygonSet& polySet) {
+    P_ASSERT(!polySet.is_empty());
+    const auto& arrangement = polySet.arrangement();
+
+    auto vertexIt = arrangement.vertices_begin();
+    CGAL::Bbox_2 result = vertexIt->point().bbox();
+    for(++vertexIt; vertexIt != arrangement.vertices_end(); ++vertexIt) {
+        result += vertexIt->point().bbox();
+    }
+    return result;
+}
+
+const std::vector<TriangleDetail::Point3>& TriangleDetail::findPointsOnEdge(const Segment3& edge) const {
+    return mEdgePoints[findEdgeIdx(edge)];
+}
+
+size_t TriangleDetail::findEdgeIdx(const Segment3& edge) const {
+    const PeprTriangle& tri = mOriginal.getTri();
+    for(size_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx) {
+        const Point3 source = toExactK(tri.vertex(edgeIdx));
+        const Point3 target = toExactK(tri.vertex((edgeIdx + 1) % 3));
+        if((edge.source() == source && edge.target() == target) ||
+           (edge.source() == target && edge.target() == source)) {
+            return edgeIdx;
         }
     }
+
+    throw std::logic_error("The segment is not an edge of the original triangle.");
 }
 
-std::set<TriangleDetail::Point3> TriangleDetail::findPointsOnEdge(const TriangleDetail::Segment3& edge) {
-    Line2 edgeLine(mOriginalPlane.to_2d(edge.point(0)), mOriginalPlane.to_2d(edge.point(1)));
-    std::set<Point3> result;
+void TriangleDetail::updateLayerEdgePoints(size_t color) {
+    const PolygonSet& polySet = mColoredPolys.at(color);
+    if(polySet.is_empty()) {
+        mLayerEdgePoints.erase(color);
+        return;
+    }
 
-    for(auto& colorSetIt : mColoredPolys) {
-        std::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes());
-        colorSetIt.second.polygons_with_holes(polys.begin());
-        for(PolygonWithHoles& polyWithHoles : polys) {
-            Polygon& poly = polyWithHoles.outer_boundary();
-            for(auto vertexIt = poly.vertices_begin(); vertexIt != poly.vertices_end(); vertexIt++) {
-                if(edgeLine.has_on(*vertexIt)) {
-                    result.insert(mOriginalPlane.to_3d(*vertexIt));
-                }
+    const PeprTriangle& tri = mOriginal.getTri();
+    std::array<Line2, 3> edgeLines;
+    for(size_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx) {
+        edgeLines[edgeIdx] = Line2(mOriginalPlane.to_2d(toExactK(tri.vertex(edgeIdx))),
+                                   mOriginalPlane.to_2d(toExactK(tri.vertex((edgeIdx + 1) % 3))));
+    }
+
+    EdgePoints edgePoints;
+    const auto& arrangement = polySet.arrangement();
+    for(auto vertexIt = arrangement.vertices_begin(); vertexIt != arrangement.vertices_end(); ++vertexIt) {
+        for(size_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx) {
+            if(edgeLines[edgeIdx].has_on(vertexIt->point())) {
+                edgePoints[edgeIdx].push_back(mOriginalPlane.to_3d(vertexIt->point()));
             }
         }
     }
 
-    return result;
+    for(std::vector<Point3>& points : edgePoints) {
+        std::sort(points.begin(), points.end());
+        points.erase(std::unique(points.begin(), points.end()), points.end());
+    }
+    mLayerEdgePoints[color] = std::move(edgePoints);
+}
+
+void TriangleDetail::mergeLayerEdgePoints() {
+    for(size_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx) {
+        std::vector<Point3> merged;
+        for(const auto& layerIt : mLayerEdgePoints) {
+            const std::vector<Point3>& layerPoints = layerIt.second[edgeIdx];
+            std::vector<Point3> result;
+            result.reserve(merged.size() + layerPoints.size());
+            std::set_union(merged.begin(), merged.end(), layerPoints.begin(), layerPoints.end(),
+                           std::back_inserter(result));
+            merged = std::move(result);
+        }
+        mEdgePoints[edgeIdx] = std::move(merged);
+    }
+}
+
+void TriangleDetail::updateAllEdgePoints() {
+    mLayerEdgePoints.clear();
+    for(const auto& colorSetIt : mColoredPolys) {
+        updateLayerEdgePoints(colorSetIt.first);
+    }
+    mergeLayerEdgePoints();
 }
 
 TriangleDetail::Polygon pepr3d::TriangleDetail::polygonFromTriangle(const PeprTriangle& tri) const {
@@ -316,53 +583,194 @@ TriangleDetail::Polygon TriangleDetail::polygonFromTriangle(const Triangle2& tri
     return pgn;
 }
 
+TriangleDetail::Polygon TriangleDetail::snapToGrid(const Polygon& poly, double gridSize) const {
+    if(gridSize <= 0.0 || poly.is_empty()) {
+        return poly;
+    }
+
+    // Plane coordinates are measured in multiples of the (not normalized) plane bases. The steps are rounded to a few
+    // significant bits, so the snapped coordinates are integer multiples of short exact numbers.
+    const auto getStep = [gridSize](const K::FT& baseSquaredLength) {
+        const int stepBits = 16;
+        const double step = gridSize / std::sqrt(CGAL::to_double(baseSquaredLength));
+        int exponent;
+        std::frexp(step, &exponent);
+        return std::ldexp(std::round(std::ldexp(step, stepBits - exponent)), exponent - stepBits);
+    };
+    const double stepX = getStep(mOriginalPlane.base1().squared_length());
+    const double stepY = getStep(mOriginalPlane.base2().squared_length());
+    const auto snap = [](const K::FT& value, double step) {
+        return K::FT(std::round(CGAL::to_double(value) / step)) * K::FT(step);
+    };
+
+    Polygon result;
+    for(auto vertexIt = poly.vertices_begin(); vertexIt != poly.vertices_end(); ++vertexIt) {
+        Point2 pt = *vertexIt;
+        const bool isOnBounds = std::any_of(mBounds.edges_begin(), mBounds.edges_end(),
+                                            [&pt](const Segment2& edge) { return edge.has_on(pt); });
+        if(!isOnBounds) {
+            pt = Point2(snap(pt.x(), stepX), snap(pt.y(), stepY));
+        }
+
+        if(result.is_empty() || *std::prev(result.vertices_end()) != pt) {
+            result.push_back(pt);
+        }
+    }
+    while(result.size() > 1 && *result.vertices_begin() == *std::prev(result.vertices_end())) {
+        result.erase(std::prev(result.vertices_end()));
+    }
+
+    if(result.size() < 3 || result.area() == 0) {
+        return {};
+    }
+
+    // Snapping folds the shape if it intersects itself or turns inside out. A folded convex shape, e.g. a triangle
+    // of a stroke, is thinner than the grid, other shapes are kept exact.
+    if(!result.is_simple() || result.orientation() != poly.orientation()) {
+        return poly.is_convex() ? Polygon() : poly;
+    }
+
+    if(result.is_clockwise_oriented()) {
+        result.reverse_orientation();
+    }
+
+    P_ASSERT(CGAL::is_valid_polygon(result, Traits()));
+    return result;
+}
+
+std::vector<TriangleDetail::Point3> TriangleDetail::intersectSphereWithEdge(const PeprSphere& peprSphere,
+                                                                             const glm::vec3& first,
+                                                                             const glm::vec3& second) {
+    // The intersection is calculated using original world-space data, so that it is the same for both triangles of
+    // the edge
+    std::array<Point3, 2> vertices{toExactK(first), toExactK(second)};
+    if(vertices[0] >= vertices[1]) {
+        std::swap(vertices[0], vertices[1]);  // Makes sure the result of method calculation is same for both triangles
+    }
+
+    const Sphere sphere(toSphericalK(peprSphere.center()), peprSphere.squared_radius());
+    const SK::Line_3 triEdgeSpherical(toSphericalK(vertices[0]), toSphericalK(vertices[1]));
+    const Line3 triEdge(vertices[0], vertices[1]);
+
+    std::vector<CGAL::Object> intersections;
+    CGAL::intersection(sphere, triEdgeSpherical, std::back_inserter(intersections));
+
+    std::vector<Point3> result;
+    for(auto& obj : intersections) {
+        std::pair<SK::Circular_arc_point_3, unsigned> ptPair;
+        if(CGAL::assign(ptPair, obj)) {
+            const SK::Circular_arc_point_3& pt = ptPair.first;
+            const Point3 worldPoint(CGAL::to_double(pt.x()), CGAL::to_double(pt.y()),
+                                    CGAL::to_double(pt.z()));  // Cannot get exact
+
+            // Make sure the point is exactly on the line
+            result.push_back(triEdge.projection(worldPoint));
+        }
+    }
+    return result;
+}
+
+std::vector<TriangleDetail::Point3> TriangleDetail::intersectSweptSphereWithEdge(const PeprSphere& start,
+                                                                                  const PeprSphere& end,
+                                                                                  const glm::vec3& first,
+                                                                                  const glm::vec3& second) {
+    // Computed from world-space data in a fixed order of the vertices, like intersectSphereWithEdge()
+    std::array<PeprPoint3, 2> vertices{PeprPoint3(first.x, first.y, first.z), PeprPoint3(second.x, second.y, second.z)};
+    if(vertices[0] >= vertices[1]) {
+        std::swap(vertices[0], vertices[1]);
+    }
+    const PeprVector3 direction = vertices[1] - vertices[0];
+
+    // Parameters along the edge line where it enters or leaves a part of the swept sphere
+    std::vector<double> params;
+    const auto addRoots = [&params](double a, double halfB, double c, const auto& isOnBoundary) {
+        // Roots of a * s^2 + 2 * halfB * s + c = 0
+        const double discriminant = halfB * halfB - a * c;
+        if(a <= 0 || discriminant < 0) {
+            return;
+        }
+        for(const double root : {(-halfB - std::sqrt(discriminant)) / a, (-halfB + std::sqrt(discriminant)) / a}) {
+            if(isOnBoundary(root)) {
+                params.push_back(root);
+            }
+        }
+    };
+
+    // Spheres at both ends of the segment
+    for(const PeprSphere* sphere : {&start, &end}) {
+        const PeprVector3 toVertex = vertices[0] - sphere->center();
+        addRoots(direction.squared_length(), direction * toVertex, toVertex.squared_length() - sphere->squared_radius(),
+                 [](double) { return true; });
+    }
+
+    // Cylinder around the segment, only where its axis is between the ends
+    const PeprVector3 axis = end.center() - start.center();
+    const double axisSquaredLength = axis.squared_length();
+    if(axisSquaredLength > 0) {
+        const PeprVector3 toVertex = vertices[0] - start.center();
+        const double directionAlongAxis = direction * axis;
+        const double vertexAlongAxis = toVertex * axis;
+        addRoots(direction.squared_length() - directionAlongAxis * directionAlongAxis / axisSquaredLength,
+                 direction * toVertex - vertexAlongAxis * directionAlongAxis / axisSquaredLength,
+                 toVertex.squared_length() - vertexAlongAxis * vertexAlongAxis / axisSquaredLength -
+                     start.squared_radius(),
+                 [&](double param) {
+                     const double axisParam = (vertexAlongAxis + param * directionAlongAxis) / axisSquaredLength;
+                     return axisParam >= 0.0 && axisParam <= 1.0;
+                 });
+    }
+
+    if(params.empty()) {
+        return {};
+    }
+
+    // The swept sphere is convex, its intersection with the line is a single segment
+    const auto extremes = std::minmax_element(params.begin(), params.end());
+    const Line3 triEdge(toExactK(vertices[0]), toExactK(vertices[1]));
+    std::vector<Point3> result;
+    for(const double param : {*extremes.first, *extremes.second}) {
+        // Make sure the point is exactly on the line
+        result.push_back(triEdge.projection(toExactK(vertices[0] + param * direction)));
+    }
+    if(result.front() == result.back()) {
+        result.pop_back();
+    }
+    return result;
+}
+
+TriangleDetail::SphereEdgeIntersections TriangleDetail::intersectSphereWithEdges(const PeprSphere& sphere) const {
+    SphereEdgeIntersections result;
+    for(size_t i = 0; i < 3; i++) {
+        result[i] = intersectSphereWithEdge(sphere, mOriginal.getVertex(i), mOriginal.getVertex((i + 1) % 3));
+    }
+    return result;
+}
+
 std::vector<std::pair<TriangleDetail::Point2, double>> TriangleDetail::getCircleSharedPoints(
-    const Circle3& circle, const Vector3& xBase, const Vector3& yBase) const {
+    const Circle3& circle, const SphereEdgeIntersections& edgeIntersections, const Vector3& xBase,
+    const Vector3& yBase) const {
     // We need shared verticies on the boundary of triangle details
     // This vertex needs to be the same for both neighbouring triangles
-    // Thats why we calculate the intersection using original world-space data
 
-    Sphere sphere(circle.center(), circle.squared_radius());
+    const Point3 circleCenter = fromSphericalK(circle.center());
     std::vector<std::pair<Point2, double>> result;
 
-    // Find all points that intersect triangle edge
-    for(size_t i = 0; i < 3; i++) {
-        std::array<Point3, 2> vertices{toExactK(mOriginal.getVertex(i)), toExactK(mOriginal.getVertex((i + 1) % 3))};
-        if(vertices[0] >= vertices[1]) {
-            std::swap(vertices[0],
-                      vertices[1]);  // Makes sure the result of method calculation is same for both triangles
-        }
-
-        Line3 triEdge(vertices[0], vertices[1]);
-
-        std::vector<CGAL::Object> intersections;
-        auto intersection = CGAL::intersection(sphere, triEdge, std::back_inserter(intersections));
-
-        // Add both intersection points of this edge
-        for(auto& obj : intersections) {
-            std::pair<K::Circular_arc_point_3, unsigned> ptPair;
-            if(CGAL::assign(ptPair, obj)) {
-                K::Circular_arc_point_3& pt = ptPair.first;
-                Point3 worldPoint(CGAL::to_double(pt.x()), CGAL::to_double(pt.y()),
-                                  CGAL::to_double(pt.z()));  // Cannot get exact
-
-                // Make sure the point is exactly on the line
-                worldPoint = triEdge.projection(worldPoint);
-
-                // Project the vector onto the bases of the circle
-                const auto circleVector(worldPoint - circle.center());
-                auto xCoords = circleVector * xBase;
-                auto yCoords = circleVector * yBase;
-
-                // Find the circle angle that matches this point, so that we know where it belongs
-                // The angle is measured from the x-positive axis going counter clockwise. a \in (0, 2PI)
-                double circleAngle = std::atan2(CGAL::to_double(yCoords), CGAL::to_double(xCoords));
-                if(circleAngle < 0) {
-                    circleAngle += 2 * glm::pi<double>();
-                }
-
-                result.emplace_back(std::make_pair(mOriginalPlane.to_2d(worldPoint), circleAngle));
+    // Add intersection points of all triangle edges
+    for(const std::vector<Point3>& edgePoints : edgeIntersections) {
+        for(const Point3& worldPoint : edgePoints) {
+            // Project the vector onto the bases of the circle
+            const auto circleVector(worldPoint - circleCenter);
+            auto xCoords = circleVector * xBase;
+            auto yCoords = circleVector * yBase;
+
+            // Find the circle angle that matches this point, so that we know where it belongs
+            // The angle is measured from the x-positive axis going counter clockwise. a \in (0, 2PI)
+            double circleAngle = std::atan2(CGAL::to_double(yCoords), CGAL::to_double(xCoords));
+            if(circleAngle < 0) {
+                circleAngle += 2 * glm::pi<double>();
             }
+
+            result.emplace_back(std::make_pair(mOriginalPlane.to_2d(worldPoint), circleAngle));
         }
     }
 
@@ -371,11 +779,14 @@ std::vector<std::pair<TriangleDetail::Point2, double>> TriangleDetail::getCircle
     return result;
 }
 
-TriangleDetail::Polygon TriangleDetail::polygonFromCircle(const Circle3& circle, int minSegments) const {
+TriangleDetail::Polygon TriangleDetail::polygonFromCircle(const Circle3& circle, int minSegments,
+                                                          double chordTolerance,
+                                                          const SphereEdgeIntersections& edgeIntersections) const {
     P_ASSERT(minSegments >= 3);
 
     // Scale the vertex count based on the size of the circle
     const double radius = sqrt(CGAL::to_double(circle.squared_radius()));
+    const int segments = GeometryUtils::getCircleSegmentCount(radius, chordTolerance, minSegments);
 
     // Bases for the points of the circle (cannot be exact, because Epeck does not support sqrt)
     const auto xBase = mOriginalPlane.base1() / CGAL::sqrt(CGAL::to_double(mOriginalPlane.base1().squared_length()));
@@ -384,14 +795,16 @@ TriangleDetail::Polygon TriangleDetail::polygonFromCircle(const Circle3& circle,
 
     // We need a shared vertex on the boundary of triangle details
     // This vertex does not need to be exact, but needs to be the same from both triangles
-    std::vector<std::pair<Point2, double>> sharedPoints = getCircleSharedPoints(circle, xBase, yBase);
+    std::vector<std::pair<Point2, double>> sharedPoints =
+        getCircleSharedPoints(circle, edgeIntersections, xBase, yBase);
     auto sharedPointIt = sharedPoints.begin();
+    const Point3 circleCenter = fromSphericalK(circle.center());
 
     // Construct the polygon.
     Polygon pgn;
-    for(size_t i = 0; i < minSegments; i++) {
-        const double circleCoord = (static_cast<double>(i) / minSegments) * 2 * glm::pi<double>();
-        const Point3 pt = circle.center() + xBase * cos(circleCoord) * radius + yBase * sin(circleCoord) * radius;
+    for(size_t i = 0; i < segments; i++) {
+        const double circleCoord = (static_cast<double>(i) / segments) * 2 * glm::pi<double>();
+        const Point3 pt = circleCenter + xBase * cos(circleCoord) * radius + yBase * sin(circleCoord) * radius;
 
         // Add all shared points that are before this point
         while(sharedPointIt != sharedPoints.end() && sharedPointIt->second <= circleCoord) {
@@ -438,31 +851,149 @@ void TriangleDetail::addPolygonSet(PolygonSet& polySet, size_t color) {
     history.emplace_back(PolygonSetEntry{polySet, color});
 #endif
 
-    polySet.intersection(mBounds);
+    // Shapes inside the bounds do not need to be clipped
+    const auto& arrangement = polySet.arrangement();
+    const bool isInsideBounds = std::all_of(
+        arrangement.vertices_begin(), arrangement.vertices_end(),
+        [this](const auto& vertex) { return mBounds.bounded_side(vertex.point()) != CGAL::ON_UNBOUNDED_SIDE; });
+    if(!isInsideBounds) {
+        polySet.intersection(mBounds);
+    }
+    if(polySet.is_empty()) {
+        return;
+    }
 
     if(mColorChanged) {
         updatePolysFromTriangles();
     }
 
     // Add the shape to its color layer
-    mColoredPolys[color].join(polySet);
-
-    // Remove the new shape from other colors
+    PolygonSet& colorLayer = mColoredPolys[color];
+    colorLayer.join(polySet);
+    simplifyPolygonSet(colorLayer);
+    mLayerRanges.erase(color);
+    updateLayerEdgePoints(color);
+
+    // Remove the new shape from other colors, layers that lie outside of its bounding box cannot change
+    const CGAL::Bbox_2 shapeBox = getBoundingBox(polySet);
     for(auto& it : mColoredPolys) {
-        if(it.first != color) {
-            debugOnlyVerifyPolygonSet(it.second);
+        if(it.first == color || it.second.is_empty() || !CGAL::do_overlap(shapeBox, getBoundingBox(it.second))) {
+            continue;
+        }
 
-            it.second.difference(polySet);
+        debugOnlyVerifyPolygonSet(it.second);
 
-            debugOnlyVerifyPolygonSet(it.second);
-        }
+        it.second.difference(polySet);
+
+        debugOnlyVerifyPolygonSet(it.second);
+
+        simplifyPolygonSet(it.second);
+        mLayerRanges.erase(it.first);
+        updateLayerEdgePoints(it.first);
     }
+    mergeLayerEdgePoints();
 
-    simplifyPolygons();
     updateTrianglesFromPolygons();
+
+    if(++mOperationsSinceCompaction >= MAX_OPERATIONS_BEFORE_COMPACTION) {
+        compactExactValues();
+    }
+}
+
+bool TriangleDetail::polygonCoversBounds(const Polygon& poly) const {
+    if(!poly.is_convex()) {
+        return false;
+    }
+
+    return std::all_of(mBounds.vertices_begin(), mBounds.vertices_end(),
+                       [&poly](const Point2& pt) { return poly.bounded_side(pt) != CGAL::ON_UNBOUNDED_SIDE; });
 }
 
-TriangleDetail::Segment3 TriangleDetail::findSharedEdge(const TriangleDetail& other) {
+void TriangleDetail::fillWithColor(size_t color) {
+    mColoredPolys.clear();
+    mColoredPolys.emplace(color, PolygonSet(mBounds));
+    mLayerRanges.clear();
+    mColorChanged = false;
+    updateAllEdgePoints();
+
+    updateTrianglesFromPolygons();
+    mOperationsSinceCompaction++;
+}
+
+void TriangleDetail::compactExactValues() {
+    // Polygons are outdated when colors changed, they will be rebuilt from the compacted triangles
+    if(!mColorChanged) {
+        for(auto& colorSetIt : mColoredPolys) {
+            if(colorSetIt.second.is_empty())
+                continue;
+
+            std::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes());
+            colorSetIt.second.polygons_with_holes(polys.begin());
+            for(PolygonWithHoles& poly : polys) {
+                poly = fromRational(toRational(poly));
+            }
+
+            colorSetIt.second.clear();
+            colorSetIt.second.join(polys.begin(), polys.end());
+        }
+    }
+
+    // Vertices keep their values and order, layer ranges stay valid
+    for(Point2& vertex : mExactVertices) {
+        vertex = fromRational(toRational(vertex));
+    }
+
+    // Edge points keep their order too
+    for(auto& layerIt : mLayerEdgePoints) {
+        for(std::vector<Point3>& points : layerIt.second) {
+            for(Point3& point : points) {
+                point = fromRational(toRational(point));
+            }
+        }
+    }
+    for(std::vector<Point3>& points : mEdgePoints) {
+        for(Point3& point : points) {
+            point = fromRational(toRational(point));
+        }
+    }
+
+    mOperationsSinceCompaction = 0;
+}
+
+std::optional<size_t> TriangleDetail::getUniformColor() const {
+    if(mTriangles.empty()) {
+        return {};
+    }
+
+    // Layers split the triangle between them, a single non-empty layer covers all of it
+    if(!mColorChanged) {
+        const size_t nonEmptyLayers = std::count_if(mColoredPolys.begin(), mColoredPolys.end(),
+                                                    [](const auto& layerIt) { return !layerIt.second.is_empty(); });
+        if(nonEmptyLayers != 1) {
+            return {};
+        }
+    }
+
+    const size_t color = mTriangles.front().getColor();
+    const bool isUniform =
+        std::all_of(mTriangles.begin(), mTriangles.end(),
+                    [color](const DataTriangle& tri) { return tri.getColor() == color; }) &&
+        std::all_of(mDegenerateTriangles.begin(), mDegenerateTriangles.end(),
+                    [color](const DegenerateTriangle& degenerateTri) { return degenerateTri.color == color; });
+    if(!isUniform) {
+        return {};
+    }
+
+    // Only the two vertices of the triangle lie on each of its edges
+    if(std::any_of(mEdgePoints.begin(), mEdgePoints.end(),
+                   [](const std::vector<Point3>& points) { return points.size() > 2; })) {
+        return {};
+    }
+
+    return color;
+}
+
+TriangleDetail::Segment3 TriangleDetail::findSharedEdge(const TriangleDetail& other) const {
     std::array<PeprPoint3, 2> commonPoints;
     size_t pointsFound = 0;
 
@@ -484,11 +1015,13 @@ TriangleDetail::Segment3 TriangleDetail::findSharedEdge(const TriangleDetail& ot
 void TriangleDetail::updatePolysFromTriangles() {
     debugEdgeConsistencyCheck();
 
-    mColoredPolys = createPolygonSetsFromTriangles(mTrianglesExact);
+    mColoredPolys = createPolygonSetsFromTriangles(getExactTriangles());
+    mLayerRanges.clear();
     mColorChanged = false;
     debugEdgeConsistencyCheck();
 
     simplifyPolygons();
+    updateAllEdgePoints();
 }
 
 std::map<size_t, TriangleDetail::PolygonSet> TriangleDetail::createPolygonSetsFromTriangles(
@@ -570,40 +1103,134 @@ void TriangleDetail::markDomains(ConstrainedTriangulation& ct) {
     }
 }
 
-void TriangleDetail::addTrianglesFromPolygon(const PolygonWithHoles& poly, size_t color) {
-    std::vector<Triangle2> newTriangles = triangulatePolygon(poly);
+void TriangleDetail::addTrianglesFromPolygon(const PolygonWithHoles& poly, size_t color,
+                                             std::map<Point2, uint32_t>& vertexIndices) {
+    const std::vector<Triangle2> newTriangles = triangulatePolygon(poly);
+    const uint32_t polygonIdx = static_cast<uint32_t>(mPolygonCount++);
 
-    // Create new array for degenerate triangles
-    const size_t polygonId = mPolygonDegenerateTriangles.size();
-    mPolygonDegenerateTriangles.push_back({});
+    const auto getVertexIdx = [this, &vertexIndices](const Point2& pt) {
+        const auto insertResult = vertexIndices.emplace(pt, static_cast<uint32_t>(mExactVertices.size()));
+        if(insertResult.second) {
+            mExactVertices.push_back(pt);
+        }
+        return insertResult.first->second;
+    };
 
     // Store all triangles
-    for(Triangle2& exactTri : newTriangles) {
-        const size_t idxOfExactTri = mTrianglesExact.size();
+    for(const Triangle2& exactTri : newTriangles) {
+        const PackedTriangle vertices = {getVertexIdx(exactTri.vertex(0)), getVertexIdx(exactTri.vertex(1)),
+                                         getVertexIdx(exactTri.vertex(2))};
 
         const glm::vec3 a = toGlmVec(mOriginalPlane.to_3d(exactTri.vertex(0)));
         const glm::vec3 b = toGlmVec(mOriginalPlane.to_3d(exactTri.vertex(1)));
         const glm::vec3 c = toGlmVec(mOriginalPlane.to_3d(exactTri.vertex(2)));
-        DataTriangle tri(a, b, c, mOriginal.getNormal());
+        DataTriangle tri(a, b, c, mOriginal.getNormal(), color);
         if(!tri.getTri().is_degenerate()) {
             // Triangle is good
-            tri.setColor(color);
             mTriangles.emplace_back(std::move(tri));
-            mTrianglesToExactIdx.push_back(mTrianglesExact.size());
+            mTriangleVertices.push_back(vertices);
+            mTrianglePolygons.push_back(polygonIdx);
         } else {
             // Triangle degenerates
-            mPolygonDegenerateTriangles[polygonId].push_back(idxOfExactTri);
+            mDegenerateTriangles.push_back({vertices, polygonIdx, color});
         }
-
-        mTrianglesExact.emplace_back(std::move(exactTri), color, polygonId);
     }
 
-    P_ASSERT(mTriangles.size() == mTrianglesToExactIdx.size());
+    P_ASSERT(mTriangles.size() == mTriangleVertices.size());
 }
 
 std::vector<TriangleDetail::Triangle2> TriangleDetail::triangulatePolygon(const PolygonWithHoles& poly) {
     P_ASSERT(GeometryUtils::is_valid_polygon_with_holes(poly, Traits()));
 
+    if(!poly.has_holes()) {
+        std::vector<Triangle2> triangles = triangulateSimplePolygon(poly.outer_boundary());
+        if(!triangles.empty()) {
+            return triangles;
+        }
+    }
+
+    return triangulateConstrained(poly);
+}
+
+std::vector<TriangleDetail::Triangle2> TriangleDetail::triangulateSimplePolygon(const Polygon& poly) {
+    const size_t vertexCount = poly.size();
+    if(vertexCount < 3 || !poly.is_counterclockwise_oriented()) {
+        return {};
+    }
+
+    // Remaining vertices form a circular list
+    std::vector<size_t> prev(vertexCount);
+    std::vector<size_t> next(vertexCount);
+    for(size_t i = 0; i < vertexCount; ++i) {
+        prev[i] = (i + vertexCount - 1) % vertexCount;
+        next[i] = (i + 1) % vertexCount;
+    }
+    std::vector<bool> isRemoved(vertexCount, false);
+
+    // Only vertices that are not strictly convex can lie inside an ear of a convex polygon
+    std::vector<size_t> blockingVertices;
+    const bool isConvex = poly.is_convex();
+    for(size_t i = 0; i < vertexCount; ++i) {
+        if(!isConvex || CGAL::orientation(poly[prev[i]], poly[i], poly[next[i]]) != CGAL::LEFT_TURN) {
+            blockingVertices.push_back(i);
+        }
+    }
+
+    const auto isEar = [&](size_t vertexIdx) {
+        const Point2& a = poly[prev[vertexIdx]];
+        const Point2& b = poly[vertexIdx];
+        const Point2& c = poly[next[vertexIdx]];
+        if(CGAL::orientation(a, b, c) != CGAL::LEFT_TURN) {
+            return false;
+        }
+
+        // Vertices on the diagonal would split it, the ear cannot be cut off either
+        const Triangle2 ear(a, b, c);
+        return std::none_of(blockingVertices.begin(), blockingVertices.end(), [&](size_t otherIdx) {
+            return !isRemoved[otherIdx] && otherIdx != prev[vertexIdx] && otherIdx != vertexIdx &&
+                   otherIdx != next[vertexIdx] && ear.bounded_side(poly[otherIdx]) != CGAL::ON_UNBOUNDED_SIDE;
+        });
+    };
+
+    std::vector<Triangle2> triangles;
+    triangles.reserve(vertexCount - 2);
+
+    size_t vertexIdx = 1;
+    size_t remaining = vertexCount;
+    size_t failedAttempts = 0;
+    while(remaining > 3) {
+        if(failedAttempts >= remaining) {
+            // No ear left, the polygon is not simple
+            return {};
+        }
+
+        if(!isEar(vertexIdx)) {
+            vertexIdx = next[vertexIdx];
+            failedAttempts++;
+            continue;
+        }
+
+        triangles.emplace_back(poly[prev[vertexIdx]], poly[vertexIdx], poly[next[vertexIdx]]);
+        next[prev[vertexIdx]] = next[vertexIdx];
+        prev[next[vertexIdx]] = prev[vertexIdx];
+        isRemoved[vertexIdx] = true;
+        remaining--;
+        failedAttempts = 0;
+
+        // Continuing with the next vertex keeps a fan around the previous one
+        vertexIdx = next[vertexIdx];
+    }
+
+    const Triangle2 lastTriangle(poly[prev[vertexIdx]], poly[vertexIdx], poly[next[vertexIdx]]);
+    if(lastTriangle.orientation() != CGAL::POSITIVE) {
+        return {};
+    }
+    triangles.push_back(lastTriangle);
+
+    return triangles;
+}
+
+std::vector<TriangleDetail::Triangle2> TriangleDetail::triangulateConstrained(const PolygonWithHoles& poly) {
     std::vector<Triangle2> triangles;
 
     ConstrainedTriangulation ct;
@@ -637,10 +1264,20 @@ std::vector<TriangleDetail::Triangle2> TriangleDetail::triangulatePolygon(const
 }
 
 void TriangleDetail::updateTrianglesFromPolygons() {
+    std::vector<DataTriangle> oldTriangles = std::move(mTriangles);
+    const std::vector<Point2> oldExactVertices = std::move(mExactVertices);
+    const std::vector<PackedTriangle> oldTriangleVertices = std::move(mTriangleVertices);
+    const std::vector<uint32_t> oldTrianglePolygons = std::move(mTrianglePolygons);
+    const std::vector<DegenerateTriangle> oldDegenerateTriangles = std::move(mDegenerateTriangles);
+    const std::map<size_t, LayerRange> oldLayerRanges = std::move(mLayerRanges);
+
     mTriangles.clear();
-    mTrianglesToExactIdx.clear();
-    mTrianglesExact.clear();
-    mPolygonDegenerateTriangles.clear();
+    mExactVertices.clear();
+    mTriangleVertices.clear();
+    mTrianglePolygons.clear();
+    mDegenerateTriangles.clear();
+    mPolygonCount = 0;
+    mLayerRanges.clear();
 
     debugEdgeConsistencyCheck();
 
@@ -648,35 +1285,153 @@ void TriangleDetail::updateTrianglesFromPolygons() {
         if(colorSetIt.second.is_empty())
             continue;
 
-        std::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes());
-        colorSetIt.second.polygons_with_holes(polys.begin());
-        for(PolygonWithHoles& poly : polys) {
-            addTrianglesFromPolygon(poly, colorSetIt.first);
+        LayerRange range;
+        range.vertexBegin = mExactVertices.size();
+        range.triangleBegin = mTriangles.size();
+        range.degenerateBegin = mDegenerateTriangles.size();
+        range.polygonBegin = mPolygonCount;
+
+        auto oldRangeIt = oldLayerRanges.find(colorSetIt.first);
+        if(oldRangeIt != oldLayerRanges.end()) {
+            // Layer did not change, reuse its triangulation
+            spliceLayerTriangles(oldRangeIt->second, oldTriangles, oldExactVertices, oldTriangleVertices,
+                                 oldTrianglePolygons, oldDegenerateTriangles);
+        } else {
+            std::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes());
+            colorSetIt.second.polygons_with_holes(polys.begin());
+            std::map<Point2, uint32_t> vertexIndices;
+            for(PolygonWithHoles& poly : polys) {
+                addTrianglesFromPolygon(poly, colorSetIt.first, vertexIndices);
+            }
+        }
+
+        range.vertexEnd = mExactVertices.size();
+        range.triangleEnd = mTriangles.size();
+        range.degenerateEnd = mDegenerateTriangles.size();
+        range.polygonEnd = mPolygonCount;
+        mLayerRanges.emplace_hint(mLayerRanges.end(), colorSetIt.first, range);
+    }
+
+    // Details live long and there are many of them, do not keep the reserve of the growing arrays
+    mTriangles.shrink_to_fit();
+    mExactVertices.shrink_to_fit();
+    mTriangleVertices.shrink_to_fit();
+    mTrianglePolygons.shrink_to_fit();
+    mDegenerateTriangles.shrink_to_fit();
+
+    P_ASSERT(mTriangles.size() == mTriangleVertices.size());
+    P_ASSERT(mTriangles.size() == mTrianglePolygons.size());
+}
+
+void TriangleDetail::spliceLayerTriangles(const LayerRange& oldRange, std::vector<DataTriangle>& oldTriangles,
+                                          const std::vector<Point2>& oldExactVertices,
+                                          const std::vector<PackedTriangle>& oldTriangleVertices,
+                                          const std::vector<uint32_t>& oldTrianglePolygons,
+                                          const std::vector<DegenerateTriangle>& oldDegenerateTriangles) {
+    // Indices of the layer are shifted by the difference between its old and new start
+    const size_t vertexBegin = mExactVertices.size();
+    const size_t polygonBegin = mPolygonCount;
+    const auto toNewVertices = [&oldRange, vertexBegin](const PackedTriangle& oldVertices) {
+        PackedTriangle result;
+        for(size_t i = 0; i < result.size(); ++i) {
+            result[i] = static_cast<uint32_t>(oldVertices[i] - oldRange.vertexBegin + vertexBegin);
+        }
+        return result;
+    };
+    const auto toNewPolygon = [&oldRange, polygonBegin](uint32_t oldPolygonIdx) {
+        return static_cast<uint32_t>(oldPolygonIdx - oldRange.polygonBegin + polygonBegin);
+    };
+
+    mExactVertices.insert(mExactVertices.end(), oldExactVertices.begin() + oldRange.vertexBegin,
+                          oldExactVertices.begin() + oldRange.vertexEnd);
+
+    for(size_t triangleIdx = oldRange.triangleBegin; triangleIdx < oldRange.triangleEnd; ++triangleIdx) {
+        mTriangles.emplace_back(std::move(oldTriangles[triangleIdx]));
+        mTriangleVertices.push_back(toNewVertices(oldTriangleVertices[triangleIdx]));
+        mTrianglePolygons.push_back(toNewPolygon(oldTrianglePolygons[triangleIdx]));
+    }
+
+    for(size_t degenerateIdx = oldRange.degenerateBegin; degenerateIdx < oldRange.degenerateEnd; ++degenerateIdx) {
+        const DegenerateTriangle& oldDegenerateTri = oldDegenerateTriangles[degenerateIdx];
+        mDegenerateTriangles.push_back({toNewVertices(oldDegenerateTri.vertices),
+                                        toNewPolygon(oldDegenerateTri.polygonIdx), oldDegenerateTri.color});
+    }
+
+    mPolygonCount += oldRange.polygonEnd - oldRange.polygonBegin;
+    P_ASSERT(mTriangles.size() == mTriangleVertices.size());
+}
+
+std::vector<TriangleDetail::ExactTriangle> TriangleDetail::getExactTriangles() const {
+    std::vector<ExactTriangle> result;
+    result.reserve(mTriangles.size() + mDegenerateTriangles.size());
+
+    const auto toTriangle2 = [this](const PackedTriangle& vertices) {
+        return Triangle2(mExactVertices[vertices[0]], mExactVertices[vertices[1]], mExactVertices[vertices[2]]);
+    };
+
+    for(size_t triangleIdx = 0; triangleIdx < mTriangles.size(); ++triangleIdx) {
+        result.emplace_back(toTriangle2(mTriangleVertices[triangleIdx]), mTriangles[triangleIdx].getColor(),
+                            mTrianglePolygons[triangleIdx]);
+    }
+
+    for(const DegenerateTriangle& degenerateTri : mDegenerateTriangles) {
+        result.emplace_back(toTriangle2(degenerateTri.vertices), degenerateTri.color, degenerateTri.polygonIdx);
+    }
+
+    return result;
+}
+
+size_t TriangleDetail::getMemoryUsage() const {
+    // Lazy exact points keep an interval approximation next to the pointer to their exact value
+    const size_t exactPointSize = sizeof(K::Approximate_kernel::Point_2) + 2 * sizeof(void*);
+    const size_t exactPoint3Size = sizeof(K::Approximate_kernel::Point_3) + 2 * sizeof(void*);
+
+    size_t result = sizeof(TriangleDetail);
+    result += mTriangles.capacity() * sizeof(DataTriangle);
+    result += mExactVertices.capacity() * sizeof(Point2);  // Shared with the polygons
+    result += mTriangleVertices.capacity() * sizeof(PackedTriangle);
+    result += mTrianglePolygons.capacity() * sizeof(uint32_t);
+    result += mDegenerateTriangles.capacity() * sizeof(DegenerateTriangle);
+    result += mLayerRanges.size() * (sizeof(decltype(mLayerRanges)::value_type) + 4 * sizeof(void*));
+    result += mLayerEdgePoints.size() * (sizeof(decltype(mLayerEdgePoints)::value_type) + 4 * sizeof(void*));
+    for(const auto& layerIt : mLayerEdgePoints) {
+        for(const std::vector<Point3>& points : layerIt.second) {
+            result += points.capacity() * (sizeof(Point3) + exactPoint3Size);
         }
     }
+    for(const std::vector<Point3>& points : mEdgePoints) {
+        result += points.capacity() * sizeof(Point3);  // Shared with the layers
+    }
 
-    P_ASSERT(mTriangles.size() == mTrianglesToExactIdx.size());
+    for(const auto& colorSetIt : mColoredPolys) {
+        const auto& arrangement = colorSetIt.second.arrangement();
+        result += sizeof(decltype(mColoredPolys)::value_type) + 4 * sizeof(void*);
+        result += arrangement.number_of_vertices() * (sizeof(PolygonSet::Arrangement_2::Vertex) + exactPointSize);
+        result += arrangement.number_of_halfedges() * sizeof(PolygonSet::Arrangement_2::Halfedge);
+        result += arrangement.number_of_edges() * sizeof(Traits::X_monotone_curve_2);
+        result += arrangement.number_of_faces() * sizeof(PolygonSet::Arrangement_2::Face);
+    }
+
+    return result;
 }
 
 void TriangleDetail::setColor(size_t detailIdx, size_t color) {
     P_ASSERT(detailIdx < mTriangles.size());
-    P_ASSERT(mTriangles.size() == mTrianglesToExactIdx.size());
+    P_ASSERT(mTriangles.size() == mTrianglePolygons.size());
 
     if(mTriangles[detailIdx].getColor() != color) {
-        // Update the inexact representation
+        // The exact triangle is only an index into the vertices, color is read from the DataTriangle
         mTriangles[detailIdx].setColor(color);
 
-        // Update the exact representation
-        const size_t exactTriIdx = mTrianglesToExactIdx[detailIdx];
-        P_ASSERT(exactTriIdx < mTrianglesExact.size());
-        mTrianglesExact[exactTriIdx].color = color;
-
         // Also changle all degenerate triangles of this polygon to this colour
         // These are not otherwise accessible by DetailedTriangleId, but not coloring these
         // would prevent simplification in case of fill.
-        const size_t polygonIdx = mTrianglesExact[exactTriIdx].polygonIdx;
-        for(size_t exactDegTriIdx : mPolygonDegenerateTriangles[polygonIdx]) {
-            mTrianglesExact[exactDegTriIdx].color = color;
+        const uint32_t polygonIdx = mTrianglePolygons[detailIdx];
+        auto degenerateIt = std::lower_bound(
+            mDegenerateTriangles.begin(), mDegenerateTriangles.end(), polygonIdx,
+            [](const DegenerateTriangle& degenerateTri, uint32_t idx) { return degenerateTri.polygonIdx < idx; });
+        for(; degenerateIt != mDegenerateTriangles.end() && degenerateIt->polygonIdx == polygonIdx; ++degenerateIt) {
+            degenerateIt->color = color;
         }
 
         mColorChanged = true;
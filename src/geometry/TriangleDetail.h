@@ -13,7 +13,10 @@
 #include "geometry/GlmSerialization.h"
 #include "geometry/Triangle.h"
 
+#include <CGAL/Bbox_2.h>
+#include <CGAL/Cartesian_converter.h>
 #include <CGAL/Constrained_Delaunay_triangulation_2.h>
+#include <CGAL/Exact_predicates_exact_constructions_kernel.h>
 #include <CGAL/Exact_spherical_kernel_3.h>
 #include <CGAL/General_polygon_2.h>
 #include <CGAL/IO/io.h>
@@ -28,6 +31,9 @@
 
 #include <cereal/types/set.hpp>
 #include <cereal/types/vector.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <deque>
 #include <map>
 #include <optional>
@@ -50,13 +56,20 @@ namespace pepr3d {
  */
 class TriangleDetail {
    public:
-    using K = CGAL::Exact_spherical_kernel_3;
+    /// Kernel of all polygon operations and triangulations
+    using K = CGAL::Exact_predicates_exact_constructions_kernel;
+    /// Kernel used only to intersect spheres with the triangle. Its algebraic numbers are too slow for polygon
+    /// operations, so results are converted to K right away.
+    using SK = CGAL::Exact_spherical_kernel_3;
+    /// Rational representation of K objects, used for serialization
+    using RationalK = K::Exact_kernel;
+
     using Polygon = CGAL::Polygon_2<K>;
     using PolygonWithHoles = CGAL::Polygon_with_holes_2<K>;
     using GeneralPolygon = CGAL::General_polygon_2<K>;
     using Circle = TriangleDetail::K::Circle_2;
-    using Circle3 = TriangleDetail::K::Circle_3;
-    using Sphere = TriangleDetail::K::Sphere_3;
+    using Circle3 = TriangleDetail::SK::Circle_3;
+    using Sphere = TriangleDetail::SK::Sphere_3;
     using Triangle2 = TriangleDetail::K::Triangle_2;
 
     using PolygonSet = CGAL::Polygon_set_2<K>;
@@ -134,8 +147,8 @@ class TriangleDetail {
     };
 
     struct PointEntry {
-        std::set<Point3> myPoints;
-        std::set<Point3> theirPoints;
+        std::vector<Point3> myPoints;
+        std::vector<Point3> theirPoints;
         Segment3 sharedEdge;
 
         template <typename Archive>
@@ -163,35 +176,86 @@ class TriangleDetail {
         mOriginalPlane = Plane(toExactK(tri.vertex(0)), toExactK(tri.vertex(1)), toExactK(tri.vertex(2)));
         mBounds = polygonFromTriangle(mOriginal.getTri());
         mTriangles.push_back(mOriginal);
-        mTrianglesToExactIdx.push_back(0);
 
-        std::array<Point2, 3> exactPoints;
         for(int i = 0; i < 3; i++) {
-            exactPoints[i] = mOriginalPlane.to_2d(toExactK(mOriginal.getTri().vertex(i)));
+            mExactVertices.push_back(mOriginalPlane.to_2d(toExactK(mOriginal.getTri().vertex(i))));
         }
-        mTrianglesExact.emplace_back(Triangle2(exactPoints[0], exactPoints[1], exactPoints[2]), original.getColor(), 0);
+        mTriangleVertices.push_back({0, 1, 2});
+        mTrianglePolygons.push_back(0);
+        mPolygonCount = 1;
         mColoredPolys.emplace(mOriginal.getColor(), PolygonSet(mBounds));
-        mPolygonDegenerateTriangles.push_back({});
+        mLayerRanges.emplace(mOriginal.getColor(), LayerRange{0, 3, 0, 1, 0, 0, 0, 1});
+        updateAllEdgePoints();
     }
 
     // Cereal requires default constructor
     TriangleDetail() = default;
 
+    /// Number of paint operations after which the exact coordinates get compacted, see compactExactValues()
+    static constexpr size_t MAX_OPERATIONS_BEFORE_COMPACTION = 64;
+
+    /// Points where a sphere intersects the lines of the three edges of the original triangle, edge i goes from
+    /// vertex i to vertex i + 1. Neighbouring details must get exactly the same points on their shared edge.
+    using SphereEdgeIntersections = std::array<std::vector<Point3>, 3>;
+
+    /// Segment of a stroke painted by paintSweptSphere(), a segment with the same sphere at both ends paints just
+    /// the sphere
+    struct SweptSegment {
+        PeprSphere start;
+        PeprSphere end;
+        /// Intersections of the spheres with the edges, computed by the detail if null
+        const SphereEdgeIntersections* startEdgeIntersections = nullptr;
+        const SphereEdgeIntersections* endEdgeIntersections = nullptr;
+    };
+
+    /// Polygon with holes in world space, e.g. an outline of a letter. Holes lie inside the boundary.
+    struct PolygonOutline {
+        std::vector<PeprPoint3> boundary;
+        std::vector<std::vector<PeprPoint3>> holes;
+    };
+
+    /// Points where the sphere intersects the line of the edge, the same for both orders of the vertices
+    static std::vector<Point3> intersectSphereWithEdge(const PeprSphere& sphere, const glm::vec3& first,
+                                                       const glm::vec3& second);
+
+    /// Ends of the part of the line of the edge inside the sphere swept from start to end, the same for both orders
+    /// of the vertices
+    static std::vector<Point3> intersectSweptSphereWithEdge(const PeprSphere& start, const PeprSphere& end,
+                                                            const glm::vec3& first, const glm::vec3& second);
+
     /// Paint sphere onto this detail
     /// @param minSegments Minimum number of segments of each sphere/plane intersection. Additional points may be added
     /// on boundaries.
-    void paintSphere(const PeprSphere& sphere, int minSegments, size_t color);
+    /// @param gridSize Size of the grid the shape is snapped to in model units, 0 keeps the exact shape. See
+    /// snapToGrid()
+    /// @param edgeIntersections Intersections of the sphere with the edges shared with the neighbours, computed by
+    /// the detail if null
+    /// @param chordTolerance Maximal distance of the painted polygon from the real circle in model units, picks the
+    /// number of segments from the radius of the circle instead of minSegments. 0 uses minSegments.
+    void paintSphere(const PeprSphere& sphere, int minSegments, size_t color, double gridSize = 0.0,
+                     const SphereEdgeIntersections* edgeIntersections = nullptr, double chordTolerance = 0.0);
+
+    /// Paint the shape swept by a sphere moving along a stroke onto this detail. Shapes of all segments are joined
+    /// first and added with a single polygon operation.
+    /// @param minSegments Minimum number of segments of each sphere/plane intersection, see paintSphere()
+    /// @param chordTolerance Tolerance of the circles, see paintSphere()
+    void paintSweptSphere(const std::vector<SweptSegment>& segments, int minSegments, size_t color,
+                          double gridSize = 0.0, double chordTolerance = 0.0);
 
     /// Paint a shape to triangle detail
     /// @param shape Collection of points that form a polygon, that is going to be projected onto the TriangleDetail
     /// @param direction Direction vector of the projection
-    void paintShape(const std::vector<PeprPoint3>& shape, const PeprVector3& direction, size_t color);
+    /// @param gridSize Size of the grid the shape is snapped to in model units, 0 keeps the exact shape
+    void paintShape(const std::vector<PeprPoint3>& shape, const PeprVector3& direction, size_t color,
+                    double gridSize = 0.0);
 
-    /// Paint a shape to triangle detail
-    /// @param triangles Collection of triangles that form a shape, that is going to be projected onto the
-    /// TriangleDetail
+    /// Paint a union of shapes to triangle detail, the detail is modified only once for all of them
+    /// @param shapes Outlines of each shape, that are going to be projected onto the TriangleDetail
     /// @param direction Direction vector of the projection
-    void paintShape(const std::vector<PeprTriangle>& triangles, const PeprVector3& direction, size_t color);
+    /// @param gridSize Size of the grid the shapes are snapped to in model units, 0 keeps the exact shapes. Outlines
+    /// whose holes do not survive the snapping are painted exactly.
+    void paintShapes(const std::vector<const std::vector<PolygonOutline>*>& shapes, const PeprVector3& direction,
+                     size_t color, double gridSize = 0.0);
 
     /// Makes sure all vertices on the common edge between these two triangles are matched
     /// Creates new vertices for both triangles if there are missing
@@ -199,6 +263,11 @@ class TriangleDetail {
     /// @return <bool,bool> true if points were added to a triangle
     std::pair<bool, bool> correctSharedVertices(TriangleDetail& other);
 
+    /// Do both triangles already have the same vertices on their common edge?
+    /// Unlike correctSharedVertices() this does not modify either detail. Returns false when the polygonal
+    /// representation is outdated, as the answer cannot be given without recomputing it.
+    bool hasMatchingSharedVertices(const TriangleDetail& other) const;
+
     const std::vector<DataTriangle>& getTriangles() const {
         return mTriangles;
     }
@@ -208,7 +277,8 @@ class TriangleDetail {
     }
 
     /// Create new triangles from a set of colored polygons
-    /// Tries to simplify the polygons in the process
+    /// Only color layers that changed since the last call are triangulated again, triangles of the other layers are
+    /// reused.
     void updateTrianglesFromPolygons();
 
     /// Set color of a detail triangle
@@ -223,7 +293,30 @@ class TriangleDetail {
     void addPolygonSet(PolygonSet& polySet, size_t color);
 
     /// Find all points of polygons that are on the edge
-    std::set<Point3> findPointsOnEdge(const Segment3& edge);
+    /// @param edge Edge of the original triangle
+    /// @return Points sorted by std::less<Point3>, which also orders them along the edge
+    const std::vector<Point3>& findPointsOnEdge(const Segment3& edge) const;
+
+    /// Replace all exact coordinates with fresh values computed from their rational representation.
+    /// Every lazy exact construction keeps a reference to its inputs, so after many operations each vertex carries a
+    /// deep history that makes every predicate slower and keeps growing in memory. Runs automatically every
+    /// MAX_OPERATIONS_BEFORE_COMPACTION operations, call it at the end of a stroke too.
+    void compactExactValues();
+
+    /// Was the detail modified since the exact coordinates were last compacted?
+    bool hasUncompactedOperations() const {
+        return mOperationsSinceCompaction > 0;
+    }
+
+    /// Approximate number of bytes used by the detail. Exact numbers are counted by the size of their representation,
+    /// memory of the numbers themselves is not included.
+    size_t getMemoryUsage() const;
+
+    /// Color of the detail if a single color covers the whole original triangle and the detail can be replaced by a
+    /// simple triangle. Details that carry extra vertices on the triangle edges are kept, they match the vertices of
+    /// neighbouring details.
+    /// @return Empty if the detail has more than one color or has extra vertices on its edges
+    std::optional<size_t> getUniformColor() const;
 
     template <class Archive>
     void save(Archive& archive) const {
@@ -243,6 +336,9 @@ class TriangleDetail {
         mOriginalPlane = Plane(toExactK(tri.vertex(0)), toExactK(tri.vertex(1)), toExactK(tri.vertex(2)));
         mBounds = polygonFromTriangle(mOriginal.getTri());
 
+        mLayerRanges.clear();
+        mOperationsSinceCompaction = 0;
+        updateAllEdgePoints();
         updateTrianglesFromPolygons();
     }
 
@@ -286,12 +382,75 @@ class TriangleDetail {
         return toGlmVec(toNormalK(point));
     }
 
-    static double exactToDbl(const CGAL::Gmpq& num) {
-        return num.to_double();
+    template <typename NT>
+    static double exactToDbl(const NT& num) {
+        return CGAL::to_double(num);
+    }
+
+    /// Convert Point_3 from Pepr3d kernel to the spherical kernel
+    inline static SK::Point_3 toSphericalK(const PeprPoint3& point) {
+        return SK::Point_3(point.x(), point.y(), point.z());
+    }
+
+    /// Convert Point_3 from Exact kernel to the spherical kernel
+    inline static SK::Point_3 toSphericalK(const Point3& point) {
+        return SK::Point_3(CGAL::exact(point.x()), CGAL::exact(point.y()), CGAL::exact(point.z()));
+    }
+
+    /// Convert Plane_3 from Exact kernel to the spherical kernel
+    inline static SK::Plane_3 toSphericalK(const Plane& plane) {
+        return SK::Plane_3(CGAL::exact(plane.a()), CGAL::exact(plane.b()), CGAL::exact(plane.c()),
+                           CGAL::exact(plane.d()));
     }
 
-    static double exactToDbl(const CGAL::Gmpz& num) {
-        return num.to_double();
+    /// Convert Point_3 from the spherical kernel to Exact kernel
+    inline static Point3 fromSphericalK(const SK::Point_3& point) {
+        return Point3(K::FT(point.x()), K::FT(point.y()), K::FT(point.z()));
+    }
+
+    /// Rational representation of a kernel object
+    template <typename KernelObject>
+    static auto toRational(const KernelObject& obj) {
+        return CGAL::exact(obj);
+    }
+
+    static CGAL::Polygon_2<RationalK> toRational(const Polygon& poly) {
+        CGAL::Polygon_2<RationalK> result;
+        for(auto vertexIt = poly.vertices_begin(); vertexIt != poly.vertices_end(); ++vertexIt) {
+            result.push_back(CGAL::exact(*vertexIt));
+        }
+        return result;
+    }
+
+    static CGAL::Polygon_with_holes_2<RationalK> toRational(const PolygonWithHoles& poly) {
+        CGAL::Polygon_with_holes_2<RationalK> result(toRational(poly.outer_boundary()));
+        for(auto holeIt = poly.holes_begin(); holeIt != poly.holes_end(); ++holeIt) {
+            result.add_hole(toRational(*holeIt));
+        }
+        return result;
+    }
+
+    /// Create a kernel object from its rational representation
+    /// The result does not share any lazy evaluation history with other objects.
+    template <typename RationalObject>
+    static auto fromRational(const RationalObject& obj) {
+        return CGAL::Cartesian_converter<RationalK, K>()(obj);
+    }
+
+    static Polygon fromRational(const CGAL::Polygon_2<RationalK>& poly) {
+        Polygon result;
+        for(auto vertexIt = poly.vertices_begin(); vertexIt != poly.vertices_end(); ++vertexIt) {
+            result.push_back(fromRational(*vertexIt));
+        }
+        return result;
+    }
+
+    static PolygonWithHoles fromRational(const CGAL::Polygon_with_holes_2<RationalK>& poly) {
+        PolygonWithHoles result(fromRational(poly.outer_boundary()));
+        for(auto holeIt = poly.holes_begin(); holeIt != poly.holes_end(); ++holeIt) {
+            result.add_hole(fromRational(*holeIt));
+        }
+        return result;
     }
 
     /// Creates a map of [ColorID, PolygonSet] of polygon sets made of provided triangles
@@ -301,9 +460,28 @@ class TriangleDetail {
         const std::vector<ExactTriangle>& trianglesExact);
 
     /// Break down a polygon into an array of triangles
+    /// Polygons without holes are ear clipped, the constrained triangulation is used for the rest.
     /// @return vector of exact triangles that make up the polygon
     static std::vector<Triangle2> triangulatePolygon(const PolygonWithHoles& poly);
 
+    /// Does changeColorIds() change any color of this detail
+    /// @param ColorFunc functor of type size_t func(size_t originalColor), that returns the new color ID
+    template <typename ColorFunc>
+    bool changesColorIds(const ColorFunc& colorFunc) const {
+        const auto isChanged = [&colorFunc](size_t color) { return colorFunc(color) != color; };
+        if(!mColorChanged) {
+            for(const auto& coloredSetIt : mColoredPolys) {
+                if(isChanged(coloredSetIt.first)) {
+                    return true;
+                }
+            }
+        }
+        return std::any_of(mDegenerateTriangles.begin(), mDegenerateTriangles.end(),
+                           [&isChanged](const DegenerateTriangle& tri) { return isChanged(tri.color); }) ||
+               std::any_of(mTriangles.begin(), mTriangles.end(),
+                           [&isChanged](const DataTriangle& tri) { return isChanged(tri.getColor()); });
+    }
+
     /// Change color IDs of this detail
     /// @param ColorFunc functor of type size_t func(size_t originalColor), that returns the new color ID
     template <typename ColorFunc>
@@ -315,11 +493,15 @@ class TriangleDetail {
                 coloredPolygonSets[colorFunc(coloredSetIt.first)].join(coloredSetIt.second);
             }
             mColoredPolys = std::move(coloredPolygonSets);
+            updateAllEdgePoints();
         }
 
+        // Layers may have been merged, triangulate all of them again
+        mLayerRanges.clear();
+
         // Color of some triangles has been changed, polygon representation is old
-        for(ExactTriangle& exactTri : mTrianglesExact) {
-            exactTri.color = colorFunc(exactTri.color);
+        for(DegenerateTriangle& degenerateTri : mDegenerateTriangles) {
+            degenerateTri.color = colorFunc(degenerateTri.color);
         }
 
         for(DataTriangle& dataTri : mTriangles) {
@@ -328,26 +510,68 @@ class TriangleDetail {
     }
 
    private:
+    /// Exact triangle stored as indices into mExactVertices
+    using PackedTriangle = std::array<uint32_t, 3>;
+
+    /// Exact triangle that degenerates when represented as a DataTriangle. It has no DataTriangle, but its area still
+    /// needs a color when the polygons are rebuilt from the triangles.
+    struct DegenerateTriangle {
+        PackedTriangle vertices;
+        uint32_t polygonIdx;
+        size_t color;
+    };
+
     /// Temporary storage for DataTriangles.  This gets overwritten on every time updateTrianglesFromPolygons() is run.
     /// Triangles stored here are non-degenerate triangles that roughly make up the original triangle.
     /// Becasue DataTriangle is using a limited-precission, these triangles cannot be used to reconstruct the surface.
     std::vector<DataTriangle> mTriangles;
 
-    /// Stores index of exact triangle to every DataTriangle of this detail (mTriangles.size() ==
-    /// mTrianglesToExactIdx.size()) Every DataTriangle in this detail has matching exact triangle. But not all exact
-    /// triangles have a DataTriange - some degenerate.
-    std::vector<size_t> mTrianglesToExactIdx;
+    /// Vertices of the exact triangulation, each stored once per color layer. The points share their representation
+    /// with the polygons they were triangulated from.
+    std::vector<Point2> mExactVertices;
+
+    /// Exact triangle of every DataTriangle (mTriangles.size() == mTriangleVertices.size()). Epeck triangles are only
+    /// created from these when the polygons need to be rebuilt after a color change, see getExactTriangles().
+    std::vector<PackedTriangle> mTriangleVertices;
 
-    /// Stores epeck triangles. This gets overwritten on every time updateTrianglesFromPolygons() is run.
-    /// This is used for saving andpolygonset reconstruction
-    std::vector<ExactTriangle> mTrianglesExact;
+    /// Index of the polygon every DataTriangle was triangulated from (mTriangles.size() == mTrianglePolygons.size())
+    std::vector<uint32_t> mTrianglePolygons;
 
-    /// Stores index into mTrianglesExact of every degenerate triangle(when represented as DataTriangle), grouped by the
-    /// polygon it belongs to.
-    std::vector<std::vector<size_t>> mPolygonDegenerateTriangles;
+    /// Triangles that degenerate as DataTriangle, sorted by the polygon they belong to
+    std::vector<DegenerateTriangle> mDegenerateTriangles;
+
+    /// Number of polygons triangulated by the last updateTrianglesFromPolygons()
+    size_t mPolygonCount = 0;
 
     std::map<size_t, PolygonSet> mColoredPolys;
 
+    /// Part of the triangle arrays that was created from a single color layer
+    struct LayerRange {
+        size_t vertexBegin;
+        size_t vertexEnd;
+        size_t triangleBegin;
+        size_t triangleEnd;
+        size_t degenerateBegin;
+        size_t degenerateEnd;
+        size_t polygonBegin;
+        size_t polygonEnd;
+    };
+
+    /// Color layers whose triangles are up to date with mColoredPolys. Triangles of each layer are stored contiguously.
+    /// A layer missing from this map has changed and needs to be triangulated again.
+    std::map<size_t, LayerRange> mLayerRanges;
+
+    /// Points of the polygons on each edge of the original triangle, edge i goes from vertex i to vertex i + 1.
+    /// Sorted by std::less<Point3>, so points shared by two details compare with a single linear merge.
+    using EdgePoints = std::array<std::vector<Point3>, 3>;
+
+    /// Edge points of each color layer, kept up to date whenever the layer changes. Layers without any points on the
+    /// edges are not stored.
+    std::map<size_t, EdgePoints> mLayerEdgePoints;
+
+    /// Union of the edge points of all layers
+    EdgePoints mEdgePoints;
+
     DataTriangle mOriginal;
 #ifdef PEPR3D_COLLECT_DEBUG_DATA
     std::vector<HistoryEntry> history;
@@ -362,13 +586,24 @@ class TriangleDetail {
     /// Did color of any detail triangle change since last triangulation?
     bool mColorChanged = false;
 
-    /// Get points of a circle that are shared with border triangles
-    std::vector<std::pair<Point2, double>> getCircleSharedPoints(const Circle3& circle, const Vector3& xBase,
-                                                                 const Vector3& yBase) const;
+    /// Number of operations that created new exact coordinates since the last compactExactValues()
+    size_t mOperationsSinceCompaction = 0;
+
+    /// Intersection of the sphere with the plane of the original triangle, empty if it is not a circle
+    std::optional<Circle3> intersectWithPlane(const PeprSphere& sphere) const;
+
+    /// Intersections of the sphere with all three edges of the original triangle
+    SphereEdgeIntersections intersectSphereWithEdges(const PeprSphere& sphere) const;
+
+    /// Get points of a circle that are shared with border triangles, sorted by their angle on the circle
+    /// @param edgeIntersections Intersections of the sphere of the circle with the edges
+    std::vector<std::pair<Point2, double>> getCircleSharedPoints(const Circle3& circle,
+                                                                 const SphereEdgeIntersections& edgeIntersections,
+                                                                 const Vector3& xBase, const Vector3& yBase) const;
 
    private:
     /// Find shared edge between triangles
-    Segment3 findSharedEdge(const TriangleDetail& other);
+    Segment3 findSharedEdge(const TriangleDetail& other) const;
 
     Polygon projectShapeToPolygon(const std::vector<PeprPoint3>& shape, const PeprVector3& direction);
 
@@ -388,11 +623,24 @@ class TriangleDetail {
 #endif
             /// Add points that are missing to our polygons
     /// @return true if any points were added
-    bool addMissingPoints(const std::set<Point3>& myPoints, const std::set<Point3>& theirPoints,
+    /// @param myPoints Points of this detail on the shared edge, sorted as returned by findPointsOnEdge()
+    /// @param theirPoints Points of the other detail on the shared edge, sorted the same way
+    bool addMissingPoints(const std::vector<Point3>& myPoints, const std::vector<Point3>& theirPoints,
                           const Segment3& sharedEdge);
 
     /// Construct a polygon from a circle.
-    Polygon polygonFromCircle(const Circle3& circle, int segments) const;
+    /// @param chordTolerance Picks the number of segments from the radius, see GeometryUtils::getCircleSegmentCount()
+    /// @param edgeIntersections Intersections of the sphere of the circle with the edges, added as vertices
+    Polygon polygonFromCircle(const Circle3& circle, int segments, double chordTolerance,
+                              const SphereEdgeIntersections& edgeIntersections) const;
+
+    /// Triangulate a simple polygon without holes by ear clipping, convex polygons end up as a fan.
+    /// Collinear vertices stay vertices of the triangles, so vertices shared with neighbouring details are kept.
+    /// @return Empty if the polygon is not counterclockwise or no ear could be found
+    static std::vector<Triangle2> triangulateSimplePolygon(const Polygon& poly);
+
+    /// Triangulate a polygon with holes using a constrained triangulation
+    static std::vector<Triangle2> triangulateConstrained(const PolygonWithHoles& poly);
 
     /// Create a polygon from a PeprTriangle
     Polygon polygonFromTriangle(const PeprTriangle& tri) const;
@@ -400,16 +648,60 @@ class TriangleDetail {
     /// Create a polygon from 2D triangle in plane coordinates
     static Polygon polygonFromTriangle(const Triangle2& tri);
 
+    /// Snap vertices of the polygon to a grid in the plane of this detail.
+    /// Snapped coordinates are integer multiples of an exact step with a short mantissa, which keeps the exact polygon
+    /// operations cheap. Vertices on the bounds are shared with neighbouring details and stay exact.
+    /// @param gridSize Size of the grid cell in model units, 0 returns the polygon unchanged
+    /// @return Empty polygon if the shape is smaller than the grid, also if snapping folds a convex shape. The original
+    /// polygon if snapping folds a non-convex shape.
+    Polygon snapToGrid(const Polygon& poly, double gridSize) const;
+
    private:
     /// Simplify polygons, removing any vertices that are collinear
     void simplifyPolygons();
 
+    /// Is the whole triangle inside the polygon? Only detected for convex polygons.
+    bool polygonCoversBounds(const Polygon& poly) const;
+
+    /// Replace all color layers with a single color covering the whole triangle
+    void fillWithColor(size_t color);
+
+    /// Simplify polygons of a single color layer
+    static void simplifyPolygonSet(PolygonSet& polySet);
+
+    /// Index of the edge of the original triangle, see mEdgePoints
+    size_t findEdgeIdx(const Segment3& edge) const;
+
+    /// Recompute edge points of a single color layer, call mergeLayerEdgePoints() afterwards
+    void updateLayerEdgePoints(size_t color);
+
+    /// Recompute mEdgePoints from the edge points of the layers
+    void mergeLayerEdgePoints();
+
+    /// Recompute edge points of all color layers
+    void updateAllEdgePoints();
+
+    /// Bounding box of all vertices of the polygon set, the set must not be empty
+    static CGAL::Bbox_2 getBoundingBox(const PolygonSet& polySet);
+
+    /// Move triangles of an unchanged layer from the previous triangle arrays to the current ones
+    void spliceLayerTriangles(const LayerRange& oldRange, std::vector<DataTriangle>& oldTriangles,
+                              const std::vector<Point2>& oldExactVertices,
+                              const std::vector<PackedTriangle>& oldTriangleVertices,
+                              const std::vector<uint32_t>& oldTrianglePolygons,
+                              const std::vector<DegenerateTriangle>& oldDegenerateTriangles);
+
+    /// Create Epeck triangles of the whole triangulation, with their current colors
+    std::vector<ExactTriangle> getExactTriangles() const;
+
     /// Generate one colored polygon set for each color inside the triangle
     /// This is a slow operation
     void updatePolysFromTriangles();
 
     /// Add triangles from this polygon to our triangles
-    void addTrianglesFromPolygon(const PolygonWithHoles& poly, size_t color);
+    /// @param vertexIndices Indices of the vertices in mExactVertices that were already added for this color layer
+    void addTrianglesFromPolygon(const PolygonWithHoles& poly, size_t color,
+                                 std::map<Point2, uint32_t>& vertexIndices);
 
     /// ( From CGAL User Manual )
     /// ---------------------------
@@ -425,7 +717,7 @@ class TriangleDetail {
             return circle;
         }
 
-        std::optional<Circle3> operator()(const Point3) const {
+        std::optional<Circle3> operator()(const SK::Point_3) const {
             return {};
         }
     };
@@ -533,8 +825,9 @@ template <typename Archive, typename CGALType,
                                   std::is_same<CGALType, pepr3d::TriangleDetail::Segment3>::value ||
                                   std::is_same<CGALType, pepr3d::TriangleDetail::Segment2>::value>::type* = nullptr>
 void save(Archive& archive, const CGALType& val) {
+    // Lazy kernel objects would only print their approximation
     std::stringstream stream;
-    stream << val;
+    stream << pepr3d::TriangleDetail::toRational(val);
     archive(stream.str());
 }
 template <typename Archive, typename CGALType,
@@ -550,7 +843,9 @@ void load(Archive& archive, CGALType& val) {
     archive(str);
     std::stringstream stream(str);
     stream.seekg(stream.beg);
-    stream >> val;
+    std::decay_t<decltype(pepr3d::TriangleDetail::toRational(val))> rationalVal;
+    stream >> rationalVal;
+    val = pepr3d::TriangleDetail::fromRational(rationalVal);
 }
 
 template <typename Archive>
@@ -561,7 +856,7 @@ void save(Archive& archive, const pepr3d::TriangleDetail::PolygonSet& pset) {
     std::stringstream sstream;
     sstream << pset.number_of_polygons_with_holes();
     for(auto& poly : polys) {
-        sstream << " " << poly;
+        sstream << " " << pepr3d::TriangleDetail::toRational(poly);
     }
 
     archive(sstream.str());
@@ -575,9 +870,12 @@ void load(Archive& archive, pepr3d::TriangleDetail::PolygonSet& pset) {
     size_t numPolys;
     sstream >> numPolys;
 
-    std::vector<pepr3d::TriangleDetail::PolygonWithHoles> polys(numPolys);
+    std::vector<pepr3d::TriangleDetail::PolygonWithHoles> polys;
+    polys.reserve(numPolys);
     for(size_t i = 0; i < numPolys; ++i) {
-        sstream >> polys[i];
+        CGAL::Polygon_with_holes_2<pepr3d::TriangleDetail::RationalK> rationalPoly;
+        sstream >> rationalPoly;
+        polys.emplace_back(pepr3d::TriangleDetail::fromRational(rationalPoly));
     }
 
     pset.clear();
@@ -12,8 +12,12 @@
 #include <CGAL/Spherical_kernel_intersections.h>
 #include <CGAL/partition_2.h>
 
+#include <cereal/archives/binary.hpp>
 #include <cereal/archives/json.hpp>
 #include <cereal/types/map.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <random>
 #include <set>
 
@@ -24,6 +28,15 @@ using Polygon = TriangleDetail::Polygon;
 using PolygonSet = TriangleDetail::PolygonSet;
 using Triangle2 = TriangleDetail::Triangle2;
 
+/// Return the area of the detail triangles of each color
+std::map<size_t, double> getAreaByColor(const TriangleDetail& detail) {
+    std::map<size_t, double> result;
+    for(const DataTriangle& detailTri : detail.getTriangles()) {
+        result[detailTri.getColor()] += std::sqrt(detailTri.getTri().squared_area());
+    }
+    return result;
+}
+
 TEST(TriangleDetail, ConstructionSteps) {
     auto mTraits = std::make_unique<TriangleDetail::PolygonSet::Traits_2>();
 
@@ -231,6 +244,8 @@ TEST(TriangleDetail, TriangleDetailOperations) {
         ASSERT_NO_THROW(jsonArchive(history));
     }
 
+    // Replaying the recorded history doubles as a benchmark of the polygon operations
+    const auto startTime = std::chrono::high_resolution_clock::now();
     for(size_t i = 0; i < history.size(); i++) {
         HistoryEntry& entry = history[i];
 
@@ -256,6 +271,80 @@ TEST(TriangleDetail, TriangleDetailOperations) {
 
         ASSERT_TRUE(false);
     }
+    const auto endTime = std::chrono::high_resolution_clock::now();
+    RecordProperty("ReplayMs", std::to_string(std::chrono::duration<double, std::milli>(endTime - startTime).count()));
+}
+
+TEST(TriangleDetail, EdgePointIndex) {
+    /**
+     * Replay the shared points of the recorded history and make sure the incrementally updated edge points match the
+     * points found by a detail loaded from scratch
+     */
+    using HistoryEntry = TriangleDetail::HistoryEntry;
+    using PolygonEntry = TriangleDetail::PolygonEntry;
+    using PointEntry = TriangleDetail::PointEntry;
+    using Point3 = TriangleDetail::Point3;
+    using Segment3 = TriangleDetail::Segment3;
+
+    std::stringstream peprTriStream("-0.5 -0.5 0.5 0.5 -0.5 0.5 0.5 0.5 0.5");
+    TriangleDetail::PeprTriangle peprTri;
+    peprTriStream >> peprTri;
+
+    const DataTriangle tri(TriangleDetail::toGlmVec(peprTri.vertex(0)), TriangleDetail::toGlmVec(peprTri.vertex(1)),
+                           TriangleDetail::toGlmVec(peprTri.vertex(2)), glm::vec3(1, 0, 0), 0);
+    std::array<Segment3, 3> edges;
+    for(size_t i = 0; i < 3; i++) {
+        edges[i] = Segment3(TriangleDetail::toExactK(peprTri.vertex(i)),
+                            TriangleDetail::toExactK(peprTri.vertex((i + 1) % 3)));
+    }
+
+    std::ifstream testFile("./tests/addMissingPoints.json", std::ios::in);
+    ASSERT_TRUE(testFile.good());
+
+    std::vector<HistoryEntry> history;
+    {
+        cereal::JSONInputArchive jsonArchive(testFile);
+        ASSERT_NO_THROW(jsonArchive(history));
+    }
+
+    TriangleDetail triDetail(tri);
+    for(const Segment3& edge : edges) {
+        EXPECT_EQ(triDetail.findPointsOnEdge(edge).size(), 2);
+    }
+
+    for(HistoryEntry& entry : history) {
+        if(boost::get<PolygonEntry>(&entry)) {
+            PolygonEntry& pe = boost::get<PolygonEntry>(entry);
+            ASSERT_NO_THROW(triDetail.addPolygon(pe.polygon, pe.color));
+            continue;
+        }
+        if(!boost::get<PointEntry>(&entry)) {
+            continue;
+        }
+
+        PointEntry& pe = boost::get<PointEntry>(entry);
+        const std::vector<Point3> myPoints = triDetail.findPointsOnEdge(pe.sharedEdge);
+        ASSERT_NO_THROW(triDetail.addMissingPoints(myPoints, pe.theirPoints, pe.sharedEdge));
+
+        // All points of the other detail are on our edge now
+        const std::vector<Point3>& edgePoints = triDetail.findPointsOnEdge(pe.sharedEdge);
+        EXPECT_TRUE(std::is_sorted(edgePoints.begin(), edgePoints.end()));
+        EXPECT_TRUE(std::includes(edgePoints.begin(), edgePoints.end(), pe.theirPoints.begin(), pe.theirPoints.end()));
+
+        std::stringstream stream;
+        {
+            cereal::BinaryOutputArchive saveArchive(stream);
+            saveArchive(triDetail);
+        }
+        TriangleDetail loadedDetail;
+        {
+            cereal::BinaryInputArchive loadArchive(stream);
+            loadArchive(loadedDetail);
+        }
+        for(const Segment3& edge : edges) {
+            EXPECT_EQ(triDetail.findPointsOnEdge(edge), loadedDetail.findPointsOnEdge(edge));
+        }
+    }
 }
 
 TEST(TriangleDetail, UpdatePolysFromTriangles) {
@@ -356,6 +445,404 @@ TEST(TriangleDetail, UpdateTrianglesFromPolys) {
     EXPECT_TRUE(TriangleDetail::isEdgeTraversable(bounds.vertex(2), bounds.vertex(0), dummyPolygonSets));
 }
 
+TEST(TriangleDetail, FastTriangulation) {
+    /**
+     * Ear clipping of simple polygons has to tile the same area as the constrained triangulation and keep all
+     * vertices, including the collinear ones shared with neighbouring details
+     */
+    using Segment2 = TriangleDetail::Segment2;
+
+    const auto makePolygon = [](const std::vector<Point2>& points) { return Polygon(points.begin(), points.end()); };
+    const std::vector<Polygon> polygons = {
+        // Convex, becomes a fan
+        makePolygon({Point2(0, 0), Point2(2, 0), Point2(3, 1), Point2(2, 2), Point2(0, 2), Point2(-1, 1)}),
+        // Convex with extra vertices on the edges
+        makePolygon({Point2(0, 0), Point2(1, 0), Point2(2, 0), Point2(3, 0), Point2(3, 1), Point2(3, 3),
+                     Point2(1.5, 3), Point2(0, 3), Point2(0, 0.5)}),
+        // Concave with collinear vertices
+        makePolygon({Point2(0, 0), Point2(4, 0), Point2(4, 1), Point2(2, 1), Point2(1, 1), Point2(1, 3),
+                     Point2(1, 4), Point2(0, 4), Point2(0, 2)}),
+        // Star
+        makePolygon({Point2(0, -3), Point2(1, -1), Point2(3, 0), Point2(1, 1), Point2(0, 3), Point2(-1, 1),
+                     Point2(-3, 0), Point2(-1, -1)}),
+    };
+
+    for(const Polygon& poly : polygons) {
+        ASSERT_TRUE(poly.is_simple());
+        ASSERT_TRUE(poly.is_counterclockwise_oriented());
+
+        const std::vector<Triangle2> triangles = TriangleDetail::triangulateSimplePolygon(poly);
+        ASSERT_EQ(triangles.size(), poly.size() - 2);
+
+        TriangleDetail::K::FT area = 0;
+        for(const Triangle2& tri : triangles) {
+            EXPECT_FALSE(tri.is_degenerate());
+            area += tri.area();
+
+            // No vertex of the polygon may split an edge of a triangle
+            for(int i = 0; i < 3; i++) {
+                const Segment2 edge(tri.vertex(i), tri.vertex(i + 1));
+                for(const Point2& pt : poly.container()) {
+                    EXPECT_FALSE(pt != edge.source() && pt != edge.target() && edge.has_on(pt));
+                }
+            }
+        }
+        EXPECT_EQ(area, poly.area());
+
+        TriangleDetail::K::FT constrainedArea = 0;
+        for(const Triangle2& tri : TriangleDetail::triangulateConstrained(PolygonWithHoles(poly))) {
+            constrainedArea += tri.area();
+        }
+        EXPECT_EQ(area, constrainedArea);
+
+        // Clockwise polygons fall back to the constrained triangulation
+        Polygon reversed = poly;
+        reversed.reverse_orientation();
+        EXPECT_TRUE(TriangleDetail::triangulateSimplePolygon(reversed).empty());
+    }
+
+    // Polygons with holes always use the constrained triangulation
+    PolygonWithHoles polyWithHole(polygons[1]);
+    polyWithHole.add_hole(makePolygon({Point2(1, 1), Point2(1, 2), Point2(2, 2), Point2(2, 1)}));
+    TriangleDetail::K::FT holeArea = 0;
+    for(const Triangle2& tri : TriangleDetail::triangulatePolygon(polyWithHole)) {
+        holeArea += tri.area();
+    }
+    EXPECT_EQ(holeArea, polygons[1].area() - 1);
+}
+
+TEST(TriangleDetail, BrushDabsOverColorLayers) {
+    /**
+     * Paints a stroke of small dabs over a detail split into many color layers.
+     * Only layers touched by a dab are triangulated again, the result must match triangulating all layers from scratch.
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprVector3 = TriangleDetail::PeprVector3;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    const PeprVector3 direction(0, 0, -1);
+
+    for(const size_t layerCount : {8, 16}) {
+        TriangleDetail triDetail(tri);
+
+        // Vertical stripes, one for each color
+        const double stripeWidth = 1.0 / layerCount;
+        for(size_t color = 1; color < layerCount; ++color) {
+            const double left = -0.5 + color * stripeWidth;
+            const std::vector<PeprPoint3> stripe = {PeprPoint3(left, -1, 1), PeprPoint3(left + stripeWidth, -1, 1),
+                                                    PeprPoint3(left + stripeWidth, 1, 1), PeprPoint3(left, 1, 1)};
+            triDetail.paintShape(stripe, direction, color);
+        }
+
+        // Horizontal stroke across all stripes
+        const size_t dabCount = 32;
+        const auto startTime = std::chrono::high_resolution_clock::now();
+        for(size_t dab = 0; dab < dabCount; ++dab) {
+            const double x = -0.45 + 0.9 * dab / dabCount;
+            const TriangleDetail::PeprSphere sphere(PeprPoint3(x, -0.3, 0.5), 0.02 * 0.02);
+            triDetail.paintSphere(sphere, 12, dab % layerCount);
+        }
+        const auto endTime = std::chrono::high_resolution_clock::now();
+        RecordProperty("DabsWith" + std::to_string(layerCount) + "LayersMs",
+                       std::to_string(std::chrono::duration<double, std::milli>(endTime - startTime).count()));
+
+        // Loading triangulates every layer again
+        std::stringstream sstream;
+        {
+            cereal::JSONOutputArchive outArchive(sstream);
+            outArchive(triDetail);
+        }
+        TriangleDetail loadedDetail;
+        {
+            cereal::JSONInputArchive inArchive(sstream);
+            inArchive(loadedDetail);
+        }
+
+        const std::map<size_t, double> areas = getAreaByColor(triDetail);
+        const std::map<size_t, double> loadedAreas = getAreaByColor(loadedDetail);
+        EXPECT_EQ(triDetail.getTriangles().size(), loadedDetail.getTriangles().size());
+        ASSERT_EQ(areas.size(), layerCount);
+        ASSERT_EQ(loadedAreas.size(), layerCount);
+        for(const auto& areaIt : areas) {
+            EXPECT_NEAR(areaIt.second, loadedAreas.at(areaIt.first), 1e-9);
+        }
+    }
+}
+
+TEST(TriangleDetail, LongPaintingSessionOnSingleTriangle) {
+    /**
+     * Paints the same set of overlapping dabs many times over a single triangle.
+     * The shape complexity stays the same, so thanks to the compaction of exact values the late dabs must not get
+     * much slower than the early ones. The timings are only reported, the detail must not grow between the passes.
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using Clock = std::chrono::high_resolution_clock;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    TriangleDetail triDetail(tri);
+
+    const size_t dabsPerPass = 16;
+    const size_t passCount = 20;
+    std::vector<double> passTimes;
+    std::vector<size_t> passTriangleCounts;
+    std::vector<size_t> passMemoryUsages;
+    for(size_t pass = 0; pass < passCount; ++pass) {
+        const auto startTime = Clock::now();
+        for(size_t dab = 0; dab < dabsPerPass; ++dab) {
+            const double x = -0.2 + 0.6 * dab / dabsPerPass;
+            const TriangleDetail::PeprSphere sphere(PeprPoint3(x, -0.25, 0.5), 0.05 * 0.05);
+            triDetail.paintSphere(sphere, 16, (pass + dab) % 3);
+        }
+        passTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - startTime).count());
+        passTriangleCounts.push_back(triDetail.getTriangles().size());
+        passMemoryUsages.push_back(triDetail.getMemoryUsage());
+    }
+
+    const double firstPasses = passTimes[1] + passTimes[2] + passTimes[3];
+    const double lastPasses = passTimes[passCount - 3] + passTimes[passCount - 2] + passTimes[passCount - 1];
+    RecordProperty("FirstPassesMs", std::to_string(firstPasses));
+    RecordProperty("LastPassesMs", std::to_string(lastPasses));
+
+    // Colors repeat every 3 passes, so do the painted shapes
+    for(size_t pass = 4; pass < passCount; ++pass) {
+        EXPECT_LE(passTriangleCounts[pass], 2 * passTriangleCounts[pass - 3]);
+        EXPECT_LE(passMemoryUsages[pass], 2 * passMemoryUsages[pass - 3]);
+    }
+
+    // Compaction must not change the triangles
+    const std::vector<DataTriangle> trianglesBefore = triDetail.getTriangles();
+    triDetail.compactExactValues();
+    EXPECT_FALSE(triDetail.hasUncompactedOperations());
+    const std::vector<DataTriangle>& trianglesAfter = triDetail.getTriangles();
+    ASSERT_EQ(trianglesBefore.size(), trianglesAfter.size());
+    for(size_t i = 0; i < trianglesBefore.size(); ++i) {
+        EXPECT_EQ(trianglesBefore[i].getTri(), trianglesAfter[i].getTri());
+        EXPECT_EQ(trianglesBefore[i].getColor(), trianglesAfter[i].getColor());
+    }
+
+    // Painting continues to work on the compacted values
+    const TriangleDetail::PeprSphere sphere(PeprPoint3(0.2, -0.2, 0.5), 0.1 * 0.1);
+    ASSERT_NO_THROW(triDetail.paintSphere(sphere, 16, 3));
+    EXPECT_TRUE(triDetail.hasUncompactedOperations());
+}
+
+TEST(TriangleDetail, GridSnapping) {
+    /**
+     * Paints the brush dab scenario with shapes snapped to a grid and compares it to the exact painting
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprVector3 = TriangleDetail::PeprVector3;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    const PeprVector3 direction(0, 0, -1);
+    const double gridSize = 0.01;
+
+    const auto paint = [&](TriangleDetail& triDetail, double grid) {
+        const std::vector<PeprPoint3> stripe = {PeprPoint3(0.0, -1, 1), PeprPoint3(0.2, -1, 1), PeprPoint3(0.2, 1, 1),
+                                                PeprPoint3(0.0, 1, 1)};
+        triDetail.paintShape(stripe, direction, 1, grid);
+        for(size_t dab = 0; dab < 16; ++dab) {
+            const TriangleDetail::PeprSphere sphere(PeprPoint3(-0.2 + 0.04 * dab, -0.3, 0.5), 0.05 * 0.05);
+            triDetail.paintSphere(sphere, 16, 2 + dab % 2, grid);
+        }
+    };
+
+    TriangleDetail exactDetail(tri);
+    paint(exactDetail, 0.0);
+    TriangleDetail snappedDetail(tri);
+    paint(snappedDetail, gridSize);
+
+    const std::map<size_t, double> exactAreas = getAreaByColor(exactDetail);
+    const std::map<size_t, double> snappedAreas = getAreaByColor(snappedDetail);
+    ASSERT_EQ(exactAreas.size(), snappedAreas.size());
+
+    double snappedTotal = 0;
+    for(const auto& areaIt : snappedAreas) {
+        // Boundaries of the shapes move by at most half of a grid cell diagonal
+        EXPECT_NEAR(areaIt.second, exactAreas.at(areaIt.first), 0.05);
+        snappedTotal += areaIt.second;
+    }
+    EXPECT_NEAR(snappedTotal, 0.5, 1e-6);
+
+    // Snapping keeps points on the bounds and removes shapes smaller than the grid
+    using PeprTriangle = TriangleDetail::PeprTriangle;
+    const Polygon edgeShape = snappedDetail.polygonFromTriangle(PeprTriangle(
+        PeprPoint3(0.1234567, -0.5, 0.5), PeprPoint3(0.2345678, -0.4, 0.5), PeprPoint3(0.1234567, -0.3, 0.5)));
+    const Polygon snappedEdgeShape = snappedDetail.snapToGrid(edgeShape, gridSize);
+    ASSERT_EQ(snappedEdgeShape.size(), 3u);
+    EXPECT_EQ(std::count(snappedEdgeShape.vertices_begin(), snappedEdgeShape.vertices_end(), edgeShape.vertex(0)) +
+                  std::count(snappedEdgeShape.vertices_begin(), snappedEdgeShape.vertices_end(), edgeShape.vertex(1)) +
+                  std::count(snappedEdgeShape.vertices_begin(), snappedEdgeShape.vertices_end(), edgeShape.vertex(2)),
+              1);
+
+    const Polygon tinyShape = snappedDetail.polygonFromTriangle(PeprTriangle(
+        PeprPoint3(0.1001, -0.2, 0.5), PeprPoint3(0.1002, -0.2, 0.5), PeprPoint3(0.1002, -0.1999, 0.5)));
+    EXPECT_TRUE(snappedDetail.snapToGrid(tinyShape, gridSize).is_empty());
+
+    // A sliver that snapping turns inside out is removed instead of being kept exact
+    const Polygon sliverShape = snappedDetail.polygonFromTriangle(PeprTriangle(
+        PeprPoint3(0.1, -0.2, 0.5), PeprPoint3(0.3, -0.1949, 0.5), PeprPoint3(0.2, -0.1951, 0.5)));
+    EXPECT_FALSE(sliverShape.is_empty());
+    EXPECT_TRUE(snappedDetail.snapToGrid(sliverShape, gridSize).is_empty());
+}
+
+TEST(TriangleDetail, GridSnappingKeepsHoles) {
+    /**
+     * Paints an outline with a hole smaller than the grid, the outline is painted exactly instead of filled
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprVector3 = TriangleDetail::PeprVector3;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    TriangleDetail::PolygonOutline outline;
+    outline.boundary = {PeprPoint3(0.1, -0.4, 1), PeprPoint3(0.4, -0.4, 1), PeprPoint3(0.4, -0.1, 1),
+                        PeprPoint3(0.1, -0.1, 1)};
+    outline.holes = {{PeprPoint3(0.2502, -0.2548, 1), PeprPoint3(0.2548, -0.2548, 1), PeprPoint3(0.2548, -0.2502, 1),
+                      PeprPoint3(0.2502, -0.2502, 1)}};
+    const std::vector<TriangleDetail::PolygonOutline> shape = {outline};
+
+    TriangleDetail triDetail(tri);
+    triDetail.paintShapes({&shape}, PeprVector3(0, 0, -1), 1, 0.01);
+
+    EXPECT_NEAR(getAreaByColor(triDetail).at(1), 0.09 - 0.0046 * 0.0046, 1e-9);
+}
+
+TEST(TriangleDetail, RecolorWithPackedTriangulation) {
+    /**
+     * Recolors detail triangles and rebuilds the polygons from the packed exact triangulation, then checks the areas
+     * and reports the memory used by the detail
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprVector3 = TriangleDetail::PeprVector3;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    TriangleDetail triDetail(tri);
+    const size_t initialMemory = triDetail.getMemoryUsage();
+
+    for(size_t dab = 0; dab < 16; ++dab) {
+        const TriangleDetail::PeprSphere sphere(PeprPoint3(-0.2 + 0.04 * dab, -0.3, 0.5), 0.05 * 0.05);
+        triDetail.paintSphere(sphere, 16, 1 + dab % 2);
+    }
+    const size_t paintedMemory = triDetail.getMemoryUsage();
+    RecordProperty("PaintedTriangles", std::to_string(triDetail.getTriangles().size()));
+    RecordProperty("PaintedBytes", std::to_string(paintedMemory));
+    RecordProperty("BytesPerTriangle", std::to_string(paintedMemory / triDetail.getTriangles().size()));
+    EXPECT_GT(paintedMemory, initialMemory);
+
+    const std::map<size_t, double> areas = getAreaByColor(triDetail);
+    ASSERT_EQ(areas.size(), 3u);
+
+    // Recolor the second color, saving rebuilds the polygons from the triangles
+    for(size_t detailIdx = 0; detailIdx < triDetail.getTriangles().size(); ++detailIdx) {
+        if(triDetail.getTriangles()[detailIdx].getColor() == 2) {
+            triDetail.setColor(detailIdx, 3);
+        }
+    }
+
+    std::stringstream sstream;
+    {
+        cereal::JSONOutputArchive outArchive(sstream);
+        outArchive(triDetail);
+    }
+    TriangleDetail loadedDetail;
+    {
+        cereal::JSONInputArchive inArchive(sstream);
+        inArchive(loadedDetail);
+    }
+
+    const std::map<size_t, double> loadedAreas = getAreaByColor(loadedDetail);
+    ASSERT_EQ(loadedAreas.size(), 3u);
+    EXPECT_NEAR(loadedAreas.at(0), areas.at(0), 1e-9);
+    EXPECT_NEAR(loadedAreas.at(1), areas.at(1), 1e-9);
+    EXPECT_NEAR(loadedAreas.at(3), areas.at(2), 1e-9);
+
+    // Painting over everything releases the triangulation
+    const std::vector<PeprPoint3> cover = {PeprPoint3(-1, -1, 1), PeprPoint3(1, -1, 1), PeprPoint3(1, 1, 1),
+                                           PeprPoint3(-1, 1, 1)};
+    loadedDetail.paintShape(cover, PeprVector3(0, 0, -1), 4);
+    EXPECT_EQ(loadedDetail.getTriangles().size(), 1u);
+    EXPECT_LE(loadedDetail.getMemoryUsage(), initialMemory);
+}
+
+TEST(TriangleDetail, UniformColor) {
+    /**
+     * Tests when a painted detail can be replaced by a simple triangle of a single color
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprVector3 = TriangleDetail::PeprVector3;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    const TriangleDetail::PeprSphere sphere(PeprPoint3(0.2, -0.2, 0.5), 0.1 * 0.1);
+
+    TriangleDetail triDetail(tri);
+    EXPECT_EQ(triDetail.getUniformColor(), std::optional<size_t>(0));
+
+    triDetail.paintSphere(sphere, 16, 1);
+    EXPECT_FALSE(triDetail.getUniformColor());
+
+    // Painting over the dab with the original color
+    triDetail.paintSphere(sphere, 16, 0);
+    EXPECT_EQ(triDetail.getUniformColor(), std::optional<size_t>(0));
+
+    // Coloring all detail triangles
+    triDetail.paintSphere(sphere, 16, 1);
+    for(size_t detailIdx = 0; detailIdx < triDetail.getTriangles().size(); ++detailIdx) {
+        triDetail.setColor(detailIdx, 2);
+    }
+    EXPECT_EQ(triDetail.getUniformColor(), std::optional<size_t>(2));
+
+    // Vertices on the edges are kept for the neighbouring triangles
+    TriangleDetail stripeDetail(tri);
+    const std::vector<PeprPoint3> stripe = {PeprPoint3(0.0, -1, 1), PeprPoint3(0.2, -1, 1), PeprPoint3(0.2, 1, 1),
+                                            PeprPoint3(0.0, 1, 1)};
+    stripeDetail.paintShape(stripe, PeprVector3(0, 0, -1), 1);
+    for(size_t detailIdx = 0; detailIdx < stripeDetail.getTriangles().size(); ++detailIdx) {
+        stripeDetail.setColor(detailIdx, 1);
+    }
+    EXPECT_FALSE(stripeDetail.getUniformColor());
+}
+
+TEST(TriangleDetail, AdaptiveCircleSegments) {
+    /**
+     * Tests that the number of vertices of a painted dab follows the chord tolerance instead of the fixed count
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    const double tolerance = 0.0005;
+
+    // A dab inside the triangle is a convex polygon triangulated as a fan
+    const auto getDabTriangleCount = [&tri](double radius, double chordTolerance) {
+        TriangleDetail triDetail(tri);
+        const TriangleDetail::PeprSphere sphere(PeprPoint3(0.2, -0.2, 0.5), radius * radius);
+        triDetail.paintSphere(sphere, 16, 1, 0.0, nullptr, chordTolerance);
+        const std::vector<DataTriangle>& triangles = triDetail.getTriangles();
+        return std::count_if(triangles.begin(), triangles.end(),
+                             [](const DataTriangle& detailTri) { return detailTri.getColor() == 1; });
+    };
+
+    EXPECT_EQ(getDabTriangleCount(0.05, 0.0), 16 - 2);
+    EXPECT_EQ(getDabTriangleCount(0.2, 0.0), 16 - 2);
+
+    long previousCount = 0;
+    for(const double radius : {0.005, 0.0125, 0.05, 0.2}) {
+        const long triangleCount = getDabTriangleCount(radius, tolerance);
+        EXPECT_EQ(triangleCount, GeometryUtils::getCircleSegmentCount(radius, tolerance, 16) - 2);
+        EXPECT_GT(triangleCount, previousCount);
+        previousCount = triangleCount;
+    }
+
+    // Small dabs need fewer vertices than the fixed count
+    EXPECT_LT(getDabTriangleCount(0.005, tolerance), getDabTriangleCount(0.005, 0.0));
+}
+
 TEST(TriangleDetail, ValidPolygonWithHoles) {
     /**
      * This valid PolygonWithHoles causes a CGAL Precondition fail.
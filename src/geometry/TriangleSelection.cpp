@@ -0,0 +1,131 @@
+#include "geometry/TriangleSelection.h"
+
+#include <algorithm>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+TriangleSelection::TriangleSelection(std::vector<DetailedTriangleId> triangleIds) {
+    std::vector<size_t> baseIds;
+    std::map<size_t, std::vector<size_t>> detailIds;
+    for(const DetailedTriangleId& triangleId : triangleIds) {
+        if(triangleId.getDetailId()) {
+            detailIds[triangleId.getBaseId()].push_back(*triangleId.getDetailId());
+        } else {
+            baseIds.push_back(triangleId.getBaseId());
+        }
+    }
+
+    mBaseRanges = makeRanges(baseIds);
+    for(auto& detailIt : detailIds) {
+        mDetailRanges.emplace_hint(mDetailRanges.end(), detailIt.first, makeRanges(detailIt.second));
+    }
+    removeCoveredDetails();
+}
+
+TriangleSelection::TriangleSelection(std::vector<size_t> baseIds) : mBaseRanges(makeRanges(baseIds)) {}
+
+void TriangleSelection::insert(const TriangleSelection& other) {
+    mBaseRanges = mergeRanges(mBaseRanges, other.mBaseRanges);
+    for(const auto& detailIt : other.mDetailRanges) {
+        RangeList& ranges = mDetailRanges[detailIt.first];
+        ranges = mergeRanges(ranges, detailIt.second);
+    }
+    removeCoveredDetails();
+}
+
+bool TriangleSelection::contains(DetailedTriangleId triangleId) const {
+    if(containsId(mBaseRanges, triangleId.getBaseId())) {
+        return true;
+    }
+
+    if(!triangleId.getDetailId()) {
+        return false;
+    }
+
+    auto detailIt = mDetailRanges.find(triangleId.getBaseId());
+    return detailIt != mDetailRanges.end() && containsId(detailIt->second, *triangleId.getDetailId());
+}
+
+size_t TriangleSelection::size() const {
+    size_t result = 0;
+    for(const Range& range : mBaseRanges) {
+        result += range.size();
+    }
+    for(const auto& detailIt : mDetailRanges) {
+        for(const Range& range : detailIt.second) {
+            result += range.size();
+        }
+    }
+    return result;
+}
+
+TriangleSelection::RangeList TriangleSelection::splitRanges(const RangeList& ranges, size_t maxSize) {
+    P_ASSERT(maxSize > 0);
+    RangeList result;
+    for(const Range& range : ranges) {
+        for(size_t begin = range.begin; begin < range.end; begin += maxSize) {
+            result.push_back({begin, std::min(begin + maxSize, range.end)});
+        }
+    }
+    return result;
+}
+
+TriangleSelection::RangeList TriangleSelection::makeRanges(std::vector<size_t>& ids) {
+    std::sort(ids.begin(), ids.end());
+
+    RangeList result;
+    for(size_t id : ids) {
+        if(!result.empty() && id <= result.back().end) {
+            // Duplicate ids are already covered by the range
+            result.back().end = std::max(result.back().end, id + 1);
+        } else {
+            result.push_back({id, id + 1});
+        }
+    }
+    return result;
+}
+
+TriangleSelection::RangeList TriangleSelection::mergeRanges(const RangeList& first, const RangeList& second) {
+    RangeList result;
+    result.reserve(first.size() + second.size());
+
+    const auto addRange = [&result](const Range& range) {
+        if(!result.empty() && range.begin <= result.back().end) {
+            result.back().end = std::max(result.back().end, range.end);
+        } else {
+            result.push_back(range);
+        }
+    };
+
+    auto firstIt = first.begin();
+    auto secondIt = second.begin();
+    while(firstIt != first.end() || secondIt != second.end()) {
+        if(secondIt == second.end() || (firstIt != first.end() && firstIt->begin < secondIt->begin)) {
+            addRange(*firstIt++);
+        } else {
+            addRange(*secondIt++);
+        }
+    }
+    return result;
+}
+
+bool TriangleSelection::containsId(const RangeList& ranges, size_t id) {
+    // First range that ends after the id
+    auto rangeIt = std::upper_bound(ranges.begin(), ranges.end(), id,
+                                    [](size_t value, const Range& range) { return value < range.end; });
+    return rangeIt != ranges.end() && rangeIt->begin <= id;
+}
+
+void TriangleSelection::removeCoveredDetails() {
+    for(auto detailIt = mDetailRanges.begin(); detailIt != mDetailRanges.end();) {
+        if(detailIt->second.empty() || containsId(mBaseRanges, detailIt->first)) {
+            detailIt = mDetailRanges.erase(detailIt);
+        } else {
+            ++detailIt;
+        }
+    }
+}
+
+}  // namespace pepr3d
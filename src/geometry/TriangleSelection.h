@@ -0,0 +1,99 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "geometry/TrianglePrimitive.h"
+
+namespace pepr3d {
+
+/// Set of triangles, stored compactly as sorted ranges of consecutive triangle ids.
+/// Base triangles and detailed triangles of each base are kept separately, selecting a whole base triangle takes
+/// precedence over its detailed triangles.
+class TriangleSelection {
+   public:
+    /// Half-open range [begin, end) of triangle ids
+    struct Range {
+        size_t begin;
+        size_t end;
+
+        size_t size() const {
+            return end - begin;
+        }
+
+        bool operator==(const Range& other) const {
+            return begin == other.begin && end == other.end;
+        }
+    };
+
+    /// Sorted, non-overlapping and non-adjacent ranges
+    using RangeList = std::vector<Range>;
+
+    TriangleSelection() = default;
+
+    /// Select the triangles, ids may be in any order and repeat
+    explicit TriangleSelection(std::vector<DetailedTriangleId> triangleIds);
+
+    /// Select the base triangles, ids may be in any order and repeat
+    explicit TriangleSelection(std::vector<size_t> baseIds);
+
+    /// Add all triangles of the other selection
+    void insert(const TriangleSelection& other);
+
+    /// Ranges of base triangles that are selected as a whole
+    const RangeList& getBaseRanges() const {
+        return mBaseRanges;
+    }
+
+    /// Ranges of selected detailed triangles for each base triangle, the base triangles are not selected as a whole
+    const std::map<size_t, RangeList>& getDetailRanges() const {
+        return mDetailRanges;
+    }
+
+    bool contains(DetailedTriangleId triangleId) const;
+
+    /// Number of selected triangles, base and detailed
+    size_t size() const;
+
+    bool empty() const {
+        return mBaseRanges.empty() && mDetailRanges.empty();
+    }
+
+    /// Call func(DetailedTriangleId) for every selected triangle, detailed triangles first
+    template <typename Func>
+    void forEach(const Func& func) const {
+        for(const auto& detailIt : mDetailRanges) {
+            for(const Range& range : detailIt.second) {
+                for(size_t detailId = range.begin; detailId < range.end; ++detailId) {
+                    func(DetailedTriangleId(detailIt.first, detailId));
+                }
+            }
+        }
+
+        for(const Range& range : mBaseRanges) {
+            for(size_t baseId = range.begin; baseId < range.end; ++baseId) {
+                func(DetailedTriangleId(baseId));
+            }
+        }
+    }
+
+    /// Split the ranges so that none is longer than maxSize, used to spread the work between threads
+    static RangeList splitRanges(const RangeList& ranges, size_t maxSize);
+
+   private:
+    RangeList mBaseRanges;
+    std::map<size_t, RangeList> mDetailRanges;
+
+    /// Create ranges from ids, ids get sorted
+    static RangeList makeRanges(std::vector<size_t>& ids);
+
+    /// Union of two range lists
+    static RangeList mergeRanges(const RangeList& first, const RangeList& second);
+
+    static bool containsId(const RangeList& ranges, size_t id);
+
+    /// Drop detailed triangles of bases that are selected as a whole
+    void removeCoveredDetails();
+};
+
+}  // namespace pepr3d
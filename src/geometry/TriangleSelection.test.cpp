@@ -0,0 +1,77 @@
+#include "geometry/TriangleSelection.h"
+#ifdef _TEST_
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace pepr3d {
+
+using Range = TriangleSelection::Range;
+using RangeList = TriangleSelection::RangeList;
+
+TEST(TriangleSelection, RangesFromIds) {
+    /**
+     * Test that unsorted ids with duplicates become sorted merged ranges
+     */
+
+    const TriangleSelection selection(std::vector<size_t>{7, 3, 4, 5, 4, 10, 3, 6, 11, 20});
+    const RangeList expected = {{3, 8}, {10, 12}, {20, 21}};
+    EXPECT_EQ(selection.getBaseRanges(), expected);
+    EXPECT_EQ(selection.size(), 8);
+    EXPECT_TRUE(selection.getDetailRanges().empty());
+
+    EXPECT_TRUE(selection.contains(DetailedTriangleId(3)));
+    EXPECT_TRUE(selection.contains(DetailedTriangleId(7)));
+    EXPECT_FALSE(selection.contains(DetailedTriangleId(8)));
+    EXPECT_FALSE(selection.contains(DetailedTriangleId(2)));
+    EXPECT_FALSE(selection.contains(DetailedTriangleId(21)));
+}
+
+TEST(TriangleSelection, DetailedTriangles) {
+    /**
+     * Test that detailed triangles are grouped by their base and whole bases take precedence
+     */
+
+    const TriangleSelection selection(std::vector<DetailedTriangleId>{
+        DetailedTriangleId(1, 2), DetailedTriangleId(1, 0), DetailedTriangleId(1, 1), DetailedTriangleId(5, 4),
+        DetailedTriangleId(5), DetailedTriangleId(8, 3), DetailedTriangleId(8, 3)});
+
+    EXPECT_EQ(selection.getBaseRanges(), (RangeList{{5, 6}}));
+    ASSERT_EQ(selection.getDetailRanges().size(), 2);
+    EXPECT_EQ(selection.getDetailRanges().at(1), (RangeList{{0, 3}}));
+    EXPECT_EQ(selection.getDetailRanges().at(8), (RangeList{{3, 4}}));
+    EXPECT_EQ(selection.size(), 5);
+
+    EXPECT_TRUE(selection.contains(DetailedTriangleId(5, 4)));
+    EXPECT_TRUE(selection.contains(DetailedTriangleId(1, 1)));
+    EXPECT_FALSE(selection.contains(DetailedTriangleId(1)));
+    EXPECT_FALSE(selection.contains(DetailedTriangleId(8, 2)));
+
+    std::vector<DetailedTriangleId> visited;
+    selection.forEach([&visited](DetailedTriangleId id) { visited.push_back(id); });
+    EXPECT_EQ(visited.size(), selection.size());
+}
+
+TEST(TriangleSelection, Insert) {
+    /**
+     * Test that inserting a selection merges overlapping and adjacent ranges
+     */
+
+    TriangleSelection selection(std::vector<DetailedTriangleId>{DetailedTriangleId(0), DetailedTriangleId(1),
+                                                                 DetailedTriangleId(10), DetailedTriangleId(4, 0)});
+    selection.insert(TriangleSelection(std::vector<DetailedTriangleId>{
+        DetailedTriangleId(2), DetailedTriangleId(9), DetailedTriangleId(4), DetailedTriangleId(6, 1)}));
+    selection.insert(selection);
+
+    EXPECT_EQ(selection.getBaseRanges(), (RangeList{{0, 3}, {4, 5}, {9, 11}}));
+    ASSERT_EQ(selection.getDetailRanges().size(), 1);
+    EXPECT_EQ(selection.getDetailRanges().at(6), (RangeList{{1, 2}}));
+    EXPECT_EQ(selection.size(), 7);
+}
+
+TEST(TriangleSelection, SplitRanges) {
+    const RangeList split = TriangleSelection::splitRanges({{0, 5}, {10, 11}}, 2);
+    EXPECT_EQ(split, (RangeList{{0, 2}, {2, 4}, {4, 5}, {10, 11}}));
+}
+
+}  // namespace pepr3d
+#endif
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
 #include "commands/CmdPaintBrush.h"
 #include "geometry/Geometry.h"
 #include "ui/MainApplication.h"
@@ -39,41 +43,271 @@ void Brush::onToolSelect(ModelView& modelView) {
 }
 
 void Brush::onToolDeselect(ModelView& modelView) {
-    mApplication.getCurrentGeometry()->hideHighlight();
+    if(mPaintInProgress) {
+        mHideHighlightPending = true;
+    } else {
+        mApplication.getCurrentGeometry()->hideHighlight();
+    }
 }
 
 void Brush::paint() {
-    // Prevents blocking the rendering if painting takes too long
-    if(mPaintsSinceDraw >= MAX_PAINTS_WITHOUT_DRAW) {
-        return;
+    mPendingRays.push_back(mLastRay);
+    mPendingRayTimes.push_back(std::chrono::high_resolution_clock::now());
+    mPaintedAnything = true;
+
+    if(mPaintInProgress) {
+        // The preview needs the geometry, which is being painted now
+        mPendingRayPreviewPoints.push_back(0);
+        ++mUnpreviewedRayCount;
+    } else {
+        mPendingRayPreviewPoints.push_back(isStrokePreviewed() ? addPreviewRay(mLastRay) : 0);
+        paintPendingRays();
+    }
+}
+
+bool Brush::isStrokePreviewed() const {
+    // Other brushes paint whole triangles or flat shapes, which is fast enough to do during the stroke
+    return mBrushSettings.spherical && !mBrushSettings.respectOriginalTriangles;
+}
+
+bool Brush::shouldPaintPendingRays() const {
+    if(!isStrokePreviewed()) {
+        return true;
+    }
+
+    // The previewed stroke is painted when it ends, or earlier if its preview gets too long
+    return mPreviewPoints.size() - mCommittingPreviewPoints >= PREVIEW_COMMIT_POINTS;
+}
+
+size_t Brush::addPreviewRay(const ci::Ray& ray) {
+    std::vector<ci::Ray> rays;
+    if(mLastPreviewRay) {
+        rays.push_back(*mLastPreviewRay);
+    }
+    rays.push_back(ray);
+
+    // Same points as the ones painted by the stroke, the previous ray always hits and is already in the preview
+    const size_t firstNewPoint = mLastPreviewRay ? 1 : 0;
+    const std::vector<Geometry::StrokePoint> points =
+        mApplication.getCurrentGeometry()->getStrokePoints(rays, mBrushSettings.size);
+    for(size_t pointIdx = firstNewPoint; pointIdx < points.size(); ++pointIdx) {
+        const Geometry::StrokePoint& point = points[pointIdx];
+        mPreviewPoints.emplace_back(point.position, point.connected ? 1.0f : 0.0f);
+    }
+    const size_t addedPoints = points.size() - std::min(firstNewPoint, points.size());
+    mLastPreviewRay = addedPoints > 0 ? std::optional<ci::Ray>(ray) : std::nullopt;
+
+    // Keep the preview bounded, drop the oldest points that are already being painted
+    if(mPreviewPoints.size() > MAX_PREVIEW_POINTS && mCommittingPreviewPoints > 0) {
+        const size_t excess = std::min(mPreviewPoints.size() - MAX_PREVIEW_POINTS, mCommittingPreviewPoints);
+        mPreviewPoints.erase(mPreviewPoints.begin(), mPreviewPoints.begin() + excess);
+        mPreviewPoints.front().w = 0.0f;
+        mCommittingPreviewPoints -= excess;
+    }
+
+    updateStrokePreview();
+    return addedPoints;
+}
+
+void Brush::previewRecordedRays() {
+    P_ASSERT(!mPaintInProgress);
+    P_ASSERT(mUnpreviewedRayCount <= mPendingRays.size());
+
+    // Strokes that ended meanwhile must not be connected to the next rays
+    const auto isStrokeEnd = [this](size_t rayCount) {
+        return std::find(mPendingStrokeEnds.begin(), mPendingStrokeEnds.end(), rayCount) != mPendingStrokeEnds.end();
+    };
+    for(size_t rayIdx = mPendingRays.size() - mUnpreviewedRayCount; rayIdx < mPendingRays.size(); ++rayIdx) {
+        if(isStrokeEnd(rayIdx)) {
+            mLastPreviewRay.reset();
+        }
+        mPendingRayPreviewPoints[rayIdx] = isStrokePreviewed() ? addPreviewRay(mPendingRays[rayIdx]) : 0;
+    }
+    if(mUnpreviewedRayCount > 0 && isStrokeEnd(mPendingRays.size())) {
+        mLastPreviewRay.reset();
+    }
+    mUnpreviewedRayCount = 0;
+}
+
+void Brush::updateStrokePreview() {
+    if(mPreviewPoints.empty()) {
+        mApplication.getModelView().hideStrokePreview();
+    } else if(mPreviewPoints.size() <= MAX_PREVIEW_POINTS) {
+        mApplication.getModelView().setStrokePreview(mPreviewPoints, mBrushSettings.size);
+    } else {
+        // Show only the latest part of a stroke that gets painted too slowly
+        std::vector<glm::vec4> latestPoints(mPreviewPoints.end() - MAX_PREVIEW_POINTS, mPreviewPoints.end());
+        latestPoints.front().w = 0.0f;
+        mApplication.getModelView().setStrokePreview(latestPoints, mBrushSettings.size);
+    }
+}
+
+void Brush::removePreviewPoints(size_t pointCount) {
+    pointCount = std::min(pointCount, mPreviewPoints.size());
+    if(pointCount > 0 && pointCount < mPreviewPoints.size() && mPreviewPoints[pointCount].w > 0.0f) {
+        // Keep the last removed point, the segment to the next point is not painted yet
+        --pointCount;
+        mPreviewPoints[pointCount].w = 0.0f;
+    }
+    mPreviewPoints.erase(mPreviewPoints.begin(), mPreviewPoints.begin() + pointCount);
+    updateStrokePreview();
+}
+
+void Brush::paintPendingRays() {
+    P_ASSERT(!mPaintInProgress);
+    P_ASSERT(mUnpreviewedRayCount == 0);
+
+    // Rays of ended strokes are painted first, each stroke separately
+    while(!mPendingStrokeEnds.empty()) {
+        const size_t rayCount = mPendingStrokeEnds.front();
+        mPendingStrokeEnds.pop_front();
+        for(size_t& strokeEnd : mPendingStrokeEnds) {
+            strokeEnd -= rayCount;
+        }
+
+        if(rayCount > 0 && startPaintJob(rayCount)) {
+            mJobEndsStroke = true;
+            return;
+        }
+        finishStroke();
+    }
+
+    if(!mPendingRays.empty() && shouldPaintPendingRays()) {
+        startPaintJob(mPendingRays.size());
     }
+}
+
+bool Brush::startPaintJob(size_t rayCount) {
+    P_ASSERT(!mPaintInProgress);
+    P_ASSERT(rayCount > 0 && rayCount <= mPendingRays.size());
 
-    mPaintsSinceDraw++;
+    // All rays recorded since the last job are painted at once, but the command keeps every one of them
+    std::vector<ci::Ray> rays(mPendingRays.begin(), mPendingRays.begin() + rayCount);
+    std::vector<TimePoint> rayTimes(mPendingRayTimes.begin(), mPendingRayTimes.begin() + rayCount);
+    const size_t previewPoints = std::accumulate(mPendingRayPreviewPoints.begin(),
+                                                 mPendingRayPreviewPoints.begin() + rayCount, size_t(0));
+    mPendingRays.erase(mPendingRays.begin(), mPendingRays.begin() + rayCount);
+    mPendingRayTimes.erase(mPendingRayTimes.begin(), mPendingRayTimes.begin() + rayCount);
+    mPendingRayPreviewPoints.erase(mPendingRayPreviewPoints.begin(), mPendingRayPreviewPoints.begin() + rayCount);
 
-    mBrushSettings.color = mApplication.getCurrentGeometry()->getColorManager().getActiveColorIndex();
     auto* commandManager = mApplication.getCommandManager();
-    if(commandManager) {
-        commandManager->execute(std::make_unique<CmdPaintBrush>(mLastRay, mBrushSettings), mGroupCommands);
+    if(!commandManager) {
+        removePreviewPoints(previewPoints);
+        return false;
     }
 
+    Geometry* geometry = mApplication.getCurrentGeometry();
+    mBrushSettings.color = geometry->getColorManager().getActiveColorIndex();
+    mBrushSettings.gridSize = geometry->getPaintGridSize();
+    const std::optional<ci::Ray> previousRay = mGroupCommands ? mLastPaintedRay : std::nullopt;
+    const bool joinCommand = mGroupCommands;
+    mLastPaintedRay = rays.back();
     mGroupCommands = true;
-    mPaintedAnything = true;
+
+    // The model view keeps drawing the last published buffers and the preview until the job finishes
+    mCommittingPreviewPoints = previewPoints;
+    mPaintInProgress = true;
+    mApplication.getModelView().setGeometryBusy(true);
+
+    // Busy geometry keeps the rest of the UI from touching it until the job is finished
+    mPaintWorker.enqueue([this, commandManager, geometry, rays, settings = mBrushSettings, previousRay, joinCommand,
+                          rayTimes]() {
+        bool buffersUpdated = false;
+        try {
+            commandManager->execute(std::make_unique<CmdPaintBrush>(rays, settings, previousRay), joinCommand);
+            if(geometry->getOpenGlData().isDirty) {
+                geometry->updateOpenGlBuffers();
+                buffersUpdated = true;
+            }
+        } catch(const std::exception& e) {
+            CI_LOG_E("Brush paint failed: " + std::string(e.what()));
+        }
+
+        mApplication.dispatchAsync([this, rayTimes, buffersUpdated]() {
+            if(buffersUpdated) {
+                mApplication.getModelView().forceBatchRefresh();
+            }
+            finishPaintJob(rayTimes);
+        });
+    });
+    return true;
+}
+
+void Brush::finishPaintJob(const std::vector<TimePoint>& rayTimes) {
+    const auto now = std::chrono::high_resolution_clock::now();
+    for(const TimePoint& rayTime : rayTimes) {
+        const std::chrono::duration<double, std::milli> latency = now - rayTime;
+        mStrokeLatenciesMs.push_back(latency.count());
+    }
+
+    mPaintInProgress = false;
+    mApplication.getModelView().setGeometryBusy(false);
+    removePreviewPoints(mCommittingPreviewPoints);
+    mCommittingPreviewPoints = 0;
+    previewRecordedRays();
+
+    if(mHideHighlightPending) {
+        mApplication.getCurrentGeometry()->hideHighlight();
+        mHideHighlightPending = false;
+        mHighlightPending = false;
+    } else if(mHighlightPending) {
+        // Only the latest highlight matters
+        mApplication.getCurrentGeometry()->highlightArea(mLastRay, mBrushSettings);
+        mHighlightPending = false;
+    }
+
+    if(mJobEndsStroke) {
+        mJobEndsStroke = false;
+        finishStroke();
+    }
+    paintPendingRays();
 }
 
 void Brush::stopPaint() {
+    if(mUnpreviewedRayCount == 0) {
+        mLastPreviewRay.reset();
+    }
+    mPendingStrokeEnds.push_back(mPendingRays.size());
+    if(!mPaintInProgress) {
+        paintPendingRays();
+    }
+}
+
+void Brush::finishStroke() {
+    if(mGroupCommands) {
+        mApplication.getCurrentGeometry()->compactTriangleDetails();
+    }
     mGroupCommands = false;
+    mLastPaintedRay.reset();
+
+    if(!mStrokeLatenciesMs.empty()) {
+        std::sort(mStrokeLatenciesMs.begin(), mStrokeLatenciesMs.end());
+        const auto percentile = [this](double fraction) {
+            const size_t rank = static_cast<size_t>(std::ceil(fraction * mStrokeLatenciesMs.size()));
+            return mStrokeLatenciesMs[std::max<size_t>(rank, 1) - 1];
+        };
+        CI_LOG_I("Brush stroke of " + std::to_string(mStrokeLatenciesMs.size()) +
+                 " rays, latency p50: " + std::to_string(percentile(0.5)) +
+                 " ms, p90: " + std::to_string(percentile(0.9)) + " ms, p99: " + std::to_string(percentile(0.99)) +
+                 " ms, max: " + std::to_string(mStrokeLatenciesMs.back()) + " ms");
+        mStrokeLatenciesMs.clear();
+    }
 }
 
-void Brush::updateHighlight(ModelView& modelView, ci::app::MouseEvent event) const {
+void Brush::updateHighlight(ModelView& modelView, ci::app::MouseEvent event) {
     if(mBrushSettings.spherical) {
-        mApplication.getCurrentGeometry()->highlightArea(mLastRay, mBrushSettings);
+        if(mPaintInProgress) {
+            mHighlightPending = true;
+        } else {
+            mApplication.getCurrentGeometry()->highlightArea(mLastRay, mBrushSettings);
+        }
     } else {
     }
 }
 
 void Brush::updateRay(ModelView& modelView, ci::app::MouseEvent event) {
+    // Only the ray is recorded, the geometry may be painted in the background
     mLastRay = modelView.getRayFromWindowCoordinates(event.getPos());
-    auto intersection = mApplication.getCurrentGeometry()->intersectMesh(mLastRay, mLastIntersection);
 }
 
 bool Brush::isEnabled() const {
@@ -88,8 +322,18 @@ void Brush::drawToSidePane(SidePane& sidePane) {
                               140.f);
     sidePane.drawTooltipOnHover("Size of the brush in world units.");
 
-    sidePane.drawIntDragger("Segments", mBrushSettings.segments, 0.1f, 3, 50, "%d", 140.f);
-    sidePane.drawTooltipOnHover("Higher number of segments increases \"roundness\" of the brush.");
+    const float maxTolerance = mMaxSize / TOLERANCE_SLIDER_RANGE;
+    sidePane.drawFloatDragger("Tolerance", mBrushSettings.chordTolerance, maxTolerance / SIZE_SLIDER_STEPS, 0.0f,
+                              maxTolerance, mBrushSettings.chordTolerance > 0.0f ? "%.4f" : "Fixed", 140.f);
+    sidePane.drawTooltipOnHover(
+        "Maximal distance of the brush outline from a perfect circle in world units. The number of segments is "
+        "picked from the size of the brush, so small brushes create fewer triangles. Set it close to the resolution "
+        "of your printer, 0 uses a fixed number of segments.");
+
+    if(mBrushSettings.chordTolerance <= 0.0f) {
+        sidePane.drawIntDragger("Segments", mBrushSettings.segments, 0.1f, 3, 50, "%d", 140.f);
+        sidePane.drawTooltipOnHover("Higher number of segments increases \"roundness\" of the brush.");
+    }
 
     sidePane.drawCheckbox("Paint backfaces", mBrushSettings.paintBackfaces);
     sidePane.drawTooltipOnHover("Paint triangles even if they are facing away from the camera.");
@@ -142,12 +386,11 @@ void Brush::drawToSidePane(SidePane& sidePane) {
         sidePane.drawTooltipOnHover("Paint aligned against normal.");
     }
     sidePane.drawSeparator();
-    mPaintsSinceDraw = 0;
 }
 
 void Brush::drawToModelView(ModelView& modelView) {
     Geometry* geometry = mApplication.getCurrentGeometry();
-    if(geometry) {
+    if(geometry && !mPaintInProgress) {
         if(mBrushSettings.respectOriginalTriangles && geometry->getAreaHighlight().enabled) {
             for(size_t triIdx : geometry->getAreaHighlight().triangles) {
                 modelView.drawTriangleHighlight(triIdx);
@@ -159,5 +402,6 @@ void Brush::drawToModelView(ModelView& modelView) {
 void Brush::onNewGeometryLoaded(ModelView& modelView) {
     mMaxSize = modelView.getMaxSize();
     mBrushSettings.size = mMaxSize / 10;
+    mBrushSettings.chordTolerance = mMaxSize / DEFAULT_TOLERANCE_FRACTION;
 }
 }  // namespace pepr3d
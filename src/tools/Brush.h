@@ -1,5 +1,10 @@
 #pragma once
 #include <cinder/Ray.h>
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <vector>
+#include "ThreadPool.h"
 #include "tools/Tool.h"
 #include "ui/IconsMaterialDesign.h"
 #include "ui/SidePane.h"
@@ -14,12 +19,20 @@ struct BrushSettings {
     /// Size of a brush in model space units
     float size = 0.2f;
 
-    /// Number of segments of the brush
+    /// Number of segments of the brush, used when chordTolerance is 0
     int segments = 12;
 
+    /// Maximal distance of the brush outline from a real circle in model units, the number of segments is picked
+    /// from the radius of the brush. 0 uses the fixed number of segments.
+    float chordTolerance = 0.0f;
+
     /// Paint onto backward facing triangles
     bool paintBackfaces = false;
 
+    /// Size of the grid the painted shapes are snapped to in model units, 0 keeps the exact shapes. Taken from the
+    /// Geometry when painting, so that the command is replayed with the same grid.
+    double gridSize = 0.0;
+
     /// Use spherical brush (otherwise shape brush will be used
     bool spherical = true;
 
@@ -41,9 +54,11 @@ struct BrushSettings {
 
     bool operator==(const BrushSettings& other) const {
         return color == other.color && size == other.size && segments == other.segments &&
-               paintBackfaces == other.paintBackfaces && spherical == other.spherical &&
-               continuous == other.continuous && respectOriginalTriangles == other.respectOriginalTriangles &&
-               paintOuterRing == other.paintOuterRing && alignToNormal == other.alignToNormal;
+               chordTolerance == other.chordTolerance && paintBackfaces == other.paintBackfaces &&
+               gridSize == other.gridSize &&
+               spherical == other.spherical && continuous == other.continuous &&
+               respectOriginalTriangles == other.respectOriginalTriangles && paintOuterRing == other.paintOuterRing &&
+               alignToNormal == other.alignToNormal;
     }
 };
 
@@ -79,18 +94,53 @@ class Brush : public Tool {
     virtual void onNewGeometryLoaded(ModelView& modelView);
 
    private:
-    /// Do painting tick on the model
+    using TimePoint = std::chrono::high_resolution_clock::time_point;
+
+    /// Record the current ray for painting, the painting itself runs in the background
     void paint();
 
-    /// Stop painting
+    /// Stop painting, the stroke is finished once all of its rays are painted
     void stopPaint();
 
-    void updateHighlight(ModelView& modelView, ci::app::MouseEvent event) const;
+    /// Start painting the pending rays that should be painted now, must not be called during a paint job
+    void paintPendingRays();
+
+    /// Paint the first rayCount pending rays as a single command on the paint worker
+    /// @returns false if there is nothing to paint the rays with
+    bool startPaintJob(size_t rayCount);
+
+    /// Called in the main thread when the background paint is done
+    void finishPaintJob(const std::vector<TimePoint>& rayTimes);
+
+    /// Compact the painted geometry and log the latencies of the stroke
+    void finishStroke();
+
+    /// Strokes of the spherical brush are only previewed while the mouse is down and painted once they end
+    bool isStrokePreviewed() const;
+
+    bool shouldPaintPendingRays() const;
+
+    /// Add the hits of the ray to the stroke preview
+    /// @returns number of added preview points
+    size_t addPreviewRay(const ci::Ray& ray);
+
+    /// Add the rays recorded during the last paint job to the stroke preview, must not be called during a paint job
+    void previewRecordedRays();
+
+    /// Remove the oldest preview points, whose paint was published
+    void removePreviewPoints(size_t pointCount);
+
+    /// Pass the preview points to the model view
+    void updateStrokePreview();
+
+    void updateHighlight(ModelView& modelView, ci::app::MouseEvent event);
 
     /// Update ray and intersection data
     void updateRay(ModelView& modelView, ci::app::MouseEvent event);
     ci::Ray mLastRay;
-    glm::vec3 mLastIntersection;
+
+    /// Last ray painted in the current stroke, the next ray is connected to it
+    std::optional<ci::Ray> mLastPaintedRay;
 
     MainApplication& mApplication;
 
@@ -99,14 +149,65 @@ class Brush : public Tool {
     float mMaxSize = 1.f;
     static const int SIZE_SLIDER_STEPS = 100;
 
+    /// Tolerance of a newly loaded model is its size divided by this
+    static constexpr float DEFAULT_TOLERANCE_FRACTION = 2000.f;
+
+    /// Tolerance slider goes up to the size of the model divided by this
+    static constexpr float TOLERANCE_SLIDER_RANGE = 100.f;
+
     bool mGroupCommands = false;
 
     /// Did we paint anything since selecting this tool
     bool mPaintedAnything = false;
 
-    /// How many times can we run this tool without updating the screen
-    int mPaintsSinceDraw = 0;
-    const int MAX_PAINTS_WITHOUT_DRAW = 1;
+    /// Rays recorded while the previous rays were painted, all of them get painted by the next job
+    std::vector<ci::Ray> mPendingRays;
+
+    /// When was each of the pending rays recorded
+    std::vector<TimePoint> mPendingRayTimes;
+
+    /// Is a paint job running on the paint worker, the geometry must not be touched from the main thread
+    bool mPaintInProgress = false;
+
+    /// Number of the last pending rays recorded during a paint job, they are added to the preview once it finishes
+    size_t mUnpreviewedRayCount = 0;
+
+    /// Ended strokes that are not painted yet, number of pending rays up to the end of each stroke
+    std::deque<size_t> mPendingStrokeEnds;
+
+    /// Does the running paint job paint the last rays of a stroke
+    bool mJobEndsStroke = false;
+
+    /// Number of preview points added by each pending ray
+    std::vector<size_t> mPendingRayPreviewPoints;
+
+    /// Centers of the spheres of the stroke preview, w is 1 if the point is connected to the previous one
+    std::vector<glm::vec4> mPreviewPoints;
+
+    /// Number of oldest preview points painted by the running paint job
+    size_t mCommittingPreviewPoints = 0;
+
+    /// Last ray of the current stroke that hit the model and was added to the preview
+    std::optional<ci::Ray> mLastPreviewRay;
+
+    /// Same as ModelView::MAX_STROKE_PREVIEW_POINTS
+    static constexpr size_t MAX_PREVIEW_POINTS = 128;
+
+    /// The preview is painted during the stroke once it has this many points not being painted already
+    static constexpr size_t PREVIEW_COMMIT_POINTS = MAX_PREVIEW_POINTS / 2;
+
+    /// Highlight could not be updated during a paint job, update it when the job finishes
+    bool mHighlightPending = false;
+
+    /// Highlight could not be hidden during a paint job, hide it when the job finishes
+    bool mHideHighlightPending = false;
+
+    /// Time from recording a ray to displaying its paint, for each ray of the current stroke
+    std::vector<double> mStrokeLatenciesMs;
+
+    /// Runs the paint jobs one after another. The jobs use the shared thread pool for their parallel parts, so they
+    /// must not occupy its workers themselves.
+    ::ThreadPool mPaintWorker{1};
 };
 
 }  // namespace pepr3d
@@ -98,12 +98,13 @@ void ExportAssistant::drawToSidePane(SidePane& sidePane) {
                 ImGui::InvisibleButton("color",
                                        glm::vec2(boxSize, boxSize));  // we need the invisible button for the tooltip
                 sidePane.drawTooltipOnHover("Color " + std::to_string(i + 1));
-                const glm::vec4 color = colorManager.getColor(i);
+                const size_t colorId = colorManager.getColorId(i);
+                const glm::vec4 color = colorManager.getColor(colorId);
                 const glm::vec4 boxColor(color.r, color.g, color.b, 1.0);
                 drawList->AddRectFilled(cursorPos + glm::ivec2(0, 0), cursorPos + glm::ivec2(boxSize, boxSize),
                                         (ImColor)boxColor);
                 ImGui::NextColumn();
-                if(ImGui::Checkbox("##show", &mSettingsPerColor[i].isShown)) {
+                if(ImGui::Checkbox("##show", &mSettingsPerColor[colorId].isShown)) {
                     resetOverride();
                     setOverride();
                 }
@@ -112,7 +113,7 @@ void ExportAssistant::drawToSidePane(SidePane& sidePane) {
                     "Use this to see inside the model to verify that the extrusion is not too shallow or too deep.");
                 ImGui::NextColumn();
                 ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth());
-                if(ImGui::DragFloat("##depth", &mSettingsPerColor[i].depth, 0.10f, 0.0f, 100.0f, "%.2f %%")) {
+                if(ImGui::DragFloat("##depth", &mSettingsPerColor[colorId].depth, 0.10f, 0.0f, 100.0f, "%.2f %%")) {
                     mIsPreviewUpToDate = false;
                 }
                 sidePane.drawTooltipOnHover("How deep should this color be extruded inside the model.", "",
@@ -27,6 +27,12 @@ void LiveDebug::drawToSidePane(SidePane& sidePane) {
     sidePane.drawText("Polyhedron valid 0/1: " + std::to_string(mApplication.getCurrentGeometry()->polyhedronValid()) +
                       "\n");
 
+    const size_t detailCount = mApplication.getCurrentGeometry()->getTriangleDetailsCount();
+    const size_t detailMemory = mApplication.getCurrentGeometry()->getTriangleDetailsMemoryUsage();
+    sidePane.drawText("Triangle details: " + std::to_string(detailCount) + "\n");
+    sidePane.drawText("Detail memory: " + std::to_string(detailMemory / 1024) + " KiB (" +
+                      std::to_string(detailCount > 0 ? detailMemory / detailCount : 0) + " B per detail)\n");
+
     sidePane.drawSeparator();
 
     static int addedValue = 1;
@@ -125,7 +125,16 @@ void PaintBucket::onModelViewMouseDown(ModelView &modelView, ci::app::MouseEvent
     std::vector<DetailedTriangleId> trianglesToPaint;
 
     try {
-        trianglesToPaint = geometry->bucket(*hoveredTriangleId, combinedCriterion);
+        if(mStopOnNormal && mNormalCompare == NormalAngleCompare::ABSOLUTE) {
+            // Regions depend on the starting triangle, they cannot be cached
+            trianglesToPaint = geometry->bucket(*hoveredTriangleId, combinedCriterion);
+        } else {
+            Geometry::BucketRegionKey regionKey;
+            regionKey.stopOnColor = !mDoNotStop && mStopOnColor;
+            regionKey.stopOnNormal = !mDoNotStop && mStopOnNormal;
+            regionKey.normalThreshold = regionKey.stopOnNormal ? normalFtor.threshold : 0.0;
+            trianglesToPaint = geometry->bucketRegion(*hoveredTriangleId, regionKey, combinedCriterion);
+        }
     } catch(std::exception &e) {
         const std::string errorCaption = "Error: Failed to bucket paint";
         const std::string errorDescription =
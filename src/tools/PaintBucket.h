@@ -102,9 +102,7 @@ class PaintBucket : public Tool {
                 const auto& newNormal = geo->getTriangle(a).getNormal();
                 cosAngle = glm::dot(glm::normalize(newNormal), glm::normalize(startNormal));
             } else if(angleCompare == NormalAngleCompare::NEIGHBOURS) {
-                const auto& newNormal1 = geo->getTriangle(a).getNormal();
-                const auto& newNormal2 = geo->getTriangle(b).getNormal();
-                cosAngle = glm::dot(glm::normalize(newNormal1), glm::normalize(newNormal2));
+                cosAngle = geo->getNeighbourCosine(a.getBaseId(), b.getBaseId());
             } else {
                 assert(false);
             }
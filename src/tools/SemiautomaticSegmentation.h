@@ -83,10 +83,7 @@ class SemiautomaticSegmentation : public Tool {
         NormalStopping(const Geometry* g, const double thresh) : geo(g), threshold(thresh) {}
 
         bool operator()(const size_t a, const size_t b) const {
-            double cosAngle = 0.0;
-            const auto& newNormal1 = geo->getTriangle(a).getNormal();
-            const auto& newNormal2 = geo->getTriangle(b).getNormal();
-            cosAngle = glm::dot(glm::normalize(newNormal1), glm::normalize(newNormal2));
+            const double cosAngle = geo->getNeighbourCosine(a, b);
 
             if(cosAngle < threshold) {
                 return false;
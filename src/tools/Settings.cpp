@@ -8,6 +8,8 @@ namespace pepr3d {
 void Settings::drawToSidePane(SidePane& sidePane) {
     mColorPaletteCategory.draw(sidePane, [&sidePane, this]() { sidePane.drawColorPalette("", true); });
     mUiCategory.draw(sidePane, [&sidePane, this]() { drawUiSettings(sidePane); });
+    mUndoCategory.draw(sidePane, [&sidePane, this]() { drawUndoSettings(sidePane); });
+    mPaintingCategory.draw(sidePane, [&sidePane, this]() { drawPaintingSettings(sidePane); });
 }
 
 void Settings::drawUiSettings(SidePane& sidePane) {
@@ -20,4 +22,39 @@ void Settings::drawUiSettings(SidePane& sidePane) {
     sidePane.drawTooltipOnHover("Adjust the width of the side pane.");
 }
 
+void Settings::drawUndoSettings(SidePane& sidePane) {
+    const std::size_t megabyte = 1024 * 1024;
+    int budget = static_cast<int>(mApplication.getUndoMemoryBudget() / megabyte);
+    if(sidePane.drawIntDragger("Memory budget", budget, 1.0f, 16, 8192, "%.0f MB", 60.0f)) {
+        mApplication.setUndoMemoryBudget(static_cast<std::size_t>(budget) * megabyte);
+    }
+    sidePane.drawTooltipOnHover(
+        "Memory available for saved states used by undo. When it is exceeded, states are saved less often, making "
+        "undo slower.");
+
+    const CommandManager<Geometry>* commandManager = mApplication.getCommandManager();
+    if(commandManager) {
+        sidePane.drawText("Used: " + std::to_string(commandManager->getMemoryUsage() / megabyte) + " MB in " +
+                          std::to_string(commandManager->getSnapshotCount()) + " saved states");
+        sidePane.drawText("Saving state every " + std::to_string(commandManager->getSnapshotFrequency()) +
+                          " commands");
+    }
+}
+
+void Settings::drawPaintingSettings(SidePane& sidePane) {
+    Geometry* const geometry = mApplication.getCurrentGeometry();
+    if(!geometry) {
+        return;
+    }
+
+    float gridSize = static_cast<float>(geometry->getPaintGridSize());
+    if(sidePane.drawFloatDragger("Grid size", gridSize, 0.0001f, 0.0f, 1.0f, gridSize > 0.0f ? "%.4f" : "Exact",
+                                 80.0f)) {
+        geometry->setPaintGridSize(gridSize);
+    }
+    sidePane.drawTooltipOnHover(
+        "Brush and text shapes are snapped to a grid of this size in model units. Set it close to the resolution of "
+        "your printer to make painting faster, 0 paints the exact shapes.");
+}
+
 }  // namespace pepr3d
\ No newline at end of file
@@ -10,10 +10,16 @@ class Settings : public Tool {
     MainApplication& mApplication;
     SidePane::Category mColorPaletteCategory;
     SidePane::Category mUiCategory;
+    SidePane::Category mUndoCategory;
+    SidePane::Category mPaintingCategory;
 
    public:
     Settings(MainApplication& app)
-        : mApplication(app), mColorPaletteCategory("Edit Color Palette", true), mUiCategory("User Interface", true) {}
+        : mApplication(app),
+          mColorPaletteCategory("Edit Color Palette", true),
+          mUiCategory("User Interface", true),
+          mUndoCategory("Undo History"),
+          mPaintingCategory("Painting Precision") {}
 
     virtual std::string getName() const override {
         return "Settings";
@@ -34,5 +40,9 @@ class Settings : public Tool {
     virtual void drawToSidePane(SidePane& sidePane) override;
 
     void drawUiSettings(SidePane& sidePane);
+
+    void drawUndoSettings(SidePane& sidePane);
+
+    void drawPaintingSettings(SidePane& sidePane);
 };
 }  // namespace pepr3d
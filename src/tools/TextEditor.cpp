@@ -36,7 +36,8 @@ void TextEditor::createPreviewMesh() const {
     }
 }
 
-std::vector<std::vector<FontRasterizer::Tri>> TextEditor::triangulateText() const {
+std::vector<std::vector<FontRasterizer::Tri>> TextEditor::triangulateText(
+    std::vector<std::vector<FontRasterizer::Outline>>& outOutlines) const {
     try {
         if(mFontPath == "") {
             return {};
@@ -46,17 +47,19 @@ std::vector<std::vector<FontRasterizer::Tri>> TextEditor::triangulateText() cons
         P_ASSERT(fontTriangulate.isValid());
 
         std::vector<std::vector<pepr3d::FontRasterizer::Tri>> result =
-            fontTriangulate.rasterizeText(mText, mFontSize, mBezierSteps);
+            fontTriangulate.rasterizeText(mText, mFontSize, mBezierSteps, outOutlines);
 
         CI_LOG_I("Text triangulated, " + std::to_string(result.size()) + " letters.");
         return result;
     } catch(const std::exception& e) {
         CI_LOG_E(e.what());
+        outOutlines.clear();
         return {};
     }
 }
 
-void TextEditor::rotateText(std::vector<std::vector<FontRasterizer::Tri>>& text) {
+void TextEditor::rotateText(std::vector<std::vector<FontRasterizer::Tri>>& text,
+                            std::vector<std::vector<FontRasterizer::Outline>>& outlines) {
     if(text.empty())
         return;
 
@@ -77,25 +80,28 @@ void TextEditor::rotateText(std::vector<std::vector<FontRasterizer::Tri>>& text)
             tri.c = origin + rotationMat * tri.c;
         }
     }
+    transformOutlines(outlines, [&origin, &rotationMat](const glm::vec3& pt) { return origin + rotationMat * pt; });
 }
 
 void TextEditor::generateAndUpdate() {
-    mTriangulatedText = triangulateText();
+    mTriangulatedText = triangulateText(mTextOutlines);
     updateTextPreview();
 }
 
 void TextEditor::updateTextPreview() {
     mRenderedText = mTriangulatedText;
+    mRenderedOutlines = mTextOutlines;
     if(!mSelectedIntersection) {
         return;
     }
 
-    rescaleText(mRenderedText);
-    rotateText(mRenderedText);
+    rescaleText(mRenderedText, mRenderedOutlines);
+    rotateText(mRenderedText, mRenderedOutlines);
     createPreviewMesh();
 }
 
-void TextEditor::rescaleText(std::vector<std::vector<FontRasterizer::Tri>>& result) {
+void TextEditor::rescaleText(std::vector<std::vector<FontRasterizer::Tri>>& result,
+                             std::vector<std::vector<FontRasterizer::Outline>>& outlines) {
     for(auto& letter : result) {
         for(auto& t : letter) {
             t.a *= mFontScale;
@@ -150,6 +156,12 @@ void TextEditor::rescaleText(std::vector<std::vector<FontRasterizer::Tri>>& resu
             t.c.y *= -1;
         }
     }
+
+    // Outline points are among the triangle points, so the bounds of the triangles hold for them too
+    transformOutlines(outlines, [this, &min, &max](glm::vec3 pt) {
+        pt *= mFontScale;
+        return glm::vec3(pt.x - min.first - max.first / 2.f, -(pt.y - min.second - max.second / 2.f), 0.f);
+    });
 }
 
 glm::vec3 TextEditor::getPlaneBaseVector(const glm::vec3& direction) const {
@@ -265,14 +277,17 @@ void TextEditor::paintText() {
     const Geometry* geometry = mApplication.getCurrentGeometry();
     P_ASSERT(geometry);
     const size_t color = geometry->getColorManager().getActiveColorIndex();
+    const double gridSize = geometry->getPaintGridSize();
     ci::Ray ray = mSelectedRay;
     ray.setDirection(-geometry->getTriangle(*mSelectedIntersection).getNormal());
     mApplication.enqueueSlowOperation(
-        [ray, color, this]() {
-            mApplication.getCommandManager()->execute(std::make_unique<CmdPaintText>(ray, mRenderedText, color));
+        [ray, color, gridSize, this]() {
+            mApplication.getCommandManager()->execute(
+                std::make_unique<CmdPaintText>(ray, mRenderedOutlines, color, gridSize));
         },
         [this]() {
             mRenderedText.clear();  // Hide the preview
+            mRenderedOutlines.clear();
             mApplication.getModelView().resetPreview();
         },
         true);
@@ -83,10 +83,15 @@ class TextEditor : public Tool {
     /// How far should the text preview placed from the model (normalized by model scale)
     const float TEXT_DISTANCE_SCALE = 0.02f;
 
+    /// Triangles are rendered as the preview, outlines of the same letters are painted
     std::vector<std::vector<FontRasterizer::Tri>> mTriangulatedText;
     std::vector<std::vector<FontRasterizer::Tri>> mRenderedText;
+    std::vector<std::vector<FontRasterizer::Outline>> mTextOutlines;
+    std::vector<std::vector<FontRasterizer::Outline>> mRenderedOutlines;
 
-    std::vector<std::vector<FontRasterizer::Tri>> triangulateText() const;
+    /// Triangulate the text, fills the outlines too
+    std::vector<std::vector<FontRasterizer::Tri>> triangulateText(
+        std::vector<std::vector<FontRasterizer::Outline>>& outOutlines) const;
 
     /// Update modelView's preview data with new triangles to render
     void createPreviewMesh() const;
@@ -98,9 +103,29 @@ class TextEditor : public Tool {
     void updateTextPreview();
 
     /// Rotate to face ray direction
-    void rotateText(std::vector<std::vector<FontRasterizer::Tri>>& text);
-
-    void rescaleText(std::vector<std::vector<FontRasterizer::Tri>>& result);
+    void rotateText(std::vector<std::vector<FontRasterizer::Tri>>& text,
+                    std::vector<std::vector<FontRasterizer::Outline>>& outlines);
+
+    void rescaleText(std::vector<std::vector<FontRasterizer::Tri>>& result,
+                     std::vector<std::vector<FontRasterizer::Outline>>& outlines);
+
+    /// Apply the transformation to every point of the outlines
+    template <typename Transform>
+    static void transformOutlines(std::vector<std::vector<FontRasterizer::Outline>>& outlines,
+                                  const Transform& transform) {
+        for(auto& letter : outlines) {
+            for(auto& outline : letter) {
+                for(auto& pt : outline.boundary) {
+                    pt = transform(pt);
+                }
+                for(auto& hole : outline.holes) {
+                    for(auto& pt : hole) {
+                        pt = transform(pt);
+                    }
+                }
+            }
+        }
+    }
 
     /// Get vector perpendicular to the direction, that is pointing towards the right halfplane
     glm::vec3 getPlaneBaseVector(const glm::vec3& direction) const;
@@ -89,6 +89,7 @@ void MainApplication::setup() {
     }
 
     mCommandManager = std::make_unique<CommandManager<Geometry>>(*mGeometry);
+    mCommandManager->setMemoryBudget(mUndoMemoryBudget);
 
     mTools.emplace_back(make_unique<TrianglePainter>(*this));
     mTools.emplace_back(make_unique<PaintBucket>(*this));
@@ -179,7 +180,8 @@ void MainApplication::mouseMove(MouseEvent event) {
 }
 
 void MainApplication::fileDrop(FileDropEvent event) {
-    if(mGeometry == nullptr || !mDialogQueue.empty() || event.getFiles().size() < 1) {
+    if(mGeometry == nullptr || !mDialogQueue.empty() || event.getFiles().size() < 1 ||
+       mProgressIndicator.isInProgress() || mModelView.isGeometryBusy()) {
         return;
     }
     openFile(event.getFile(0).string());
@@ -191,6 +193,10 @@ void MainApplication::keyDown(KeyEvent event) {
     if(!action) {
         return;
     }
+    if(mProgressIndicator.isInProgress() || mModelView.isGeometryBusy()) {
+        // Geometry is being modified in the background, saving or switching tools would race with it
+        return;
+    }
     switch(*action) {
     case HotkeyAction::Open: showImportDialog(supportedOpenExtensions); break;
     case HotkeyAction::Save: saveProject(); break;
@@ -212,10 +218,10 @@ void MainApplication::keyDown(KeyEvent event) {
     std::size_t actionId = static_cast<std::size_t>(*action);
     if(mGeometry != nullptr && actionId >= static_cast<std::size_t>(HotkeyAction::SelectColor1) &&
        actionId <= static_cast<std::size_t>(HotkeyAction::SelectColor10)) {
-        std::size_t colorId = actionId - static_cast<std::size_t>(HotkeyAction::SelectColor1);
+        std::size_t colorPosition = actionId - static_cast<std::size_t>(HotkeyAction::SelectColor1);
         ColorManager& colorManager = mGeometry->getColorManager();
-        if(colorId < colorManager.size()) {
-            colorManager.setActiveColorIndex(colorId);
+        if(colorPosition < colorManager.size()) {
+            colorManager.setActiveColorIndex(colorManager.getColorId(colorPosition));
         }
     }
 }
@@ -313,6 +319,7 @@ void MainApplication::openFile(const std::string& path) {
         mShouldSaveAs = true;
         mIsGeometryDirty = false;
         mCommandManager = std::make_unique<CommandManager<Geometry>>(*mGeometry);
+        mCommandManager->setMemoryBudget(mUndoMemoryBudget);
         fs::path fsPath(path);
         getWindow()->setTitle(fsPath.stem().string() + std::string(" - Pepr3D"));
         mProgressIndicator.setGeometryInProgress(nullptr);
@@ -397,7 +404,8 @@ void MainApplication::update() {
         }
     }
 #endif
-    if(!mIsGeometryDirty && mLastVersionSaved != mCommandManager->getVersionNumber()) {
+    // The command manager is busy while the geometry is painted in the background
+    if(!mIsGeometryDirty && !mModelView.isGeometryBusy() && mLastVersionSaved != mCommandManager->getVersionNumber()) {
         mIsGeometryDirty = true;
         fs::path path(mGeometryFileName);
 
@@ -183,6 +183,18 @@ class MainApplication : public cinder::app::App {
         return mCommandManager.get();
     }
 
+    /// Set the memory budget for undo snapshots in bytes, kept for all future command managers.
+    void setUndoMemoryBudget(std::size_t bytes) {
+        mUndoMemoryBudget = bytes;
+        if(mCommandManager) {
+            mCommandManager->setMemoryBudget(bytes);
+        }
+    }
+
+    std::size_t getUndoMemoryBudget() const {
+        return mUndoMemoryBudget;
+    }
+
     const std::vector<std::string> supportedImportExtensions = {"stl", "obj", "ply"};
     const std::vector<std::string> supportedOpenExtensions = {"p3d"};
     /// Opens the file dialog for import.
@@ -335,6 +347,7 @@ class MainApplication : public cinder::app::App {
     std::shared_ptr<Geometry>
         mGeometryInProgress;  // used for async loading of Geometry, is nullptr if nothing is being loaded
     std::unique_ptr<CommandManager<Geometry>> mCommandManager;
+    std::size_t mUndoMemoryBudget = CommandManager<Geometry>::DEFAULT_MEMORY_BUDGET;
 
     std::string mGeometryFileName;
     bool mShouldSaveAs = true;
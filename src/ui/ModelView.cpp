@@ -18,6 +18,7 @@ void ModelView::setup() {
                                      .attrib(Attributes::COLOR_IDX, "aColorIndex")
                                      .attrib(Attributes::HIGHLIGHT_MASK, "aAreaHighlightMask"));
     mModelShader->uniform("uPreviewMinMaxHeight", mPreviewMinMaxHeight);
+    mModelShader->uniform("uStrokePreviewCount", 0);
 }
 
 void ModelView::resize() {
@@ -298,6 +299,16 @@ void ModelView::drawGeometry() {
         return;
     }
 
+    if(mIsGeometryBusy) {
+        // Geometry is being modified in a background thread, draw the last batch without touching the geometry
+        if(mBatch) {
+            const ci::gl::ScopedModelMatrix scopedModelMatrix;
+            ci::gl::multModelMatrix(mModelMatrix);
+            mBatch->draw();
+        }
+        return;
+    }
+
     const Geometry::OpenGlData& glData = mApplication.getCurrentGeometry()->getOpenGlData();
     if(glData.isDirty || !mBatch || isMeshOverriden()) {
         if(glData.isDirty && !isMeshOverriden()) {
@@ -312,7 +323,36 @@ void ModelView::drawGeometry() {
 
     // Pass new highlight data if required
     if(glData.info.didHighlightUpdate) {
-        mVboMesh->bufferAttrib<GLint>(Attributes::HIGHLIGHT_MASK, glData.highlightMask);
+        // Join the changed ranges that are close to each other, each range is a separate upload
+        std::vector<std::pair<size_t, size_t>> ranges = glData.info.highlightUpdateRanges;
+        std::sort(ranges.begin(), ranges.end());
+        std::vector<std::pair<size_t, size_t>> uploadRanges;
+        for(const auto& range : ranges) {
+            const size_t end = std::min(range.second, glData.highlightMask.size());
+            if(range.first >= end) {
+                continue;
+            }
+            if(!uploadRanges.empty() && range.first <= uploadRanges.back().second + HIGHLIGHT_UPLOAD_GAP) {
+                uploadRanges.back().second = std::max(uploadRanges.back().second, end);
+            } else {
+                uploadRanges.emplace_back(range.first, end);
+            }
+        }
+
+        if(uploadRanges.size() > MAX_HIGHLIGHT_UPLOADS ||
+           (uploadRanges.size() == 1 && uploadRanges.front().first == 0 &&
+            uploadRanges.front().second == glData.highlightMask.size())) {
+            mVboMesh->bufferAttrib<GLint>(Attributes::HIGHLIGHT_MASK, glData.highlightMask);
+        } else if(!uploadRanges.empty()) {
+            // Upload only the parts of the mask that changed
+            auto* highlightAttrib = mVboMesh->findAttrib(Attributes::HIGHLIGHT_MASK);
+            assert(highlightAttrib != nullptr);
+            for(const auto& range : uploadRanges) {
+                highlightAttrib->second->bufferSubData(range.first * sizeof(GLint),
+                                                       (range.second - range.first) * sizeof(GLint),
+                                                       &glData.highlightMask[range.first]);
+            }
+        }
         glData.info.unsetHighlightFlag();
     }
 
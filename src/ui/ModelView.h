@@ -10,6 +10,7 @@
 
 #include <chrono>
 #include "geometry/TrianglePrimitive.h"
+#include "peprassert.h"
 
 namespace pepr3d {
 
@@ -151,6 +152,16 @@ class ModelView {
         return mMeshOverride.overrideColorBuffer;
     }
 
+    /// While the geometry is busy, a background thread is modifying it. The last created batch keeps being drawn and
+    /// the geometry is not touched.
+    void setGeometryBusy(bool busy) {
+        mIsGeometryBusy = busy;
+    }
+
+    bool isGeometryBusy() const {
+        return mIsGeometryBusy;
+    }
+
     /// Returns true if the mesh data is overriden. (A mesh different from the geometry is being displayed)
     bool isMeshOverriden() const {
         return mMeshOverride.isOverriden;
@@ -185,6 +196,29 @@ class ModelView {
         mModelShader->uniform("uPreviewMinMaxHeight", mPreviewMinMaxHeight);
     }
 
+    /// Maximum number of stroke preview points, must match PEPR3D_MAX_STROKE_PREVIEW_POINTS in ModelView.frag
+    static constexpr size_t MAX_STROKE_PREVIEW_POINTS = 128;
+
+    /// Show a brush stroke that is not painted yet, as spheres swept between consecutive points
+    /// @param points Centers of the spheres in model space, w is 1 if the point is connected to the previous one
+    /// @param size Radius of the spheres
+    void setStrokePreview(const std::vector<glm::vec4>& points, float size) {
+        P_ASSERT(points.size() <= MAX_STROKE_PREVIEW_POINTS);
+        std::vector<glm::vec4> shaderPoints(points);
+        for(glm::vec4& point : shaderPoints) {
+            point -= glm::vec4(mModelTranslate, 0.0f);
+        }
+        if(!shaderPoints.empty()) {
+            mModelShader->uniform("uStrokePreviewPoints", &shaderPoints[0], static_cast<int>(shaderPoints.size()));
+        }
+        mModelShader->uniform("uStrokePreviewCount", static_cast<int>(shaderPoints.size()));
+        mModelShader->uniform("uStrokePreviewSize", size);
+    }
+
+    void hideStrokePreview() {
+        mModelShader->uniform("uStrokePreviewCount", 0);
+    }
+
     /// Returns the maximum size (in the X, Y, Z axes) of the current Geometry object.
     float getMaxSize() const {
         return mMaxSize;
@@ -218,6 +252,13 @@ class ModelView {
     glm::vec3 mModelTranslate = glm::vec3(0);
     float mMaxSize = 1.f;
     glm::vec2 mPreviewMinMaxHeight = glm::vec2(0.0f, 1.0f);
+    bool mIsGeometryBusy = false;
+
+    /// Changed parts of the highlight mask closer than this many vertices are uploaded together
+    static constexpr size_t HIGHLIGHT_UPLOAD_GAP = 1024;
+
+    /// Upload the whole highlight mask instead of more parts than this
+    static constexpr size_t MAX_HIGHLIGHT_UPLOADS = 64;
 
     /// Override currently displayed mesh data, making it possibly to change displayed mesh
     /// without chaning the geometry itself
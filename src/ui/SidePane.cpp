@@ -60,7 +60,15 @@ void SidePane::draw() {
     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, glm::vec2(12.0f));
     ImGui::PushStyleVar(ImGuiStyleVar_FrameBorderSize, 1.0f);
     ImGui::Begin("##sidepane-inside", nullptr, window_flags);
+    // The tool is still drawn while the geometry is painted in the background, but it cannot execute any commands
+    const bool isGeometryBusy = mApplication.getModelView().isGeometryBusy();
+    if(isGeometryBusy) {
+        ImGui::PushItemFlag(ImGuiItemFlags_Disabled, true);
+    }
     currentTool.drawToSidePane(*this);
+    if(isGeometryBusy) {
+        ImGui::PopItemFlag();
+    }
     ImGui::End();
 
     ImGui::PopStyleVar(6);
@@ -207,7 +215,9 @@ void SidePane::drawColorPaletteColorBoxes(ColorManager& colorManager, CommandMan
             leftCornerX = 0;
         }
 
-        const bool isSelected = i == colorManager.getActiveColorIndex();
+        // Boxes are drawn in the order of the palette, the model and the active color use color ids
+        const size_t colorId = colorManager.getColorId(i);
+        const bool isSelected = colorId == colorManager.getActiveColorIndex();
         const std::string colorEditPopupId = std::string("##colorPaletteEditPopup") + std::to_string(i);
         const std::string colorPickerId = std::string("##colorPalettePicker") + std::to_string(i);
 
@@ -217,7 +227,7 @@ void SidePane::drawColorPaletteColorBoxes(ColorManager& colorManager, CommandMan
             if(isEditable) {
                 ImGui::OpenPopup(colorEditPopupId.c_str());
             } else {
-                colorManager.setActiveColorIndex(i);
+                colorManager.setActiveColorIndex(colorId);
             }
         }
         const bool isHovered = ImGui::IsItemHovered();
@@ -245,7 +255,7 @@ void SidePane::drawColorPaletteColorBoxes(ColorManager& colorManager, CommandMan
                 const glm::vec2 tooltipCursorPos = ImGui::GetCursorScreenPos();
                 const glm::vec2 tooltipSize(boxWidth, boxHeight);
                 tooltipDrawList->AddRectFilled(tooltipCursorPos, tooltipCursorPos + tooltipSize,
-                                               (ImColor)colorManager.getColor(i));
+                                               (ImColor)colorManager.getColor(colorId));
                 ImGui::SetCursorScreenPos(tooltipCursorPos + tooltipSize);
                 ImGui::EndDragDropSource();
             }
@@ -275,7 +285,7 @@ void SidePane::drawColorPaletteColorBoxes(ColorManager& colorManager, CommandMan
             cursorPos + glm::ivec2(static_cast<int>(leftCornerX + boxWidth + 2), static_cast<int>(boxHeight + 2)),
             (ImColor)ci::ColorA::hex(0xE5E5E5));
 
-        glm::vec4 color = colorManager.getColor(i);
+        glm::vec4 color = colorManager.getColor(colorId);
         const float boxAlpha = (isHovered || isHeld) ? (isHeld ? 0.8f : 0.9f) : 1.0f;
         const glm::vec4 boxColor(color.r, color.g, color.b, boxAlpha);
         drawList->AddRectFilled(
@@ -307,7 +317,7 @@ void SidePane::drawColorPaletteColorBoxes(ColorManager& colorManager, CommandMan
             if(ImGui::BeginPopup(colorEditPopupId.c_str())) {
                 ImGui::PushItemWidth(-0.001f);  // force full width
                 if(ImGui::ColorPicker3(colorPickerId.c_str(), &color[0], ImGuiColorEditFlags_NoSidePreview)) {
-                    commandManager.execute(std::make_unique<CmdColorManagerChangeColor>(i, color), true);
+                    commandManager.execute(std::make_unique<CmdColorManagerChangeColor>(colorId, color), true);
                 }
                 ImGui::PopItemWidth();
                 ImGui::EndPopup();
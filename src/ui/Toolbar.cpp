@@ -32,6 +32,12 @@ void Toolbar::draw() {
 
     ImGui::Begin("##toolbar", nullptr, window_flags);
 
+    // Geometry is being painted in the background, opening files or switching tools has to wait until it is done
+    const bool isGeometryBusy = mApplication.getModelView().isGeometryBusy();
+    if(isGeometryBusy) {
+        ImGui::PushItemFlag(ImGuiItemFlags_Disabled, true);
+    }
+
     drawFileDropDown();
     ImGui::SameLine(0.0f, 0.0f);
     drawSeparator();
@@ -41,6 +47,10 @@ void Toolbar::draw() {
     drawSeparator();
     drawToolButtons();
 
+    if(isGeometryBusy) {
+        ImGui::PopItemFlag();
+    }
+
     ImGui::End();
 
     ImGui::PopStyleVar(4);
@@ -111,7 +121,8 @@ void Toolbar::drawUndoRedo() {
     CommandManager<Geometry>* const commandManager = mApplication.getCommandManager();
     ButtonProperties props;
     props.label = ICON_MD_UNDO;
-    props.isEnabled = commandManager && commandManager->canUndo();
+    const bool isGeometryBusy = mApplication.getModelView().isGeometryBusy();
+    props.isEnabled = commandManager && !isGeometryBusy && commandManager->canUndo();
     glm::vec2 buttonPos = ImGui::GetCursorScreenPos();
     ImGui::PushFont(mApplication.getFontStorage().getRegularIconFont());
     drawButton(props, [this]() {
@@ -123,7 +134,7 @@ void Toolbar::drawUndoRedo() {
                                     buttonPos + glm::vec2(0.0f, mHeight + 6.0f));
     ImGui::SameLine(0.f, 0.f);
     props.label = ICON_MD_REDO;
-    props.isEnabled = commandManager && commandManager->canRedo();
+    props.isEnabled = commandManager && !isGeometryBusy && commandManager->canRedo();
     buttonPos = ImGui::GetCursorScreenPos();
     drawButton(props, [this]() {
         mApplication.enqueueSlowOperation([this]() { mApplication.getCommandManager()->redo(); }, []() {});